@@ -0,0 +1,26 @@
+// Time spent turning PrinterInfo into JS objects: the cache serves getPrinters from
+// memory, so what is left of a call is mostly marshalling.
+import { createRequire } from 'module';
+const require = createRequire(import.meta.url);
+
+const printer = require('../lib/printer.cjs');
+
+const ITERATIONS = Number(process.argv[2]) || 20000;
+
+function bench(label, fn) {
+    fn();
+    const start = process.hrtime.bigint();
+    let objects = 0;
+    for (let i = 0; i < ITERATIONS; i++) {
+        objects += fn().length;
+    }
+    const ns = Number(process.hrtime.bigint() - start);
+    console.log(`${label}: ${(ns / ITERATIONS / 1000).toFixed(2)} us/call, ${(ns / Math.max(objects, 1)).toFixed(0)} ns/object`);
+}
+
+printer.setPrinterCacheOptions({ ttl: 3600000, checkInterval: 3600000 });
+console.log(`${printer.getPrinters().length} printers, ${ITERATIONS} calls`);
+bench('getPrinters()', () => printer.getPrinters());
+bench("getPrinters({ fields: ['name', 'status'] })", () => printer.getPrinters({ fields: ['name', 'status'] }));
+bench("getPrinters({ columnar: true })", () => [printer.getPrinters({ columnar: true })]);
+printer.setPrinterCacheOptions({ ttl: 0 });
@@ -1,11 +1,43 @@
 {
+    "variables": {
+        # node-gyp rebuild -- -Dnative_tests=1 also builds the test/native executables,
+        # -Dsanitize=1 builds those with ASan and UBSan
+        "native_tests%": 0,
+        "sanitize%": 0,
+    },
     "targets": [
         {
             "target_name": "nodeprinting",
             "sources": [
                 "src/node_printer.hpp",
                 "src/PrinterManager.hpp",
+                "src/PrinterManager.cpp",
+                "src/PrinterCache.hpp",
+                "src/PrinterCache.cpp",
+                "src/WorkerPool.hpp",
+                "src/WorkerPool.cpp",
+                "src/JobCoalescer.hpp",
+                "src/JobCoalescer.cpp",
+                "src/DocumentFormat.hpp",
+                "src/DocumentFormat.cpp",
+                "src/PageAnalyzer.hpp",
+                "src/PageAnalyzer.cpp",
+                "src/RasterEncoder.hpp",
+                "src/RasterEncoder.cpp",
+                "src/Halftone.hpp",
+                "src/Halftone.cpp",
+                "src/node_worker.hpp",
+                "src/node_columnar.hpp",
+                "src/node_columnar.cpp",
+                "src/node_marshal.hpp",
+                "src/node_marshal.cpp",
                 "src/node_printer.cpp",
+                "src/node_print_job.hpp",
+                "src/node_print_job.cpp",
+                "src/node_printer_wrap.hpp",
+                "src/node_printer_wrap.cpp",
+                "src/node_printer_watch.hpp",
+                "src/node_printer_watch.cpp",
                 "src/win/WinPrinterManager.cpp",
                 "src/posix/PosixPrinterManager.cpp",
             ],
@@ -56,5 +88,24 @@
             },
             "msvs_settings": {"VCCLCompilerTool": {"ExceptionHandling": 1}},
         }
-    ]
+    ],
+    "conditions": [
+        [
+            "native_tests==1",
+            {
+                "targets": [
+                    {
+                        "target_name": "native_tests",
+                        "includes": ["test/native/native_tests.gypi"],
+                    },
+                    {
+                        # Same tests with the SSE2 paths compiled out, both have to pass
+                        "target_name": "native_tests_scalar",
+                        "includes": ["test/native/native_tests.gypi"],
+                        "defines": ["NODE_PRINTING_NO_SSE2"],
+                    },
+                ],
+            },
+        ],
+    ],
 }
@@ -1 +1,167 @@
-module.exports = require('../build/Release/nodeprinting.node');
\ No newline at end of file
+const { Writable } = require('stream');
+const { EventEmitter } = require('events');
+
+const printer = require('../build/Release/nodeprinting.node');
+
+/**
+ * Writable that streams its data into one spooler job.
+ * The job is opened before the first write and closed on end(); every
+ * chunk is handed to the spooler before the next one is requested.
+ */
+class PrintStream extends Writable {
+    constructor(printerName, docName, type, options) {
+        super({ highWaterMark: 64 * 1024, ...options, decodeStrings: true, objectMode: false });
+        this.printerName = printerName;
+        this.docName = docName;
+        this.type = type;
+        // PJL job ticket written natively around the streamed data
+        this.ticket = options && options.ticket;
+        this.jobId = null;
+        this._job = new printer.PrintJob();
+        this._pending = Promise.resolve();
+    }
+
+    // Native job calls must not overlap, remember the one in flight
+    _call(method, ...args) {
+        this._pending = this._job[method](...args);
+        return this._pending;
+    }
+
+    _construct(callback) {
+        const openOptions = this.ticket ? { ticket: this.ticket } : undefined;
+        this._call('open', this.printerName, this.docName, this.type, openOptions).then((jobId) => {
+            this.jobId = jobId;
+            callback();
+        }, callback);
+    }
+
+    _write(chunk, encoding, callback) {
+        this._call('write', chunk).then(() => callback(), callback);
+    }
+
+    _final(callback) {
+        this._call('close').then((jobId) => {
+            this.jobId = jobId;
+            this.emit('job', jobId);
+            callback();
+        }, callback);
+    }
+
+    _destroy(error, callback) {
+        this._pending
+            .catch(() => {})
+            .then(() => (this._job.isOpen() ? this._call('cancel') : undefined))
+            .then(() => callback(error), () => callback(error));
+    }
+}
+
+function createPrintStream(printerName, docName, type, options) {
+    return new PrintStream(printerName, docName, type, options);
+}
+
+/**
+ * Resolve a printer once and return a handle to print and query jobs on it.
+ */
+function openPrinter(printerName) {
+    return new printer.Printer(printerName);
+}
+
+// Native subscriptions by printer name ('' for all printers), shared by the watchers of that name
+const watchSources = new Map();
+
+function acquireWatchSource(key) {
+    let source = watchSources.get(key);
+    if (source === undefined) {
+        source = { watchers: new Set(), native: null };
+        source.native = new printer.PrinterWatch(key, (error, events) => {
+            // A failed subscription is not reused, later watchers of this name get a new one
+            if (error && watchSources.get(key) === source) {
+                watchSources.delete(key);
+            }
+            for (const watcher of [...source.watchers]) {
+                watcher._dispatch(error, events);
+            }
+        });
+        watchSources.set(key, source);
+    }
+    return source;
+}
+
+function updateWatchSource(key, source) {
+    if (source.watchers.size === 0) {
+        source.native.close();
+        if (watchSources.get(key) === source) {
+            watchSources.delete(key);
+        }
+    } else if ([...source.watchers].some((watcher) => watcher._ref)) {
+        source.native.ref();
+    } else {
+        source.native.unref();
+    }
+}
+
+/**
+ * EventEmitter fed by the spooler instead of polling getJob.
+ * Emits 'job' and 'printer' with the change events, 'error' when the
+ * subscription fails (the watcher is closed afterwards) and 'close'.
+ */
+class PrinterWatcher extends EventEmitter {
+    constructor(printerName) {
+        super();
+        this.printerName = printerName || null;
+        this._key = this.printerName || '';
+        this._ref = true;
+        this._source = acquireWatchSource(this._key);
+        this._source.watchers.add(this);
+        updateWatchSource(this._key, this._source);
+    }
+
+    _dispatch(error, events) {
+        if (error) {
+            this.close(error);
+            return;
+        }
+        for (const event of events) {
+            this.emit(event.job ? 'job' : 'printer', event);
+        }
+    }
+
+    ref() {
+        this._ref = true;
+        if (this._source !== null) {
+            updateWatchSource(this._key, this._source);
+        }
+        return this;
+    }
+
+    unref() {
+        this._ref = false;
+        if (this._source !== null) {
+            updateWatchSource(this._key, this._source);
+        }
+        return this;
+    }
+
+    close(error) {
+        if (this._source === null) {
+            return;
+        }
+        this._source.watchers.delete(this);
+        updateWatchSource(this._key, this._source);
+        this._source = null;
+        if (error) {
+            this.emit('error', error);
+        }
+        this.emit('close');
+    }
+}
+
+/**
+ * Watch job and printer changes of one printer, or of every printer when
+ * printerName is omitted. Watching all printers takes a single subscription.
+ */
+function watch(printerName) {
+    return new PrinterWatcher(printerName);
+}
+
+module.exports = { ...printer, PrintStream, createPrintStream, openPrinter, PrinterWatcher, watch };
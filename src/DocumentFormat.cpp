@@ -0,0 +1,349 @@
+#include "DocumentFormat.hpp"
+
+#include <cctype>
+#include <cstdint>
+
+#if !defined(NODE_PRINTING_NO_SSE2) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define DOCUMENT_FORMAT_SSE2 1
+#endif
+
+static const char ESC = 0x1B;
+static const char GS = 0x1D;
+
+// Control bytes seen in the sniffed window
+struct MarkerCounts
+{
+    size_t esc = 0;
+    size_t gs = 0;
+    // Below 0x20 and not ESC, GS or text layout (tab, line feed, form feed, carriage return)
+    size_t binary = 0;
+};
+
+static bool isBinaryByte(unsigned char c)
+{
+    return c < 0x20 && c != '\t' && c != '\n' && c != '\f' && c != '\r' && c != (unsigned char)ESC && c != (unsigned char)GS;
+}
+
+#ifdef DOCUMENT_FORMAT_SSE2
+static int popCount(unsigned value)
+{
+    int count = 0;
+    for (; value != 0; value &= value - 1)
+    {
+        count++;
+    }
+    return count;
+}
+#endif
+
+static MarkerCounts countMarkers(const unsigned char *data, size_t size)
+{
+    MarkerCounts counts;
+    size_t i = 0;
+
+#ifdef DOCUMENT_FORMAT_SSE2
+    const __m128i esc = _mm_set1_epi8(ESC);
+    const __m128i gs = _mm_set1_epi8(GS);
+    // Signed compare: bytes 0x00-0x1F are below 0x20, 0x80-0xFF are negative and excluded
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i minusOne = _mm_set1_epi8(-1);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i lineFeed = _mm_set1_epi8('\n');
+    const __m128i formFeed = _mm_set1_epi8('\f');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i isEsc = _mm_cmpeq_epi8(block, esc);
+        __m128i isGs = _mm_cmpeq_epi8(block, gs);
+        __m128i isControl = _mm_and_si128(_mm_cmplt_epi8(block, space), _mm_cmpgt_epi8(block, minusOne));
+        __m128i isLayout = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, tab), _mm_cmpeq_epi8(block, lineFeed)),
+                                        _mm_or_si128(_mm_cmpeq_epi8(block, formFeed), _mm_cmpeq_epi8(block, carriageReturn)));
+        __m128i isBinary = _mm_andnot_si128(_mm_or_si128(_mm_or_si128(isEsc, isGs), isLayout), isControl);
+
+        counts.esc += popCount((unsigned)_mm_movemask_epi8(isEsc));
+        counts.gs += popCount((unsigned)_mm_movemask_epi8(isGs));
+        counts.binary += popCount((unsigned)_mm_movemask_epi8(isBinary));
+    }
+#endif
+
+    for (; i < size; i++)
+    {
+        counts.esc += data[i] == (unsigned char)ESC;
+        counts.gs += data[i] == (unsigned char)GS;
+        counts.binary += isBinaryByte(data[i]);
+    }
+
+    return counts;
+}
+
+static bool startsWith(std::string_view data, size_t pos, std::string_view prefix)
+{
+    return data.size() >= pos + prefix.size() && data.compare(pos, prefix.size(), prefix) == 0;
+}
+
+static bool startsWithNoCase(std::string_view data, size_t pos, std::string_view prefix)
+{
+    if (data.size() < pos + prefix.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < prefix.size(); i++)
+    {
+        if (std::toupper((unsigned char)data[pos + i]) != (unsigned char)prefix[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t skipWhitespace(std::string_view data, size_t pos)
+{
+    while (pos < data.size() && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r' || data[pos] == '\n'))
+    {
+        pos++;
+    }
+    return pos;
+}
+
+// The language a PJL ENTER LANGUAGE line switches to, UNKNOWN when it is not one we classify
+static DocumentFormat getPjlLanguage(std::string_view line)
+{
+    size_t equals = line.find('=');
+    if (equals == std::string_view::npos)
+    {
+        return FORMAT_UNKNOWN;
+    }
+
+    size_t pos = equals + 1;
+    while (pos < line.size() && line[pos] == ' ')
+    {
+        pos++;
+    }
+
+    static const struct
+    {
+        std::string_view name;
+        DocumentFormat format;
+    } LANGUAGES[] = {
+        {"PCLXL", FORMAT_PCLXL},
+        {"PCL", FORMAT_PCL5},
+        {"POSTSCRIPT", FORMAT_POSTSCRIPT},
+        {"PDF", FORMAT_PDF},
+        {"ZPL", FORMAT_ZPL},
+    };
+    for (const auto &language : LANGUAGES)
+    {
+        if (startsWithNoCase(line, pos, language.name))
+        {
+            return language.format;
+        }
+    }
+    return FORMAT_UNKNOWN;
+}
+
+// The escape sequence at pos, as PCL5 or ESC/POS; UNKNOWN when it is neither
+static DocumentFormat classifyEscape(std::string_view data, size_t pos)
+{
+    if (pos + 1 >= data.size())
+    {
+        return FORMAT_UNKNOWN;
+    }
+
+    char command = data[pos + 1];
+    char parameter = pos + 2 < data.size() ? data[pos + 2] : '\0';
+
+    // ESC @ initializes an ESC/POS printer
+    if (command == '@')
+    {
+        return FORMAT_ESCPOS;
+    }
+    // ESC E resets a PCL printer, where ESC/POS has a 0/1 emphasis flag
+    if (command == 'E')
+    {
+        return parameter == '\0' || parameter == '\x01' ? FORMAT_ESCPOS : FORMAT_PCL5;
+    }
+    // Parameterized PCL: ESC & l 1 O, ESC * t 300 R, ESC ( s 0 P, ESC % 1 B ...
+    if ((command == '&' || command == '*' || command == '(' || command == ')' || command == '%') &&
+        (std::islower((unsigned char)parameter) || std::isdigit((unsigned char)parameter) || parameter == '-'))
+    {
+        return FORMAT_PCL5;
+    }
+    // Common ESC/POS commands: character size, alignment, feed, code table
+    if (command == '!' || command == 'a' || command == 'd' || command == 't' || command == 'J' || command == '2' || command == '3')
+    {
+        return FORMAT_ESCPOS;
+    }
+    return FORMAT_UNKNOWN;
+}
+
+// Everything but the PJL header
+static DocumentFormat classifyData(std::string_view data, size_t pos)
+{
+    pos = skipWhitespace(data, pos);
+
+    if (startsWith(data, pos, "%PDF-"))
+    {
+        return FORMAT_PDF;
+    }
+    if (startsWith(data, pos, "%!") || startsWith(data, pos, "\x04%!"))
+    {
+        return FORMAT_POSTSCRIPT;
+    }
+    if (startsWith(data, pos, "RaS2"))
+    {
+        return FORMAT_PWG_RASTER;
+    }
+    if (startsWith(data, pos, std::string_view("UNIRAST\0", 8)))
+    {
+        return FORMAT_URF;
+    }
+    // PCL XL stream header: binding byte, then " HP-PCL XL;protocol;revision"
+    if (pos < data.size() && (data[pos] == ')' || data[pos] == '(' || data[pos] == '\'') && startsWith(data, pos + 1, " HP-PCL XL"))
+    {
+        return FORMAT_PCLXL;
+    }
+
+    std::string_view window = data.substr(pos);
+    MarkerCounts counts = countMarkers((const unsigned char *)window.data(), window.size());
+
+    // Label formats are text: commands and fields between ^XA and ^XZ
+    if (window.find("^XA") != std::string_view::npos && counts.esc == 0 && counts.binary == 0)
+    {
+        return FORMAT_ZPL;
+    }
+
+    if (counts.esc > 0)
+    {
+        size_t escape = window.find(ESC);
+        DocumentFormat format = classifyEscape(window, escape);
+        // GS commands (cut, raster image, barcode) give ESC/POS away even behind an ESC E
+        if (format == FORMAT_PCL5 && counts.gs > 0 && window[escape + 1] == 'E')
+        {
+            return FORMAT_ESCPOS;
+        }
+        if (format != FORMAT_UNKNOWN)
+        {
+            return format;
+        }
+    }
+    size_t group = counts.gs > 0 ? window.find(GS) : std::string_view::npos;
+    if (group != std::string_view::npos && group + 1 < window.size())
+    {
+        char command = window[group + 1];
+        if (command == 'V' || command == 'v' || command == '!' || command == 'k' || command == 'h' || command == 'w' || command == 'L')
+        {
+            return FORMAT_ESCPOS;
+        }
+    }
+
+    // Some PDF writers put junk in front of the header, readers look within the first KB
+    if (window.substr(0, 1024).find("%PDF-") != std::string_view::npos)
+    {
+        return FORMAT_PDF;
+    }
+
+    return FORMAT_UNKNOWN;
+}
+
+DocumentFormat sniffDocumentFormat(std::string_view data)
+{
+    data = data.substr(0, SNIFF_BYTES);
+
+    static const std::string_view UEL = "\x1B%-12345X";
+
+    size_t pos = 0;
+    bool pjl = false;
+    DocumentFormat language = FORMAT_UNKNOWN;
+
+    // UEL and @PJL lines, in any order, until the data starts
+    while (true)
+    {
+        if (startsWith(data, pos, UEL))
+        {
+            pjl = true;
+            pos += UEL.size();
+            continue;
+        }
+
+        size_t lineStart = skipWhitespace(data, pos);
+        if (!startsWithNoCase(data, lineStart, "@PJL"))
+        {
+            break;
+        }
+
+        pjl = true;
+        size_t lineEnd = data.find('\n', lineStart);
+        std::string_view line = data.substr(lineStart, lineEnd == std::string_view::npos ? std::string_view::npos : lineEnd - lineStart);
+        size_t command = skipWhitespace(line, 4);
+        if (startsWithNoCase(line, command, "ENTER"))
+        {
+            language = getPjlLanguage(line);
+        }
+
+        if (lineEnd == std::string_view::npos)
+        {
+            pos = data.size();
+            break;
+        }
+        pos = lineEnd + 1;
+        // ENTER LANGUAGE is the last PJL line, the data follows right after
+        if (language != FORMAT_UNKNOWN)
+        {
+            break;
+        }
+    }
+
+    if (language != FORMAT_UNKNOWN)
+    {
+        return language;
+    }
+
+    DocumentFormat format = classifyData(data, pos);
+    if (format == FORMAT_UNKNOWN && pjl)
+    {
+        return FORMAT_PJL;
+    }
+    return format;
+}
+
+const char *getDocumentFormatName(DocumentFormat format)
+{
+    switch (format)
+    {
+    case FORMAT_PJL:
+        return "PJL";
+    case FORMAT_PCL5:
+        return "PCL";
+    case FORMAT_PCLXL:
+        return "PCLXL";
+    case FORMAT_POSTSCRIPT:
+        return "POSTSCRIPT";
+    case FORMAT_PDF:
+        return "PDF";
+    case FORMAT_ZPL:
+        return "ZPL";
+    case FORMAT_ESCPOS:
+        return "ESCPOS";
+    case FORMAT_PWG_RASTER:
+        return "PWG";
+    case FORMAT_URF:
+        return "URF";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+bool isAutoType(std::string_view type)
+{
+    return type.size() == 4 && startsWithNoCase(type, 0, "AUTO");
+}
+
+bool isPrinterReadyFormat(DocumentFormat format)
+{
+    return format == FORMAT_PJL || format == FORMAT_PCL5 || format == FORMAT_PCLXL ||
+           format == FORMAT_ZPL || format == FORMAT_ESCPOS;
+}
@@ -0,0 +1,43 @@
+#ifndef DOCUMENT_FORMAT_HPP
+#define DOCUMENT_FORMAT_HPP
+
+#include <cstddef>
+#include <string_view>
+
+enum DocumentFormat
+{
+    FORMAT_UNKNOWN,
+    // PJL commands only, or a PJL header in front of data that was not recognized
+    FORMAT_PJL,
+    FORMAT_PCL5,
+    FORMAT_PCLXL,
+    FORMAT_POSTSCRIPT,
+    FORMAT_PDF,
+    FORMAT_ZPL,
+    FORMAT_ESCPOS,
+    FORMAT_PWG_RASTER,
+    // Apple raster, "UNIRAST"
+    FORMAT_URF
+};
+
+// Bytes of the document looked at by sniffDocumentFormat
+static const size_t SNIFF_BYTES = 4096;
+
+/**
+ * Classify a print payload from its first SNIFF_BYTES bytes. A PJL header
+ * (UEL, @PJL lines) is skipped and its ENTER LANGUAGE honoured, the data
+ * behind it decides otherwise. Control bytes are counted with SSE2 where the
+ * compiler targets it, a scalar loop elsewhere or with NODE_PRINTING_NO_SSE2.
+ */
+DocumentFormat sniffDocumentFormat(std::string_view data);
+
+// Upper case name of a format: UNKNOWN, PJL, PCL, PCLXL, POSTSCRIPT, PDF, ZPL, ESCPOS, PWG, URF
+const char *getDocumentFormatName(DocumentFormat format);
+
+// Whether type asks for the format to be sniffed from the data ("AUTO", any case)
+bool isAutoType(std::string_view type);
+
+// Whether the payload is in a printer language the device takes as is, no filter needed
+bool isPrinterReadyFormat(DocumentFormat format);
+
+#endif
@@ -0,0 +1,279 @@
+#include "Halftone.hpp"
+#include "RasterEncoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if !defined(NODE_PRINTING_NO_SSE2) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define HALFTONE_SSE2 1
+#endif
+
+// Rows per GS v 0 command, printers buffer a whole command before printing it
+static const uint32_t ESCPOS_BAND_ROWS = 256;
+
+// Recursive 8x8 Bayer matrix, levels 0-63
+static const uint8_t BAYER[8][8] = {
+    {0, 32, 8, 40, 2, 34, 10, 42},
+    {48, 16, 56, 24, 50, 18, 58, 26},
+    {12, 44, 4, 36, 14, 46, 6, 38},
+    {60, 28, 52, 20, 62, 30, 54, 22},
+    {3, 35, 11, 43, 1, 33, 9, 41},
+    {51, 19, 59, 27, 49, 17, 57, 25},
+    {15, 47, 7, 39, 13, 45, 5, 37},
+    {63, 31, 55, 23, 61, 29, 53, 21},
+};
+
+#ifdef HALFTONE_SSE2
+// movemask puts the first pixel in the lowest bit, packed rows want it in the highest
+struct BitReverse
+{
+    uint8_t table[256];
+
+    BitReverse()
+    {
+        for (int value = 0; value < 256; value++)
+        {
+            uint8_t reversed = 0;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                if (value & (1 << bit))
+                {
+                    reversed |= (uint8_t)(0x80 >> bit);
+                }
+            }
+            table[value] = reversed;
+        }
+    }
+};
+
+static const BitReverse REVERSE;
+#endif
+
+// Sets the bit of every pixel darker than its threshold; thresholds repeat every 16 pixels
+static void thresholdRow(const uint8_t *gray, const uint8_t *thresholds, uint32_t width, uint8_t *bits)
+{
+    uint32_t x = 0;
+
+#ifdef HALFTONE_SSE2
+    // Unsigned compare as signed, both sides shifted by 0x80
+    const __m128i bias = _mm_set1_epi8((char)0x80);
+    const __m128i limit = _mm_xor_si128(_mm_loadu_si128((const __m128i *)thresholds), bias);
+
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i pixels = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(gray + x)), bias);
+        unsigned black = (unsigned)_mm_movemask_epi8(_mm_cmplt_epi8(pixels, limit));
+        bits[x / 8] = REVERSE.table[black & 0xFF];
+        bits[x / 8 + 1] = REVERSE.table[black >> 8];
+    }
+#endif
+
+    for (; x < width; x++)
+    {
+        if (gray[x] < thresholds[x & 15])
+        {
+            bits[x / 8] |= (uint8_t)(0x80 >> (x & 7));
+        }
+    }
+}
+
+// Serpentine Floyd-Steinberg: rows alternate direction so the error does not drift to one side.
+// errors holds two rows of sixteenths, with a pixel of margin on both ends
+static void diffuseRow(const uint8_t *gray, uint32_t width, uint32_t y, std::vector<int> *errors, uint8_t *bits)
+{
+    std::vector<int> &current = errors[y & 1];
+    std::vector<int> &next = errors[1 - (y & 1)];
+    std::fill(next.begin(), next.end(), 0);
+
+    int direction = (y & 1) ? -1 : 1;
+    for (uint32_t i = 0; i < width; i++)
+    {
+        uint32_t x = direction > 0 ? i : width - 1 - i;
+        size_t at = x + 1;
+
+        int value = gray[x] + current[at] / 16;
+        bool black = value < 128;
+        int error = black ? value : value - 255;
+        if (black)
+        {
+            bits[x / 8] |= (uint8_t)(0x80 >> (x & 7));
+        }
+
+        current[at + direction] += error * 7;
+        next[at - direction] += error * 3;
+        next[at] += error * 5;
+        next[at + direction] += error;
+    }
+}
+
+void halftone(const RasterPage &page, const HalftoneOptions &options, Bitmap &bitmap)
+{
+    bitmap.width = page.width;
+    bitmap.height = page.height;
+    bitmap.bytesPerRow = (page.width + 7) / 8;
+    bitmap.bits.assign(bitmap.bytesPerRow * page.height, '\0');
+
+    std::vector<uint8_t> grayBuffer(page.width);
+    std::vector<int> errors[2];
+    if (options.method == HALFTONE_FLOYD_STEINBERG)
+    {
+        errors[0].assign(page.width + 2, 0);
+        errors[1].assign(page.width + 2, 0);
+    }
+
+    uint8_t thresholds[16];
+    int level = options.threshold < 0 ? 0 : options.threshold > 255 ? 255 : options.threshold;
+    std::memset(thresholds, level, sizeof(thresholds));
+
+    for (uint32_t y = 0; y < page.height; y++)
+    {
+        const uint8_t *gray = convertRasterRow(page, y, RASTER_SGRAY, grayBuffer.data());
+        uint8_t *bits = (uint8_t *)&bitmap.bits[y * bitmap.bytesPerRow];
+
+        switch (options.method)
+        {
+        case HALFTONE_FLOYD_STEINBERG:
+            diffuseRow(gray, page.width, y, errors, bits);
+            break;
+        case HALFTONE_ORDERED:
+            // Levels spread over 2-254, the middle of each of the 64 steps
+            for (int x = 0; x < 16; x++)
+            {
+                thresholds[x] = (uint8_t)(BAYER[y & 7][x & 7] * 4 + 2);
+            }
+            // Fall through
+        default:
+            thresholdRow(gray, thresholds, page.width, bits);
+            break;
+        }
+    }
+}
+
+// ZPL ASCII compression repeat count: g-z for 20-400 in steps of 20, G-Y for 1-19
+static void appendZplCount(size_t count, std::string &output)
+{
+    for (; count >= 400; count -= 400)
+    {
+        output.push_back('z');
+    }
+    if (count >= 20)
+    {
+        output.push_back((char)('g' + count / 20 - 1));
+        count %= 20;
+    }
+    if (count > 0)
+    {
+        output.push_back((char)('G' + count - 1));
+    }
+}
+
+void appendZplGraphic(const Bitmap &bitmap, std::string &output)
+{
+    static const char HEX[] = "0123456789ABCDEF";
+
+    std::string total = std::to_string(bitmap.bits.size());
+    output += "^XA^FO0,0^GFA," + total + "," + total + "," + std::to_string(bitmap.bytesPerRow) + ",";
+
+    std::string hex(bitmap.bytesPerRow * 2, '0');
+    for (uint32_t y = 0; y < bitmap.height; y++)
+    {
+        const char *row = bitmap.bits.data() + y * bitmap.bytesPerRow;
+
+        // ':' repeats the row above
+        if (y > 0 && std::memcmp(row, row - bitmap.bytesPerRow, bitmap.bytesPerRow) == 0)
+        {
+            output.push_back(':');
+            continue;
+        }
+
+        for (size_t i = 0; i < bitmap.bytesPerRow; i++)
+        {
+            hex[2 * i] = HEX[(uint8_t)row[i] >> 4];
+            hex[2 * i + 1] = HEX[(uint8_t)row[i] & 0x0F];
+        }
+
+        // ',' fills the rest of the row with white, '!' with black
+        size_t end = hex.size();
+        char fill = hex[end - 1] == '0' ? ',' : hex[end - 1] == 'F' ? '!' : '\0';
+        if (fill != '\0')
+        {
+            while (end > 0 && hex[end - 1] == hex.back())
+            {
+                end--;
+            }
+        }
+
+        for (size_t start = 0; start < end;)
+        {
+            size_t run = start + 1;
+            while (run < end && hex[run] == hex[start])
+            {
+                run++;
+            }
+            if (run - start > 1)
+            {
+                appendZplCount(run - start, output);
+            }
+            output.push_back(hex[start]);
+            start = run;
+        }
+        if (fill != '\0')
+        {
+            output.push_back(fill);
+        }
+    }
+
+    output += "^FS^XZ";
+}
+
+void appendEscPosRaster(const Bitmap &bitmap, std::string &output)
+{
+    for (uint32_t y = 0; y < bitmap.height; y += ESCPOS_BAND_ROWS)
+    {
+        uint32_t rows = bitmap.height - y < ESCPOS_BAND_ROWS ? bitmap.height - y : ESCPOS_BAND_ROWS;
+
+        // GS v 0, normal density, width in bytes and height in dots, little endian
+        const char command[] = {
+            0x1D, 'v', '0', 0,
+            (char)(bitmap.bytesPerRow & 0xFF), (char)(bitmap.bytesPerRow >> 8),
+            (char)(rows & 0xFF), (char)(rows >> 8)};
+        output.append(command, sizeof(command));
+        output.append(bitmap.bits, y * bitmap.bytesPerRow, rows * bitmap.bytesPerRow);
+    }
+}
+
+ErrorMessage *renderBitmap(const RasterPage &page, const HalftoneOptions &options, std::string &output)
+{
+    ErrorMessage *errorMessage = checkRasterPage(page);
+    if (errorMessage != NULL)
+    {
+        return errorMessage;
+    }
+
+    // GS v 0 takes at most 65535 bytes per row
+    if (options.output == BITMAP_ESCPOS && (page.width + 7) / 8 > 0xFFFF)
+    {
+        static ErrorMessage errorMsg = "Image is too wide for ESC/POS";
+        return &errorMsg;
+    }
+
+    Bitmap bitmap;
+    halftone(page, options, bitmap);
+
+    switch (options.output)
+    {
+    case BITMAP_ZPL:
+        appendZplGraphic(bitmap, output);
+        break;
+    case BITMAP_ESCPOS:
+        appendEscPosRaster(bitmap, output);
+        break;
+    default:
+        output.swap(bitmap.bits);
+        break;
+    }
+
+    return NULL;
+}
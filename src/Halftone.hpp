@@ -0,0 +1,66 @@
+#ifndef HALFTONE_HPP
+#define HALFTONE_HPP
+
+#include "PrinterManager.hpp"
+
+#include <cstdint>
+#include <string>
+
+enum HalftoneMethod
+{
+    // Black below a fixed level
+    HALFTONE_THRESHOLD,
+    // 8x8 Bayer matrix
+    HALFTONE_ORDERED,
+    // Error diffusion, serpentine
+    HALFTONE_FLOYD_STEINBERG
+};
+
+// Printer language a bitmap is wrapped in
+enum BitmapOutput
+{
+    // Packed rows only
+    BITMAP_RAW,
+    // ^XA^FO0,0^GFA...^FS^XZ with ZPL ASCII compression
+    BITMAP_ZPL,
+    // GS v 0 bands
+    BITMAP_ESCPOS
+};
+
+struct HalftoneOptions
+{
+    HalftoneMethod method = HALFTONE_ORDERED;
+    // Gray level (0-255) under which a pixel is black, for HALFTONE_THRESHOLD
+    int threshold = 128;
+    BitmapOutput output = BITMAP_RAW;
+};
+
+/**
+ * 1 bit per pixel image, rows padded to whole bytes, most significant bit
+ * first, 1 for a black dot as ZPL and ESC/POS expect.
+ */
+struct Bitmap
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    size_t bytesPerRow = 0;
+    std::string bits;
+};
+
+/**
+ * Halftone a RasterPage checked by checkRasterPage to a Bitmap. Rows are
+ * converted to gray one at a time by convertRasterRow, the same gray as an
+ * sGray printRaster, then thresholded against a constant or the Bayer row
+ * with SSE2, 16 pixels at a time, where the compiler targets it (not with
+ * NODE_PRINTING_NO_SSE2). Floyd-Steinberg diffuses its error in integers.
+ */
+void halftone(const RasterPage &page, const HalftoneOptions &options, Bitmap &bitmap);
+
+// The bitmap as a ZPL label or ESC/POS raster commands, ready to print RAW
+void appendZplGraphic(const Bitmap &bitmap, std::string &output);
+void appendEscPosRaster(const Bitmap &bitmap, std::string &output);
+
+// halftone, then the wrapping options.output asks for
+ErrorMessage *renderBitmap(const RasterPage &page, const HalftoneOptions &options, std::string &output);
+
+#endif
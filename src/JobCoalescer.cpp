@@ -0,0 +1,312 @@
+#include "JobCoalescer.hpp"
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+/**
+ * The calls waiting for one printer and type, sent as a single printDirect
+ * on the worker pool. Queued under the printer name like any other print.
+ * The job runs under a context following those of its calls: it is stopped
+ * once every one of them has timed out or been aborted.
+ */
+class JobCoalescer::Group : public WorkerTask
+{
+public:
+    struct Member
+    {
+        CoalescedJob *job;
+        OperationContext *context;
+        size_t offset;
+        size_t length;
+    };
+
+    void Execute() override
+    {
+        // Calls stopped while waiting are left out, their bytes are never sent
+        std::vector<Member> kept;
+        kept.reserve(members.size());
+        size_t keptBytes = 0;
+        for (const Member &member : members)
+        {
+            if (member.context != NULL && member.context->stopped())
+            {
+                member.job->Coalesced(member.context->error(), 0);
+                continue;
+            }
+            kept.push_back(member);
+            keptBytes += member.length;
+        }
+
+        if (kept.size() < members.size())
+        {
+            JobCoalescer &coalescer = JobCoalescer::getInstance();
+            std::lock_guard<std::mutex> lock(coalescer.mutex);
+            coalescer.stats.dropped += members.size() - kept.size();
+        }
+
+        if (kept.size() < members.size() && !kept.empty())
+        {
+            std::string combined;
+            combined.reserve(keptBytes);
+            for (const Member &member : kept)
+            {
+                combined.append(data, member.offset, member.length);
+            }
+            data.swap(combined);
+        }
+        members.swap(kept);
+
+        if (members.empty())
+        {
+            return;
+        }
+
+        // A call without a context of its own puts no bound on the job
+        std::vector<const OperationContext *> contexts;
+        contexts.reserve(members.size());
+        for (const Member &member : members)
+        {
+            if (member.context == NULL)
+            {
+                contexts.clear();
+                break;
+            }
+            contexts.push_back(member.context);
+        }
+        context.follow(contexts);
+
+        errorMessage = PrinterManager::getInstance().printDirect(key, docName, type, data, jobId, &context);
+        if (errorMessage != NULL && context.stopped())
+        {
+            errorMessage = context.error();
+        }
+    }
+
+    // Fails every call of a group that was never run
+    void Reject(ErrorMessage *errorMessage)
+    {
+        this->errorMessage = errorMessage;
+        Done();
+    }
+
+    void Done() override
+    {
+        for (const Member &member : members)
+        {
+            member.job->Coalesced(errorMessage, jobId);
+        }
+        delete this;
+    }
+
+    std::string docName;
+    std::string type;
+    std::string data;
+    std::vector<Member> members;
+    Clock::time_point deadline;
+
+private:
+    OperationContext context;
+    int jobId = 0;
+    ErrorMessage *errorMessage = NULL;
+};
+
+JobCoalescer::Rejected::~Rejected()
+{
+    fail();
+}
+
+void JobCoalescer::Rejected::fail()
+{
+    for (std::pair<Group *, ErrorMessage *> &group : groups)
+    {
+        group.first->Reject(group.second);
+    }
+    groups.clear();
+}
+
+JobCoalescer &JobCoalescer::getInstance()
+{
+    // Never destroyed, like the worker pool its flusher thread is detached
+    static JobCoalescer *instance = new JobCoalescer();
+    return *instance;
+}
+
+void JobCoalescer::setOptions(int windowMs, size_t maxBytes)
+{
+    Rejected rejected;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    window = std::chrono::milliseconds(windowMs > 0 ? windowMs : 0);
+    this->maxBytes = maxBytes;
+
+    // Groups waiting under the old options go out now
+    for (std::map<std::string, Group *>::value_type &group : groups)
+    {
+        send(group.second, rejected);
+    }
+    groups.clear();
+}
+
+void JobCoalescer::getOptions(int &windowMs, size_t &maxBytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    windowMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(window).count();
+    maxBytes = this->maxBytes;
+}
+
+bool JobCoalescer::accepts(const std::string &type, size_t size)
+{
+    static const char RAW[] = "RAW";
+
+    bool raw = type.empty() ||
+               (type.size() == sizeof(RAW) - 1 &&
+                std::equal(type.begin(), type.end(), RAW, [](char a, char b)
+                           { return std::toupper((unsigned char)a) == b; }));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return raw && window > Clock::duration::zero() && maxBytes > 0 && size <= maxBytes;
+}
+
+ErrorMessage *JobCoalescer::add(std::string_view printer, const std::string &docName, const std::string &type,
+                                std::string_view data, CoalescedJob *job, OperationContext *context)
+{
+    Rejected rejected;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::string groupKey(printer);
+    groupKey.push_back('\0');
+    groupKey.append(type);
+
+    // A group never grows past maxBytes, the one waiting goes out first
+    std::map<std::string, Group *>::iterator entry = groups.find(groupKey);
+    if (entry != groups.end() && entry->second->data.size() + data.size() > maxBytes)
+    {
+        stats.capped++;
+        send(entry->second, rejected);
+        groups.erase(entry);
+        entry = groups.end();
+    }
+
+    if (entry == groups.end())
+    {
+        if (!running)
+        {
+            try
+            {
+                std::thread(&JobCoalescer::run, this).detach();
+            }
+            catch (const std::system_error &)
+            {
+                static ErrorMessage errorMsg = "Could not start the job coalescing thread";
+                return &errorMsg;
+            }
+            running = true;
+        }
+
+        Group *group = new Group();
+        group->key = std::string(printer);
+        group->docName = docName;
+        group->type = type;
+        group->deadline = Clock::now() + window;
+        entry = groups.emplace(groupKey, group).first;
+        wakeup.notify_one();
+    }
+
+    Group *group = entry->second;
+    group->members.push_back({job, context, group->data.size(), data.size()});
+    group->data.append(data.data(), data.size());
+    stats.coalesced++;
+
+    if (group->data.size() >= maxBytes)
+    {
+        stats.capped++;
+        send(group, rejected);
+        groups.erase(entry);
+    }
+
+    return NULL;
+}
+
+void JobCoalescer::flush()
+{
+    Rejected rejected;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (std::map<std::string, Group *>::value_type &group : groups)
+    {
+        send(group.second, rejected);
+    }
+    groups.clear();
+}
+
+JobCoalescerStats JobCoalescer::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    JobCoalescerStats result = stats;
+    for (std::map<std::string, Group *>::value_type &group : groups)
+    {
+        result.pending += group.second->members.size();
+    }
+    return result;
+}
+
+// Called with the lock held once a group left the map. A full pool fails
+// every call of the group, they were all accepted as one job; that is left
+// to rejected, the calls may not be completed under the lock
+void JobCoalescer::send(Group *group, Rejected &rejected)
+{
+    stats.flushed++;
+
+    ErrorMessage *errorMessage = WorkerPool::getInstance().submit(group);
+    if (errorMessage != NULL)
+    {
+        rejected.groups.emplace_back(group, errorMessage);
+    }
+}
+
+void JobCoalescer::run()
+{
+    Rejected rejected;
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        Clock::time_point now = Clock::now();
+        Clock::time_point next = Clock::time_point::max();
+
+        for (std::map<std::string, Group *>::iterator entry = groups.begin(); entry != groups.end();)
+        {
+            if (entry->second->deadline <= now)
+            {
+                send(entry->second, rejected);
+                entry = groups.erase(entry);
+                continue;
+            }
+            next = (std::min)(next, entry->second->deadline);
+            ++entry;
+        }
+
+        if (!rejected.groups.empty())
+        {
+            lock.unlock();
+            rejected.fail();
+            lock.lock();
+            continue;
+        }
+
+        if (next == Clock::time_point::max())
+        {
+            wakeup.wait(lock);
+        }
+        else
+        {
+            wakeup.wait_until(lock, next);
+        }
+    }
+}
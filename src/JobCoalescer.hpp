@@ -0,0 +1,101 @@
+#ifndef JOB_COALESCER_HPP
+#define JOB_COALESCER_HPP
+
+#include "PrinterManager.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct JobCoalescerStats
+{
+    // Calls taken in and the spooler jobs they ended up in
+    uint64_t coalesced = 0;
+    uint64_t flushed = 0;
+    // Flushes because the byte cap was reached rather than the window
+    uint64_t capped = 0;
+    // Calls stopped by their timeout or signal before their job was printed
+    uint64_t dropped = 0;
+    size_t pending = 0;
+};
+
+/**
+ * A printDirect call whose data may share a spooler job with others.
+ * Coalesced() is called once, on a pool thread, with the id of the combined
+ * job, or on the thread that gave up on it; it may delete the object.
+ */
+class CoalescedJob
+{
+public:
+    virtual ~CoalescedJob() {}
+
+    virtual void Coalesced(ErrorMessage *errorMessage, int jobId) = 0;
+};
+
+/**
+ * Nagle's algorithm for print jobs. Small RAW jobs for the same printer and
+ * type arriving within windowMs of the first one are concatenated into a
+ * single spooler job, saving the per job overhead of the spooler and the
+ * pause printers make between jobs. A group is sent early once it holds
+ * maxBytes. Only RAW data is taken: it goes to the device unchanged, so the
+ * concatenation prints the same as the separate jobs. The combined job is
+ * named after the docName of the first call of its group, the names of the
+ * others are not sent. A windowMs or maxBytes of 0 disables coalescing.
+ */
+class JobCoalescer
+{
+public:
+    static JobCoalescer &getInstance();
+
+    void setOptions(int windowMs, size_t maxBytes);
+    void getOptions(int &windowMs, size_t &maxBytes);
+
+    // Whether a job is coalesced under the current options
+    bool accepts(const std::string &type, size_t size);
+
+    // Copies data, job completes once the combined job is sent. The context
+    // is the caller's: a call stopped before its group is sent is left out
+    ErrorMessage *add(std::string_view printer, const std::string &docName, const std::string &type,
+                      std::string_view data, CoalescedJob *job, OperationContext *context);
+
+    // Send every waiting group now
+    void flush();
+
+    JobCoalescerStats getStats();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    class Group;
+
+    // Groups the pool turned down. Declared before the lock is taken, so that
+    // their calls are failed once it is released (or by an explicit fail())
+    struct Rejected
+    {
+        ~Rejected();
+        void fail();
+
+        std::vector<std::pair<Group *, ErrorMessage *>> groups;
+    };
+
+    void run();
+    void send(Group *group, Rejected &rejected);
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    Clock::duration window = Clock::duration::zero();
+    size_t maxBytes = 64 * 1024;
+    bool running = false;
+
+    // Keyed by printer name and type, separated by a NUL
+    std::map<std::string, Group *> groups;
+
+    JobCoalescerStats stats;
+};
+
+#endif
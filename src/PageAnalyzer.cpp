@@ -0,0 +1,744 @@
+#include "PageAnalyzer.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#if !defined(NODE_PRINTING_NO_SSE2) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define PAGE_ANALYZER_SSE2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+static const char ESC = 0x1B;
+static const char FF = 0x0C;
+static const std::string_view UEL = "\x1B%-12345X";
+
+// Longest token kept across a chunk boundary: a PJL line, a PCL5 escape
+// sequence, a PCL XL header or tag. Anything longer is not waited for
+static const size_t MAX_CARRY = 512;
+// Longest PCL5 escape sequence parsed, value/parameter pairs included
+static const size_t MAX_ESCAPE = 64;
+// PCL XL attribute ids
+static const int PCLXL_PAGE_COPIES = 49;
+static const int PCLXL_DUPLEX_PAGE_MODE = 53;
+// PCL XL operators
+static const unsigned char PCLXL_END_PAGE = 0x44;
+
+static bool startsWithNoCase(std::string_view data, size_t pos, std::string_view prefix)
+{
+    if (data.size() < pos + prefix.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < prefix.size(); i++)
+    {
+        if (std::toupper((unsigned char)data[pos + i]) != (unsigned char)prefix[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether the data at pos is, or may turn into, a UEL once more data arrives
+static bool isUelPrefix(std::string_view data, size_t pos)
+{
+    size_t size = (std::min)(data.size() - pos, UEL.size());
+    return data.compare(pos, size, UEL.substr(0, size)) == 0;
+}
+
+#ifdef PAGE_ANALYZER_SSE2
+static unsigned lowestBit(unsigned mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+#endif
+
+// Index of the first ESC or FF, size when there is none. Sets printed when a
+// byte that puts something on the page (above space) comes before it
+static size_t scanText(const unsigned char *data, size_t size, bool &printed)
+{
+    size_t i = 0;
+
+#ifdef PAGE_ANALYZER_SSE2
+    const __m128i esc = _mm_set1_epi8(ESC);
+    const __m128i formFeed = _mm_set1_epi8(FF);
+    // Signed compare: 0x21-0x7F are above space, 0x80-0xFF are negative
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)(data + i));
+        unsigned stops = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, esc), _mm_cmpeq_epi8(block, formFeed)));
+        unsigned ink = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpgt_epi8(block, space), _mm_cmplt_epi8(block, zero)));
+        if (stops != 0)
+        {
+            unsigned first = lowestBit(stops);
+            if ((ink & ((1u << first) - 1)) != 0)
+            {
+                printed = true;
+            }
+            return i + first;
+        }
+        if (ink != 0)
+        {
+            printed = true;
+        }
+    }
+#endif
+
+    for (; i < size; i++)
+    {
+        if (data[i] == (unsigned char)ESC || data[i] == (unsigned char)FF)
+        {
+            return i;
+        }
+        if (data[i] > 0x20)
+        {
+            printed = true;
+        }
+    }
+    return size;
+}
+
+// Little or big endian unsigned integer of size bytes
+static uint64_t readUnsigned(const char *data, size_t size, bool bigEndian)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        unsigned char byte = (unsigned char)data[bigEndian ? i : size - 1 - i];
+        value = (value << 8) | byte;
+    }
+    return value;
+}
+
+void PageAnalyzer::feed(std::string_view data)
+{
+    if (finished || data.empty())
+    {
+        return;
+    }
+    analysis.bytes += data.size();
+
+    if (!carry.empty())
+    {
+        // Complete the cut token with the start of this chunk
+        size_t carried = carry.size();
+        size_t taken = (std::min)(data.size(), MAX_CARRY);
+        carry.append(data.data(), taken);
+        size_t consumed = parse(carry);
+
+        if (consumed < carried)
+        {
+            if (taken == data.size())
+            {
+                position += consumed;
+                carry.erase(0, consumed);
+                return;
+            }
+            // Still cut with MAX_CARRY more bytes: not a token, passed over
+            consumed = carried;
+        }
+
+        position += consumed;
+        data.remove_prefix(consumed - carried);
+        carry.clear();
+    }
+
+    size_t consumed = parse(data);
+    position += consumed;
+    carry.assign(data.data() + consumed, data.size() - consumed);
+}
+
+const PageAnalysis &PageAnalyzer::finish()
+{
+    if (!finished)
+    {
+        finished = true;
+        if (state == STATE_PCL5 && marked)
+        {
+            endPage(analysis.bytes);
+        }
+        carry.clear();
+    }
+    return analysis;
+}
+
+size_t PageAnalyzer::parse(std::string_view data)
+{
+    size_t pos = 0;
+
+    while (pos < data.size())
+    {
+        if (skip > 0)
+        {
+            size_t skipped = (size_t)(std::min)(skip, (uint64_t)(data.size() - pos));
+            skip -= skipped;
+            pos += skipped;
+            continue;
+        }
+
+        State before = state;
+        size_t next;
+        switch (state)
+        {
+        case STATE_PJL:
+            next = parsePjl(data, pos);
+            break;
+        case STATE_PCL5:
+            next = parsePcl5(data, pos);
+            break;
+        case STATE_PCLXL_HEADER:
+        case STATE_PCLXL:
+            next = parsePclXl(data, pos);
+            break;
+        default:
+            next = data.size();
+            break;
+        }
+
+        // No progress: the token at pos needs more data
+        if (next == pos && state == before && skip == 0)
+        {
+            break;
+        }
+        pos = next;
+    }
+
+    return pos;
+}
+
+size_t PageAnalyzer::parsePjl(std::string_view data, size_t pos)
+{
+    while (pos < data.size())
+    {
+        char c = data[pos];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+        {
+            pos++;
+            continue;
+        }
+
+        if (c == ESC && isUelPrefix(data, pos))
+        {
+            if (data.size() - pos < UEL.size())
+            {
+                return pos;
+            }
+            pos += UEL.size();
+            continue;
+        }
+
+        if (startsWithNoCase(data, pos, "@PJL"))
+        {
+            size_t lineEnd = data.find('\n', pos);
+            if (lineEnd == std::string_view::npos)
+            {
+                // A line that long is not PJL, the data starts here
+                if (data.size() - pos < MAX_CARRY)
+                {
+                    return pos;
+                }
+                state = STATE_OTHER;
+                return pos;
+            }
+
+            std::string line(data.substr(pos, lineEnd - pos));
+            for (char &ch : line)
+            {
+                ch = (char)std::toupper((unsigned char)ch);
+            }
+            pos = lineEnd + 1;
+
+            size_t equals = line.find('=');
+            std::string value;
+            if (equals != std::string::npos)
+            {
+                size_t start = line.find_first_not_of(" \t", equals + 1);
+                size_t end = line.find_last_not_of(" \t\r");
+                if (start != std::string::npos && end >= start)
+                {
+                    value = line.substr(start, end - start + 1);
+                }
+            }
+
+            if (analysis.language == FORMAT_UNKNOWN)
+            {
+                analysis.language = FORMAT_PJL;
+            }
+
+            if (line.find("ENTER") != std::string::npos && line.find("LANGUAGE") != std::string::npos)
+            {
+                if (value.compare(0, 5, "PCLXL") == 0)
+                {
+                    analysis.language = FORMAT_PCLXL;
+                    state = STATE_PCLXL_HEADER;
+                }
+                else if (value.compare(0, 3, "PCL") == 0)
+                {
+                    analysis.language = FORMAT_PCL5;
+                    state = STATE_PCL5;
+                }
+                else
+                {
+                    if (value.compare(0, 10, "POSTSCRIPT") == 0)
+                    {
+                        analysis.language = FORMAT_POSTSCRIPT;
+                    }
+                    else if (value.compare(0, 3, "PDF") == 0)
+                    {
+                        analysis.language = FORMAT_PDF;
+                    }
+                    state = STATE_OTHER;
+                }
+                return pos;
+            }
+
+            if (line.find("SET") != std::string::npos && !value.empty())
+            {
+                size_t name = line.find("SET");
+                std::string setting = line.substr(name + 3, equals - name - 3);
+                if (setting.find("COPIES") != std::string::npos || setting.find("QTY") != std::string::npos)
+                {
+                    int copies = std::atoi(value.c_str());
+                    if (copies > 0)
+                    {
+                        analysis.copies = copies;
+                    }
+                }
+                else if (setting.find("DUPLEX") != std::string::npos)
+                {
+                    analysis.duplex = value.compare(0, 2, "ON") == 0;
+                }
+            }
+            continue;
+        }
+
+        // Not PJL: the data behind the header tells its language
+        if (c == ESC)
+        {
+            analysis.language = FORMAT_PCL5;
+            state = STATE_PCL5;
+            return pos;
+        }
+        if (c == ')' || c == '(' || c == '\'')
+        {
+            static const std::string_view PCLXL_HEADER = " HP-PCL XL";
+            size_t available = (std::min)(data.size() - pos - 1, PCLXL_HEADER.size());
+            if (data.compare(pos + 1, available, PCLXL_HEADER.substr(0, available)) == 0)
+            {
+                if (available < PCLXL_HEADER.size())
+                {
+                    return pos;
+                }
+                analysis.language = FORMAT_PCLXL;
+                state = STATE_PCLXL_HEADER;
+                return pos;
+            }
+        }
+        // Possibly the start of a cut @PJL line
+        if (data.size() - pos < 4 && c == '@')
+        {
+            return pos;
+        }
+
+        DocumentFormat format = sniffDocumentFormat(data.substr(pos));
+        if (format != FORMAT_UNKNOWN && format != FORMAT_PJL)
+        {
+            analysis.language = format;
+        }
+        state = STATE_OTHER;
+        return pos;
+    }
+    return pos;
+}
+
+size_t PageAnalyzer::parsePcl5(std::string_view data, size_t pos)
+{
+    while (pos < data.size())
+    {
+        pos += scanText((const unsigned char *)data.data() + pos, data.size() - pos, marked);
+        if (pos == data.size())
+        {
+            break;
+        }
+
+        if (data[pos] == FF)
+        {
+            pos++;
+            if (marked)
+            {
+                endPage(position + pos);
+            }
+            continue;
+        }
+
+        size_t next = parsePcl5Escape(data, pos);
+        if (next == pos || state != STATE_PCL5 || skip > 0)
+        {
+            return next;
+        }
+        pos = next;
+    }
+    return pos;
+}
+
+size_t PageAnalyzer::parsePcl5Escape(std::string_view data, size_t pos)
+{
+    if (pos + 1 >= data.size())
+    {
+        return pos;
+    }
+
+    char command = data[pos + 1];
+
+    if (command == '%' && isUelPrefix(data, pos))
+    {
+        if (data.size() - pos < UEL.size())
+        {
+            return pos;
+        }
+        // Back to PJL, which ends the page in progress
+        if (marked)
+        {
+            endPage(position + pos);
+        }
+        state = STATE_PJL;
+        return pos;
+    }
+
+    // Two character sequences: ESC E resets the printer
+    if (command >= 0x30 && command <= 0x7E)
+    {
+        if (command == 'E' && marked)
+        {
+            endPage(position + pos + 2);
+        }
+        return pos + 2;
+    }
+
+    if (command < 0x21 || command > 0x2F)
+    {
+        return pos + 1;
+    }
+
+    // Parameterized: ESC, parameterized character, group character (none
+    // after %), then value/parameter pairs; a lower case parameter chains
+    size_t i = pos + 2;
+    char group = '\0';
+    if (command != '%')
+    {
+        if (i >= data.size())
+        {
+            return pos;
+        }
+        group = data[i];
+        if (group < 0x60 || group > 0x7E)
+        {
+            return i;
+        }
+        i++;
+    }
+
+    while (true)
+    {
+        size_t valueStart = i;
+        while (i < data.size() && (std::isdigit((unsigned char)data[i]) || data[i] == '+' || data[i] == '-' || data[i] == '.'))
+        {
+            i++;
+        }
+        if (i >= data.size())
+        {
+            // A run of digits that long is not a sequence, passed over
+            return i - pos > MAX_ESCAPE ? i : pos;
+        }
+
+        char parameter = data[i++];
+        double value = valueStart < i - 1 ? std::atof(std::string(data.substr(valueStart, i - 1 - valueStart)).c_str()) : 0;
+
+        if (parameter >= 0x60 && parameter <= 0x7E)
+        {
+            pcl5Command(command, group, (char)(parameter - 0x20), value, position + i);
+            if (i - pos > MAX_ESCAPE)
+            {
+                return i;
+            }
+            continue;
+        }
+        if (parameter >= 0x40 && parameter <= 0x5E)
+        {
+            pcl5Command(command, group, parameter, value, position + i);
+        }
+        return i;
+    }
+}
+
+void PageAnalyzer::pcl5Command(char command, char group, char parameter, double value, uint64_t offset)
+{
+    // Binary data follows: raster rows, fonts, macros, transparent data
+    if (parameter == 'W' || (command == '&' && group == 'p' && parameter == 'X'))
+    {
+        if (value > 0)
+        {
+            skip += (uint64_t)value;
+        }
+        if (group == 'b' || group == 'p')
+        {
+            marked = true;
+        }
+        return;
+    }
+
+    if (command == '&' && group == 'l')
+    {
+        switch (parameter)
+        {
+        case 'X':
+            if (value >= 1)
+            {
+                analysis.copies = (int)value;
+            }
+            break;
+        case 'S':
+            // A duplex change starts a new sheet
+            analysis.duplex = value == 1 || value == 2;
+            // Fall through
+        case 'A':
+        case 'H':
+        case 'O':
+            if (marked)
+            {
+                endPage(offset);
+            }
+            break;
+        default:
+            break;
+        }
+        return;
+    }
+
+    // Rectangle fill and raster graphics put something on the page
+    if (command == '*' && ((group == 'c' && parameter == 'P') || (group == 'r' && parameter == 'B')))
+    {
+        marked = true;
+    }
+}
+
+size_t PageAnalyzer::parsePclXl(std::string_view data, size_t pos)
+{
+    if (state == STATE_PCLXL_HEADER)
+    {
+        // Binding byte, " HP-PCL XL;protocol;revision;comment" and a line feed
+        size_t lineEnd = data.find('\n', pos);
+        if (lineEnd == std::string_view::npos)
+        {
+            if (data.size() - pos < MAX_CARRY)
+            {
+                return pos;
+            }
+            state = STATE_OTHER;
+            return pos;
+        }
+        switch (data[pos])
+        {
+        case ')':
+            bigEndian = false;
+            state = STATE_PCLXL;
+            break;
+        case '(':
+            bigEndian = true;
+            state = STATE_PCLXL;
+            break;
+        default:
+            // ASCII binding is not analyzed
+            state = STATE_OTHER;
+            break;
+        }
+        return lineEnd + 1;
+    }
+
+    // Sizes of the ubyte, uint16, uint32, sint16, sint32 and real32 data types
+    static const size_t TYPE_SIZES[] = {1, 2, 4, 2, 4, 4};
+
+    while (pos < data.size())
+    {
+        unsigned char tag = (unsigned char)data[pos];
+        size_t available = data.size() - pos - 1;
+        const char *operand = data.data() + pos + 1;
+
+        if (tag == (unsigned char)ESC)
+        {
+            // UEL ends the PCL XL session
+            state = STATE_PJL;
+            return pos;
+        }
+
+        if (tag >= 0xC0 && tag <= 0xC5)
+        {
+            size_t size = TYPE_SIZES[tag - 0xC0];
+            if (available < size)
+            {
+                return pos;
+            }
+            uint64_t value = readUnsigned(operand, size, bigEndian);
+            switch (tag)
+            {
+            case 0xC3:
+                lastValue = (int16_t)value;
+                break;
+            case 0xC4:
+                lastValue = (int32_t)value;
+                break;
+            case 0xC5:
+                lastValue = 0;
+                break;
+            default:
+                lastValue = (int64_t)value;
+                break;
+            }
+            pos += 1 + size;
+        }
+        else if (tag >= 0xC8 && tag <= 0xCD)
+        {
+            // Array: element type, then its length as a ubyte or uint16
+            if (available < 2)
+            {
+                return pos;
+            }
+            unsigned char lengthTag = (unsigned char)operand[0];
+            size_t lengthSize = lengthTag == 0xC0 ? 1 : lengthTag == 0xC1 ? 2 : 0;
+            if (lengthSize == 0)
+            {
+                pos++;
+                continue;
+            }
+            if (available < 1 + lengthSize)
+            {
+                return pos;
+            }
+            uint64_t count = readUnsigned(operand + 1, lengthSize, bigEndian);
+            pos += 2 + lengthSize;
+            skip = count * TYPE_SIZES[tag - 0xC8];
+            return pos;
+        }
+        else if ((tag >= 0xD0 && tag <= 0xD5) || (tag >= 0xE0 && tag <= 0xE5))
+        {
+            // xy pairs and boxes of the same data types
+            size_t size = TYPE_SIZES[tag & 0x0F] * (tag >= 0xE0 ? 4 : 2);
+            if (available < size)
+            {
+                return pos;
+            }
+            pos += 1 + size;
+        }
+        else if (tag == 0xF8 || tag == 0xF9)
+        {
+            size_t size = tag == 0xF8 ? 1 : 2;
+            if (available < size)
+            {
+                return pos;
+            }
+            int attribute = (int)readUnsigned(operand, size, bigEndian);
+            if (attribute == PCLXL_PAGE_COPIES && lastValue > 0)
+            {
+                analysis.copies = (int)lastValue;
+            }
+            else if (attribute == PCLXL_DUPLEX_PAGE_MODE)
+            {
+                analysis.duplex = true;
+            }
+            pos += 1 + size;
+        }
+        else if (tag == 0xFA || tag == 0xFB)
+        {
+            // Embedded data with a uint32 or ubyte length
+            size_t size = tag == 0xFA ? 4 : 1;
+            if (available < size)
+            {
+                return pos;
+            }
+            skip = readUnsigned(operand, size, bigEndian);
+            pos += 1 + size;
+            return pos;
+        }
+        else
+        {
+            pos++;
+            if (tag == PCLXL_END_PAGE)
+            {
+                endPage(position + pos);
+            }
+        }
+    }
+    return pos;
+}
+
+void PageAnalyzer::endPage(uint64_t offset)
+{
+    analysis.pages++;
+    analysis.pageEnds.push_back(offset);
+    marked = false;
+}
+
+ErrorMessage *analyzeFile(const std::string &path, PageAnalysis &analysis, OperationContext *context)
+{
+#ifdef _WIN32
+    int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+    std::wstring widePath(length > 0 ? length : 1, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &widePath[0], length);
+    FILE *file = _wfopen(widePath.c_str(), L"rb");
+#else
+    FILE *file = fopen(path.c_str(), "rb");
+#endif
+    if (file == NULL)
+    {
+        static ErrorMessage errorMsg = "Could not open file";
+        return &errorMsg;
+    }
+
+    static const size_t CHUNK_SIZE = 1024 * 1024;
+    std::unique_ptr<char[]> buffer(new char[CHUNK_SIZE]);
+    PageAnalyzer analyzer;
+    ErrorMessage *errorMessage = NULL;
+
+    while (true)
+    {
+        if (context != NULL && context->stopped())
+        {
+            errorMessage = context->error();
+            break;
+        }
+        size_t read = fread(buffer.get(), 1, CHUNK_SIZE, file);
+        analyzer.feed(std::string_view(buffer.get(), read));
+        if (read < CHUNK_SIZE)
+        {
+            if (ferror(file))
+            {
+                static ErrorMessage errorMsg = "Error on reading file";
+                errorMessage = &errorMsg;
+            }
+            break;
+        }
+    }
+    fclose(file);
+
+    analysis = analyzer.finish();
+    return errorMessage;
+}
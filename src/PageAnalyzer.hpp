@@ -0,0 +1,84 @@
+#ifndef PAGE_ANALYZER_HPP
+#define PAGE_ANALYZER_HPP
+
+#include "PrinterManager.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct PageAnalysis
+{
+    // PCL5 or PCLXL once recognized, PJL when nothing followed the PJL header,
+    // anything else means the data is not PCL and pages stays 0
+    DocumentFormat language = FORMAT_UNKNOWN;
+    int pages = 0;
+    // Last copy count asked for by PJL (COPIES, QTY), PCL5 (ESC &l#X) or PCL XL (PageCopies)
+    int copies = 1;
+    // A duplex mode was selected by PJL, PCL5 (ESC &l1S, ESC &l2S) or PCL XL (DuplexPageMode)
+    bool duplex = false;
+    // Offset just past the end of every page
+    std::vector<uint64_t> pageEnds;
+    uint64_t bytes = 0;
+};
+
+/**
+ * Streaming page counter for PJL wrapped PCL5 and PCL XL jobs, fed in chunks
+ * of any size. Raster rows, fonts and PCL XL embedded data are skipped by
+ * their announced length, and PCL5 text is scanned for ESC and FF 16 bytes at
+ * a time with SSE2 where available (not with NODE_PRINTING_NO_SSE2), so
+ * archives are read at close to memory bandwidth. Tokens cut by a chunk boundary are carried over to the next one.
+ *
+ * PCL5 pages end with FF, and with a reset or page setup command (ESC E,
+ * ESC &l#A/H/O/S) when something was printed since the last page.
+ * PCL XL pages end with EndPage.
+ */
+class PageAnalyzer
+{
+public:
+    void feed(std::string_view data);
+    // Counts a PCL5 page left open at the end of the data
+    const PageAnalysis &finish();
+
+    const PageAnalysis &result() const { return analysis; }
+
+private:
+    enum State
+    {
+        STATE_PJL,
+        STATE_PCL5,
+        STATE_PCLXL_HEADER,
+        STATE_PCLXL,
+        // Data in a language not analyzed, the rest is only counted
+        STATE_OTHER
+    };
+
+    size_t parse(std::string_view data);
+    size_t parsePjl(std::string_view data, size_t pos);
+    size_t parsePcl5(std::string_view data, size_t pos);
+    size_t parsePcl5Escape(std::string_view data, size_t pos);
+    size_t parsePclXl(std::string_view data, size_t pos);
+    void endPage(uint64_t offset);
+    void pcl5Command(char command, char group, char parameter, double value, uint64_t offset);
+
+    PageAnalysis analysis;
+    State state = STATE_PJL;
+    // Absolute offset of the data handed to parse
+    uint64_t position = 0;
+    // Bytes of binary payload still to skip
+    uint64_t skip = 0;
+    std::string carry;
+
+    // PCL5: something printed since the last page break
+    bool marked = false;
+    // PCL XL: stream byte order and the last integer value read
+    bool bigEndian = false;
+    int64_t lastValue = 0;
+    bool finished = false;
+};
+
+// Reads a whole file through a PageAnalyzer in fixed size chunks
+ErrorMessage *analyzeFile(const std::string &path, PageAnalysis &analysis, OperationContext *context = NULL);
+
+#endif
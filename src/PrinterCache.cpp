@@ -0,0 +1,343 @@
+#include "PrinterCache.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+PrinterCache &PrinterCache::getInstance()
+{
+    static PrinterCache instance;
+    return instance;
+}
+
+void PrinterCache::setOptions(int ttlMs, int checkIntervalMs)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    ttl = std::chrono::milliseconds(ttlMs > 0 ? ttlMs : 0);
+    checkInterval = std::chrono::milliseconds(checkIntervalMs > 0 ? checkIntervalMs : 0);
+
+    if (ttl == Clock::duration::zero())
+    {
+        printers.clear();
+        aliases.clear();
+        listing.clear();
+        listValid = false;
+    }
+}
+
+void PrinterCache::getOptions(int &ttlMs, int &checkIntervalMs)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    ttlMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(ttl).count();
+    checkIntervalMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(checkInterval).count();
+}
+
+PrinterCache::Freshness PrinterCache::getFreshness(const Entry &entry, Clock::time_point now)
+{
+    if (now - entry.fetched >= ttl)
+    {
+        return EXPIRED;
+    }
+    if (now - entry.checked >= checkInterval)
+    {
+        return CHECK;
+    }
+    return FRESH;
+}
+
+PrinterCache::Entries::iterator PrinterCache::find(std::string_view name)
+{
+    Entries::iterator entry = printers.find(name);
+    if (entry != printers.end())
+    {
+        return entry;
+    }
+
+    std::map<std::string, std::string, std::less<>>::const_iterator alias = aliases.find(name);
+    return alias != aliases.end() ? printers.find(alias->second) : printers.end();
+}
+
+void PrinterCache::store(const PrinterInfo &printerInfo, const PrinterChangeTimes &changeTimes, Clock::time_point now)
+{
+    Entry &entry = printers[printerInfo.name];
+    entry.info = printerInfo;
+    entry.fetched = now;
+    entry.checked = now;
+
+    PrinterChangeTimes::const_iterator changeTime = changeTimes.find(printerInfo.name);
+    entry.changeTime = changeTime != changeTimes.end() ? changeTime->second : PrinterChangeTime();
+}
+
+void PrinterCache::erase(std::string_view name)
+{
+    // An alias takes its canonical entry along, a canonical name every alias of it
+    std::string canonical(name);
+    std::map<std::string, std::string, std::less<>>::iterator alias = aliases.find(name);
+    if (alias != aliases.end())
+    {
+        canonical = alias->second;
+        aliases.erase(alias);
+    }
+
+    if (printers.erase(canonical) > 0)
+    {
+        stats.invalidations++;
+    }
+
+    for (alias = aliases.begin(); alias != aliases.end();)
+    {
+        alias = alias->second == canonical ? aliases.erase(alias) : std::next(alias);
+    }
+}
+
+ErrorMessage *PrinterCache::getPrinters(std::vector<PrinterInfo> &printersInfo, unsigned fields, OperationContext *context)
+{
+    PrinterManager &printerManager = PrinterManager::getInstance();
+    bool hasChangeTimes = printerManager.hasPrinterChangeTimes();
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (ttl == Clock::duration::zero())
+    {
+        stats.misses++;
+        lock.unlock();
+        return printerManager.getPrinters(printersInfo, fields, context);
+    }
+
+    Clock::time_point now = Clock::now();
+
+    if (listValid)
+    {
+        Freshness freshness = FRESH;
+        for (const std::string &name : listing)
+        {
+            Entries::iterator entry = printers.find(name);
+            if (entry == printers.end())
+            {
+                freshness = EXPIRED;
+                break;
+            }
+            freshness = std::max(freshness, getFreshness(entry->second, now));
+        }
+
+        // Nothing to revalidate against, the listing is kept until ttl
+        if (freshness == CHECK && !hasChangeTimes)
+        {
+            freshness = FRESH;
+        }
+
+        if (freshness == CHECK)
+        {
+            std::vector<std::string> names = listing;
+            std::vector<PrinterChangeTime> known;
+            for (const std::string &name : names)
+            {
+                known.push_back(printers[name].changeTime);
+            }
+
+            // A queue added, removed or changed since the last listing shows up in the change times
+            lock.unlock();
+            PrinterChangeTimes changeTimes;
+            bool unchanged = printerManager.getPrinterChangeTimes(changeTimes, context) == NULL &&
+                             changeTimes.size() == names.size();
+            lock.lock();
+
+            // Entries replaced or dropped meanwhile are not vouched for by these change times
+            unchanged = unchanged && listValid && listing == names;
+            for (size_t i = 0; unchanged && i < names.size(); ++i)
+            {
+                PrinterChangeTimes::const_iterator changeTime = changeTimes.find(names[i]);
+                Entries::iterator entry = printers.find(names[i]);
+                unchanged = changeTime != changeTimes.end() && changeTime->second == known[i] &&
+                            entry != printers.end() && entry->second.changeTime == known[i];
+            }
+
+            if (unchanged)
+            {
+                for (const std::string &name : listing)
+                {
+                    printers[name].checked = now;
+                }
+                stats.revalidations++;
+                freshness = FRESH;
+            }
+            else
+            {
+                stats.invalidations++;
+            }
+        }
+
+        if (freshness == FRESH)
+        {
+            stats.hits++;
+            for (const std::string &name : listing)
+            {
+                printersInfo.push_back(printers[name].info);
+                printersInfo.back().fields = fields;
+            }
+            return NULL;
+        }
+    }
+
+    stats.misses++;
+    lock.unlock();
+
+    std::vector<PrinterInfo> fetched;
+    ErrorMessage *errorMessage = printerManager.getPrinters(fetched, PRINTER_FIELDS_ALL, context);
+    if (errorMessage != NULL)
+    {
+        lock.lock();
+        listValid = false;
+        return errorMessage;
+    }
+
+    // Change times are taken after the listing, a change in between only costs an extra fetch
+    PrinterChangeTimes changeTimes;
+    if (hasChangeTimes)
+    {
+        printerManager.getPrinterChangeTimes(changeTimes, context);
+    }
+
+    lock.lock();
+    listing.clear();
+    for (const PrinterInfo &printerInfo : fetched)
+    {
+        store(printerInfo, changeTimes, now);
+        listing.push_back(printerInfo.name);
+    }
+    listValid = true;
+    lock.unlock();
+
+    for (PrinterInfo &printerInfo : fetched)
+    {
+        printerInfo.fields = fields;
+        printersInfo.push_back(printerInfo);
+    }
+
+    return NULL;
+}
+
+ErrorMessage *PrinterCache::getOnePrinter(std::string_view name, PrinterInfo &printerInfo, unsigned fields, OperationContext *context)
+{
+    PrinterManager &printerManager = PrinterManager::getInstance();
+    bool hasChangeTimes = printerManager.hasPrinterChangeTimes();
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (ttl == Clock::duration::zero())
+    {
+        stats.misses++;
+        lock.unlock();
+        return printerManager.getOnePrinter(name, printerInfo, fields, context);
+    }
+
+    Clock::time_point now = Clock::now();
+
+    // Looked up by the view itself, a key string is only built when the entry is stored
+    Entries::iterator entry = find(name);
+    if (entry != printers.end())
+    {
+        Freshness freshness = getFreshness(entry->second, now);
+
+        // Nothing to revalidate against, the entry is kept until ttl
+        if (freshness == CHECK && !hasChangeTimes)
+        {
+            freshness = FRESH;
+        }
+
+        if (freshness == CHECK)
+        {
+            // Change times are listed under the canonical name the entry is stored under
+            std::string canonical = entry->first;
+            PrinterChangeTime known = entry->second.changeTime;
+
+            lock.unlock();
+            PrinterChangeTimes changeTimes;
+            PrinterChangeTimes::const_iterator changeTime;
+            bool unchanged = printerManager.getPrinterChangeTimes(changeTimes, context) == NULL &&
+                             (changeTime = changeTimes.find(canonical)) != changeTimes.end() && changeTime->second == known;
+            lock.lock();
+
+            entry = printers.find(canonical);
+            if (unchanged && entry != printers.end() && entry->second.changeTime == known)
+            {
+                entry->second.checked = now;
+                stats.revalidations++;
+                freshness = FRESH;
+            }
+            else
+            {
+                stats.invalidations++;
+            }
+        }
+
+        if (freshness == FRESH)
+        {
+            stats.hits++;
+            printerInfo = entry->second.info;
+            printerInfo.fields = fields;
+            return NULL;
+        }
+    }
+
+    stats.misses++;
+    lock.unlock();
+
+    PrinterInfo fetched;
+    ErrorMessage *errorMessage = printerManager.getOnePrinter(name, fetched, PRINTER_FIELDS_ALL, context);
+    if (errorMessage != NULL)
+    {
+        lock.lock();
+        erase(name);
+        return errorMessage;
+    }
+
+    PrinterChangeTimes changeTimes;
+    if (hasChangeTimes)
+    {
+        printerManager.getPrinterChangeTimes(changeTimes, context);
+    }
+
+    lock.lock();
+    store(fetched, changeTimes, now);
+    // getOnePrinter may report the queue under its canonical name
+    if (fetched.name != name)
+    {
+        aliases[std::string(name)] = fetched.name;
+    }
+    lock.unlock();
+
+    printerInfo = fetched;
+    printerInfo.fields = fields;
+
+    return NULL;
+}
+
+void PrinterCache::invalidate()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!printers.empty())
+    {
+        stats.invalidations++;
+    }
+    printers.clear();
+    aliases.clear();
+    listing.clear();
+    listValid = false;
+}
+
+void PrinterCache::invalidate(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    erase(name);
+}
+
+PrinterCacheStats PrinterCache::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    PrinterCacheStats result = stats;
+    result.entries = printers.size();
+    return result;
+}
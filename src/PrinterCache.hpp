@@ -0,0 +1,93 @@
+#ifndef PRINTER_CACHE_HPP
+#define PRINTER_CACHE_HPP
+
+#include "PrinterManager.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct PrinterCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t revalidations = 0;
+    uint64_t invalidations = 0;
+    size_t entries = 0;
+};
+
+/**
+ * Process wide cache of the PrinterInfo returned by getPrinters/getOnePrinter.
+ *
+ * Entries younger than checkInterval are served from memory. Older ones are
+ * revalidated against the spooler change times (printer-state-change-time /
+ * printer-config-change-time on CUPS), a request much cheaper than rebuilding
+ * the PrinterInfo: unchanged entries are kept, changed ones are fetched again.
+ * Nothing is kept longer than ttl, and backends without change times simply
+ * expire entries after ttl. A ttl of 0 disables the cache.
+ * The lock only guards the entries, spooler requests are made without it.
+ */
+class PrinterCache
+{
+public:
+    static PrinterCache &getInstance();
+
+    void setOptions(int ttlMs, int checkIntervalMs);
+    void getOptions(int &ttlMs, int &checkIntervalMs);
+
+    // Entries always hold every field, fields only narrows what the results report.
+    // context bounds the spooler requests of a miss or revalidation
+    ErrorMessage *getPrinters(std::vector<PrinterInfo> &printersInfo, unsigned fields = PRINTER_FIELDS_ALL, OperationContext *context = NULL);
+    ErrorMessage *getOnePrinter(std::string_view name, PrinterInfo &printerInfo, unsigned fields = PRINTER_FIELDS_ALL, OperationContext *context = NULL);
+
+    // Drop every entry, or only one printer, the next read goes to the spooler
+    void invalidate();
+    void invalidate(const std::string &name);
+
+    PrinterCacheStats getStats();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry
+    {
+        PrinterInfo info;
+        PrinterChangeTime changeTime;
+        Clock::time_point fetched;
+        Clock::time_point checked;
+    };
+
+    // Transparent comparator so lookups by std::string_view need no key string
+    typedef std::map<std::string, Entry, std::less<>> Entries;
+
+    enum Freshness
+    {
+        FRESH,
+        CHECK,
+        EXPIRED
+    };
+
+    Freshness getFreshness(const Entry &entry, Clock::time_point now);
+    // Entry of a name or of the name it is an alias of
+    Entries::iterator find(std::string_view name);
+    void store(const PrinterInfo &printerInfo, const PrinterChangeTimes &changeTimes, Clock::time_point now);
+    void erase(std::string_view name);
+
+    std::mutex mutex;
+    Clock::duration ttl = Clock::duration::zero();
+    Clock::duration checkInterval = std::chrono::seconds(1);
+
+    Entries printers;
+    // Names getOnePrinter was asked for, to the canonical name the entry is stored under
+    std::map<std::string, std::string, std::less<>> aliases;
+    // Names in the order of the last full listing, valid while listValid
+    std::vector<std::string> listing;
+    bool listValid = false;
+
+    PrinterCacheStats stats;
+};
+
+#endif
@@ -0,0 +1,358 @@
+#include "PrinterManager.hpp"
+#include "RasterEncoder.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <thread>
+
+// * ___________________________________________________________________________
+// *
+// *              Platform independent PrinterManager Implementation
+// * ___________________________________________________________________________
+
+void OperationContext::setTimeout(int timeoutMs)
+{
+    deadline = Clock::now() + std::chrono::milliseconds(timeoutMs > 0 ? timeoutMs : 0);
+    hasDeadline = true;
+}
+
+void OperationContext::follow(const std::vector<const OperationContext *> &contexts)
+{
+    followed = contexts;
+    if (contexts.empty())
+    {
+        return;
+    }
+
+    // Like cancellation, the deadline only stops the call once it stops every one of them
+    hasDeadline = true;
+    deadline = Clock::time_point::min();
+    for (const OperationContext *context : contexts)
+    {
+        if (!context->hasDeadline)
+        {
+            hasDeadline = false;
+            return;
+        }
+        deadline = std::max(deadline, context->deadline);
+    }
+}
+
+bool OperationContext::allCancelled() const
+{
+    if (followed.empty())
+    {
+        return false;
+    }
+    for (const OperationContext *context : followed)
+    {
+        if (!context->cancelled)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OperationContext::stopped() const
+{
+    return cancelled || allCancelled() || (hasDeadline && Clock::now() >= deadline);
+}
+
+int OperationContext::remainingMs(int limit) const
+{
+    if (!hasDeadline)
+    {
+        return limit;
+    }
+
+    long long remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+    if (remaining <= 0)
+    {
+        return 0;
+    }
+    return remaining < limit ? (int)remaining : limit;
+}
+
+ErrorMessage *OperationContext::error() const
+{
+    if (cancelled || allCancelled())
+    {
+        static ErrorMessage errorMsg = "Operation aborted";
+        return &errorMsg;
+    }
+    if (hasDeadline && Clock::now() >= deadline)
+    {
+        static ErrorMessage errorMsg = "Operation timed out";
+        return &errorMsg;
+    }
+    return NULL;
+}
+
+PrinterManager &PrinterManager::getInstance()
+{
+    static PrinterManager instance;
+    return instance;
+}
+
+std::string PrinterManager::resolveType(const std::string &type, std::string_view data)
+{
+    if (!isAutoType(type))
+    {
+        return type;
+    }
+    return getSniffedType(sniffDocumentFormat(data));
+}
+
+static const char UEL[] = "\x1B%-12345X";
+
+static bool equalsNoCase(const std::string &value, const char *other)
+{
+    size_t i = 0;
+    for (; i < value.size() && other[i] != '\0'; i++)
+    {
+        if (std::toupper((unsigned char)value[i]) != std::toupper((unsigned char)other[i]))
+        {
+            return false;
+        }
+    }
+    return i == value.size() && other[i] == '\0';
+}
+
+// Types the spooler hands to the printer untouched, the only ones a PJL ticket can go in front of
+static bool isRawType(const std::string &type)
+{
+    return type.empty() || equalsNoCase(type, "RAW") || equalsNoCase(type, "application/vnd.cups-raw");
+}
+
+// Quoted PJL strings end at a quote or a line break, those are left out
+static std::string getPjlString(const std::string &value)
+{
+    std::string result;
+    for (char c : value)
+    {
+        if ((unsigned char)c >= 0x20 && c != '"')
+        {
+            result.push_back(c);
+        }
+    }
+    return result;
+}
+
+// PJL keywords are upper case letters and digits
+static std::string getPjlKeyword(const std::string &value)
+{
+    std::string result;
+    for (char c : value)
+    {
+        if (std::isalnum((unsigned char)c))
+        {
+            result.push_back((char)std::toupper((unsigned char)c));
+        }
+    }
+    return result;
+}
+
+static std::string getPjlPrologue(const JobTicket &ticket)
+{
+    std::string prologue = UEL;
+
+    // Settings made inside JOB/EOJ fall back to the panel defaults when the job ends
+    prologue += "@PJL JOB";
+    if (!ticket.jobName.empty())
+    {
+        prologue += " NAME=\"" + getPjlString(ticket.jobName) + "\"";
+    }
+    prologue += "\r\n";
+
+    if (ticket.fields & TICKET_FIELD_COPIES)
+    {
+        prologue += "@PJL SET COPIES=" + std::to_string(ticket.copies > 0 ? ticket.copies : 1) + "\r\n";
+    }
+    if (ticket.fields & TICKET_FIELD_DUPLEX)
+    {
+        // VERTICAL flips on the long edge of a portrait page, HORIZONTAL on the short one
+        switch (ticket.duplex)
+        {
+        case VERTICAL:
+            prologue += "@PJL SET DUPLEX=ON\r\n@PJL SET BINDING=LONGEDGE\r\n";
+            break;
+        case HORIZONTAL:
+            prologue += "@PJL SET DUPLEX=ON\r\n@PJL SET BINDING=SHORTEDGE\r\n";
+            break;
+        default:
+            prologue += "@PJL SET DUPLEX=OFF\r\n";
+            break;
+        }
+    }
+    if (ticket.fields & TICKET_FIELD_ORIENTATION)
+    {
+        prologue += "@PJL SET ORIENTATION=" + orientation_str.at(ticket.orientation) + "\r\n";
+    }
+    if (ticket.fields & TICKET_FIELD_COLOR)
+    {
+        prologue += ticket.color == COLOR ? "@PJL SET RENDERMODE=COLOR\r\n" : "@PJL SET RENDERMODE=GRAYSCALE\r\n";
+    }
+    if (ticket.fields & TICKET_FIELD_PRINT_QUALITY)
+    {
+        // PJL has no quality levels, the low ones save toner
+        prologue += ticket.printQuality <= LOW ? "@PJL SET ECONOMODE=ON\r\n" : "@PJL SET ECONOMODE=OFF\r\n";
+    }
+    if (!ticket.tray.empty())
+    {
+        prologue += "@PJL SET MEDIASOURCE=" + getPjlKeyword(ticket.tray) + "\r\n";
+    }
+
+    return prologue;
+}
+
+static std::string getPjlEpilogue(const JobTicket &ticket)
+{
+    std::string epilogue = UEL;
+    epilogue += "@PJL EOJ";
+    if (!ticket.jobName.empty())
+    {
+        epilogue += " NAME=\"" + getPjlString(ticket.jobName) + "\"";
+    }
+    epilogue += "\r\n";
+    epilogue += UEL;
+    return epilogue;
+}
+
+ErrorMessage *PrinterManager::startJob(std::string_view name, const std::string &docName, const std::string &type, const JobTicket &ticket, PrintJob &job, OperationContext *context)
+{
+    // Left over by a cancelled job
+    job.epilogue.clear();
+
+    if (ticket.empty())
+    {
+        return startJob(name, docName, type, job, context);
+    }
+
+    // The ticket makes the job PJL whatever follows it, so a streamed AUTO job (not sniffed,
+    // its data is still to come) goes out as the raw type
+    std::string jobType = isAutoType(type) ? getSniffedType(FORMAT_PJL) : type;
+    if (!isRawType(jobType))
+    {
+        static ErrorMessage errorMsg = "A job ticket needs RAW data";
+        return &errorMsg;
+    }
+
+    ErrorMessage *errorMessage = startJob(name, docName, jobType, job, context);
+    if (errorMessage != NULL)
+    {
+        return errorMessage;
+    }
+
+    // A few hundred bytes written on their own, the document itself is never copied to prepend them
+    errorMessage = writeJob(job, getPjlPrologue(ticket), context);
+    if (errorMessage != NULL)
+    {
+        cancelJob(job);
+        return errorMessage;
+    }
+    job.epilogue = getPjlEpilogue(ticket);
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::printDirect(std::string_view name, const std::string &docName, const std::string &type, std::string_view data, int &jobId, OperationContext *context)
+{
+    return printDirect(name, docName, type, JobTicket(), data, jobId, context);
+}
+
+ErrorMessage *PrinterManager::printDirect(std::string_view name, const std::string &docName, const std::string &type, const JobTicket &ticket, std::string_view data, int &jobId, OperationContext *context)
+{
+    PrintJob job;
+
+    ErrorMessage *errorMessage = startJob(name, docName, resolveType(type, data), ticket, job, context);
+    if (errorMessage != NULL)
+    {
+        return errorMessage;
+    }
+
+    jobId = job.id;
+
+    errorMessage = writeJob(job, data, context);
+    if (errorMessage != NULL)
+    {
+        cancelJob(job);
+        return errorMessage;
+    }
+
+    errorMessage = endJob(job, context);
+    // Stopped while the spooler took the document, or the ticket epilogue was not written
+    // and the job is still open: do not leave half a job behind
+    if (errorMessage != NULL && ((context != NULL && context->stopped()) || job.handle != NULL))
+    {
+        cancelJob(job);
+    }
+
+    return errorMessage;
+}
+
+ErrorMessage *PrinterManager::printRaster(std::string_view name, const std::string &docName, const std::vector<RasterPage> &pages, const RasterOptions &options, int &jobId, OperationContext *context)
+{
+    if (pages.empty())
+    {
+        static ErrorMessage errorMsg = "Raster job has no pages";
+        return &errorMsg;
+    }
+    if (options.resolution <= 0)
+    {
+        static ErrorMessage errorMsg = "Raster resolution must be positive";
+        return &errorMsg;
+    }
+    for (const RasterPage &page : pages)
+    {
+        ErrorMessage *errorMessage = checkRasterPage(page);
+        if (errorMessage != NULL)
+        {
+            return errorMessage;
+        }
+    }
+
+    PrintJob job;
+    std::string type = getSniffedType(options.format == RASTER_URF ? FORMAT_URF : FORMAT_PWG_RASTER);
+    ErrorMessage *errorMessage = startJob(name, docName, type, job, context);
+    if (errorMessage != NULL)
+    {
+        return errorMessage;
+    }
+    jobId = job.id;
+
+    errorMessage = writeJob(job, getRasterStreamHeader(options, pages.size()), context);
+
+    // As many pages as there are cores are encoded at once, then written in order
+    size_t batch = (std::max)(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> encoded;
+    for (size_t first = 0; errorMessage == NULL && first < pages.size(); first += encoded.size())
+    {
+        if (context != NULL && context->stopped())
+        {
+            errorMessage = context->error();
+            break;
+        }
+
+        encodeRasterPages(pages, first, (std::min)(batch, pages.size() - first), options, encoded);
+        for (size_t i = 0; errorMessage == NULL && i < encoded.size(); i++)
+        {
+            errorMessage = writeJob(job, encoded[i], context);
+        }
+    }
+
+    if (errorMessage != NULL)
+    {
+        cancelJob(job);
+        return errorMessage;
+    }
+
+    errorMessage = endJob(job, context);
+    // Same as printDirect: stopped while the spooler took the document, or the job is still open
+    if (errorMessage != NULL && ((context != NULL && context->stopped()) || job.handle != NULL))
+    {
+        cancelJob(job);
+    }
+
+    return errorMessage;
+}
@@ -1,11 +1,19 @@
 #ifndef PRINTER_MANAGER_HPP
 #define PRINTER_MANAGER_HPP
 
+#include "DocumentFormat.hpp"
+
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 
-typedef std::wstring PrinterName;
+// UTF-8 printer (queue) name, backends convert it where the spooler API wants another encoding
+typedef std::string PrinterName;
 typedef std::string ErrorMessage;
 
 enum Orientation
@@ -40,18 +48,42 @@ const std::map duplex_str = std::map<Duplex, std::string>{{Duplex::SIMPLEX, "SIM
 const std::map color_str = std::map<Color, std::string>{{Color::MONOCHROME, "MONOCHROME"}, {Color::COLOR, "COLOR"}};
 const std::map printQuality_str = std::map<PrintQuality, std::string>{{PrintQuality::DRAFT, "DRAFT"}, {PrintQuality::LOW, "LOW"}, {PrintQuality::MEDIUM, "MEDIUM"}, {PrintQuality::HIGH, "HIGH"}};
 
+// Properties of a printer object, PrinterInfo::fields tells which of them were asked for
+enum PrinterField : unsigned
+{
+    PRINTER_FIELD_NAME = 1 << 0,
+    PRINTER_FIELD_SERVER = 1 << 1,
+    PRINTER_FIELD_SHARE_NAME = 1 << 2,
+    PRINTER_FIELD_PORT_NAME = 1 << 3,
+    PRINTER_FIELD_DRIVER_NAME = 1 << 4,
+    PRINTER_FIELD_LOCATION = 1 << 5,
+    PRINTER_FIELD_COMMENT = 1 << 6,
+    PRINTER_FIELD_STATUS = 1 << 7,
+    PRINTER_FIELD_STATUS_ARRAY = 1 << 8,
+    PRINTER_FIELD_ATTRIBUTE_ARRAY = 1 << 9,
+    PRINTER_FIELD_AVERAGE_PPM = 1 << 10,
+    PRINTER_FIELD_C_JOBS = 1 << 11,
+    PRINTER_FIELD_DEFAULT_PRIORITY = 1 << 12,
+    PRINTER_FIELD_START_TIME = 1 << 13,
+    PRINTER_FIELD_UNTIL_TIME = 1 << 14,
+};
+
+const unsigned PRINTER_FIELDS_ALL = (1 << 15) - 1;
+
+const std::map printerField_str = std::map<PrinterField, std::string>{{PrinterField::PRINTER_FIELD_NAME, "name"}, {PrinterField::PRINTER_FIELD_SERVER, "server"}, {PrinterField::PRINTER_FIELD_SHARE_NAME, "shareName"}, {PrinterField::PRINTER_FIELD_PORT_NAME, "portName"}, {PrinterField::PRINTER_FIELD_DRIVER_NAME, "driverName"}, {PrinterField::PRINTER_FIELD_LOCATION, "location"}, {PrinterField::PRINTER_FIELD_COMMENT, "comment"}, {PrinterField::PRINTER_FIELD_STATUS, "status"}, {PrinterField::PRINTER_FIELD_STATUS_ARRAY, "statusArray"}, {PrinterField::PRINTER_FIELD_ATTRIBUTE_ARRAY, "attributeArray"}, {PrinterField::PRINTER_FIELD_AVERAGE_PPM, "averagePPM"}, {PrinterField::PRINTER_FIELD_C_JOBS, "cJobs"}, {PrinterField::PRINTER_FIELD_DEFAULT_PRIORITY, "defaultPriority"}, {PrinterField::PRINTER_FIELD_START_TIME, "startTime"}, {PrinterField::PRINTER_FIELD_UNTIL_TIME, "untilTime"}};
+
 struct JobInfo
 {
-    int id;
+    int id = 0;
     std::string name;
     std::string user;
-    int priority;
-    int size;
+    int priority = 0;
+    int size = 0;
     std::string status;
     std::vector<std::string> statusArray;
-    int position;
-    int totalPages;
-    int pagesPrinted;
+    int position = 0;
+    int totalPages = 0;
+    int pagesPrinted = 0;
 };
 
 struct PrinterInfo
@@ -64,16 +96,32 @@ struct PrinterInfo
     std::string location;
     std::string comment;
     std::vector<std::string> statusArray;
-    int status;
-    int attributes;
+    int status = 0;
+    int attributes = 0;
     std::vector<std::string> attributeArray;
-    int averagePPM;
-    int cJobs;
-    int defaultPriority;
-    int startTime;
-    int untilTime;
+    int averagePPM = 0;
+    int cJobs = 0;
+    int defaultPriority = 0;
+    int startTime = 0;
+    int untilTime = 0;
+    // PrinterField bits filled by the backend, the rest is left empty
+    unsigned fields = PRINTER_FIELDS_ALL;
+};
+
+// When a queue last changed state or configuration, used to revalidate cached PrinterInfo
+struct PrinterChangeTime
+{
+    long state = 0;
+    long config = 0;
+
+    bool operator==(const PrinterChangeTime &other) const
+    {
+        return state == other.state && config == other.config;
+    }
 };
 
+typedef std::map<std::string, PrinterChangeTime, std::less<>> PrinterChangeTimes;
+
 struct PrinterDevMode
 {
     PrinterName deviceName;
@@ -88,6 +136,181 @@ struct PrinterDevMode
     Duplex duplex;
 };
 
+// Settings of a JobTicket, JobTicket::fields tells which of them are set
+enum JobTicketField : unsigned
+{
+    TICKET_FIELD_COPIES = 1 << 0,
+    TICKET_FIELD_DUPLEX = 1 << 1,
+    TICKET_FIELD_ORIENTATION = 1 << 2,
+    TICKET_FIELD_COLOR = 1 << 3,
+    TICKET_FIELD_PRINT_QUALITY = 1 << 4,
+};
+
+/**
+ * Job settings for RAW data, sent to the printer as a PJL job ticket: a
+ * prologue (UEL, @PJL JOB, @PJL SET lines) in front of the data and an
+ * epilogue (@PJL EOJ, UEL) behind it. Empty tray and jobName are left out.
+ */
+struct JobTicket
+{
+    unsigned fields = 0;
+    int copies = 1;
+    Duplex duplex = SIMPLEX;
+    Orientation orientation = PORTRAIT;
+    Color color = COLOR;
+    PrintQuality printQuality = MEDIUM;
+    // PJL MEDIASOURCE keyword: TRAY1, TRAY2, MANUALFEED...
+    std::string tray;
+    std::string jobName;
+
+    bool empty() const { return fields == 0 && tray.empty() && jobName.empty(); }
+};
+
+/**
+ * Spooler job kept open while its document is written piece by piece.
+ * handle is owned by the backend (an HANDLE from OpenPrinterW on Windows,
+ * the job's own http_t connection on CUPS) and released by endJob/cancelJob.
+ */
+struct PrintJob
+{
+    int id = 0;
+    std::string printer;
+    void *handle = NULL;
+    // PJL closing the job ticket given to startJob, written by endJob
+    std::string epilogue;
+};
+
+/**
+ * One document of a batch job. data is borrowed like the data of printDirect.
+ */
+struct BatchDocument
+{
+    std::string docName;
+    std::string type;
+    std::string_view data;
+};
+
+// Layout of the pixels handed to printRaster, 8 bits per channel
+enum RasterPixelFormat
+{
+    PIXEL_GRAY,
+    PIXEL_RGB,
+    // Straight alpha, composited on white paper
+    PIXEL_RGBA
+};
+
+enum RasterColorSpace
+{
+    RASTER_SGRAY,
+    RASTER_SRGB
+};
+
+enum RasterFormat
+{
+    RASTER_PWG,
+    RASTER_URF
+};
+
+/**
+ * One page of a printRaster job, rows top to bottom. pixels is borrowed like
+ * the data of printDirect; stride is the distance between rows in bytes, 0
+ * for rows packed one after the other.
+ */
+struct RasterPage
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    RasterPixelFormat format = PIXEL_RGBA;
+    size_t stride = 0;
+    std::string_view pixels;
+};
+
+struct RasterOptions
+{
+    // Dots per inch, the page size follows from it and the pixel size
+    int resolution = 300;
+    RasterColorSpace colorSpace = RASTER_SRGB;
+    RasterFormat format = RASTER_PWG;
+};
+
+/**
+ * Printer resolved once and reused for many calls.
+ * handle is owned by the backend (the HANDLE from OpenPrinterW on Windows,
+ * the cups_dest_t on CUPS) and released by closePrinter; info is filled
+ * when the printer is opened or refreshed. lock serializes the use of
+ * handles that can not be shared between threads.
+ */
+struct OpenedPrinter
+{
+    PrinterName name;
+    PrinterInfo info;
+    void *handle = NULL;
+    std::mutex lock;
+};
+
+/**
+ * Change reported by the spooler for a watched printer.
+ * event is the IPP event keyword ("job-state-changed", "job-progress",
+ * "printer-state-changed", "printer-config-changed", "printer-added",
+ * "printer-deleted"). Job events fill job, printer events fill state and
+ * statusArray.
+ */
+struct PrinterEvent
+{
+    std::string event;
+    std::string printer;
+    std::string state;
+    std::vector<std::string> statusArray;
+    JobInfo job;
+};
+
+/**
+ * Subscription to the changes of one printer, or of every printer when name
+ * is empty. handle is owned by the backend (the subscription and its
+ * connection on CUPS, a change notification on Windows) and released by
+ * closeWatch. interrupted is set by interruptWatch. The backend may keep
+ * the address of an open watch, it must not move until closeWatch.
+ */
+struct PrinterWatch
+{
+    PrinterName name;
+    void *handle = NULL;
+    std::atomic<bool> interrupted{false};
+};
+
+/**
+ * Deadline and cancellation of one PrinterManager call. The calls taking an
+ * optional context check stopped() between steps and bound their blocking
+ * waits on the spooler with it where the platform allows; cancel() may be
+ * called from any thread. A call cut short fails, error() tells why.
+ */
+class OperationContext
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    void setTimeout(int timeoutMs);
+    void cancel() { cancelled = true; }
+    // For a call made on behalf of others (a coalesced job): it ends at the latest of their
+    // deadlines, has none if one of them has none, and counts as cancelled once all of them
+    // are. They must outlive this context
+    void follow(const std::vector<const OperationContext *> &contexts);
+
+    bool stopped() const;
+    // Milliseconds left before the deadline, limit when there is no deadline or it is further away
+    int remainingMs(int limit) const;
+    // Why the call stopped, NULL while it may go on
+    ErrorMessage *error() const;
+
+private:
+    bool allCancelled() const;
+
+    std::atomic<bool> cancelled{false};
+    bool hasDeadline = false;
+    Clock::time_point deadline;
+    std::vector<const OperationContext *> followed;
+};
+
 template <typename Type>
 class MemValue
 {
@@ -118,16 +341,73 @@ protected:
     }
 };
 
+/**
+ * Entry point to the platform spooler. A single instance lives for the whole
+ * process and is shared by every binding and worker thread, so backends can
+ * keep state (like pooled spooler connections) across calls.
+ */
 class PrinterManager
 {
 public:
-    ErrorMessage *getDefaultPrinterName(PrinterName &printerName);
-    ErrorMessage *getOneJob(PrinterName name, int jobId, JobInfo &jobInfo);
-    ErrorMessage *getOnePrinter(PrinterName name, PrinterInfo &printerInfo);
-    ErrorMessage *getPrinters(std::vector<PrinterInfo> &printersInfo);
-    ErrorMessage *printDirect(PrinterName name, std::string docName, std::string type, std::string data, int &jobId);
+    static PrinterManager &getInstance();
+
+    ErrorMessage *getDefaultPrinterName(PrinterName &printerName, OperationContext *context = NULL);
+    ErrorMessage *getOneJob(std::string_view name, int jobId, JobInfo &jobInfo, OperationContext *context = NULL);
+    // Many jobs in one spooler request, in the order of jobIds; ids the spooler does not know are left out.
+    // An empty jobIds returns every job the spooler still keeps for the printer
+    ErrorMessage *getJobs(std::string_view name, const std::vector<int> &jobIds, std::vector<JobInfo> &jobsInfo, OperationContext *context = NULL);
+    // fields is a mask of PrinterField, backends skip what was not asked for where the spooler allows it
+    ErrorMessage *getOnePrinter(std::string_view name, PrinterInfo &printerInfo, unsigned fields = PRINTER_FIELDS_ALL, OperationContext *context = NULL);
+    ErrorMessage *getPrinters(std::vector<PrinterInfo> &printersInfo, unsigned fields = PRINTER_FIELDS_ALL, OperationContext *context = NULL);
+    // Change times of every queue in one cheap request, fails where the spooler does not report them
+    ErrorMessage *getPrinterChangeTimes(PrinterChangeTimes &changeTimes, OperationContext *context = NULL);
+    // Whether the spooler reports change times at all, a failed getPrinterChangeTimes is only an error then
+    bool hasPrinterChangeTimes();
+    // "AUTO" takes the type from the data itself, printer languages go out as RAW; other types are kept
+    std::string resolveType(const std::string &type, std::string_view data);
+    // data is only read during the call; callers hand over a view of their own memory, no copy is made
+    ErrorMessage *printDirect(std::string_view name, const std::string &docName, const std::string &type, std::string_view data, int &jobId, OperationContext *context = NULL);
+    // Same with a job ticket: the PJL prologue and epilogue are written around data, which is still not copied
+    ErrorMessage *printDirect(std::string_view name, const std::string &docName, const std::string &type, const JobTicket &ticket, std::string_view data, int &jobId, OperationContext *context = NULL);
+    // Many documents as a single spooler job with one id: a Send-Document per document on CUPS,
+    // a page per document on Windows, where every document has to share the type of the first
+    ErrorMessage *printBatch(std::string_view name, const std::string &jobName, const std::vector<BatchDocument> &documents, int &jobId, OperationContext *context = NULL);
+    // Pixel pages encoded as PWG raster or URF, several pages at a time on as many threads as there
+    // are cores, and sent in order as image/pwg-raster or image/urf (RAW on Windows)
+    ErrorMessage *printRaster(std::string_view name, const std::string &docName, const std::vector<RasterPage> &pages, const RasterOptions &options, int &jobId, OperationContext *context = NULL);
+    // path is read by the backend itself and streamed to the spooler
+    ErrorMessage *printFile(std::string_view name, const std::string &path, const std::string &docName, const std::string &type, int &jobId, OperationContext *context = NULL);
+    // Streaming job: startJob once, writeJob for every piece, then endJob (or cancelJob on failure).
+    // Each call has a context of its own; a job whose call was stopped has to be cancelled
+    ErrorMessage *startJob(std::string_view name, const std::string &docName, const std::string &type, PrintJob &job, OperationContext *context = NULL);
+    // A non empty ticket needs a RAW type, AUTO is taken as RAW; its prologue is written here, its epilogue by endJob
+    ErrorMessage *startJob(std::string_view name, const std::string &docName, const std::string &type, const JobTicket &ticket, PrintJob &job, OperationContext *context = NULL);
+    ErrorMessage *writeJob(PrintJob &job, std::string_view data, OperationContext *context = NULL);
+    ErrorMessage *endJob(PrintJob &job, OperationContext *context = NULL);
+    // Cleanup after a failed or stopped call, so it is bounded by a short limit of its own
+    // instead of the context of the call it undoes
+    ErrorMessage *cancelJob(PrintJob &job);
     ErrorMessage *getSupportedPrintFormats(std::vector<std::string> &dataTypes);
-    ErrorMessage *getPrinterDevMode(const std::wstring &printerName, PrinterDevMode &pDevMode);
+    ErrorMessage *getPrinterDevMode(std::string_view printerName, PrinterDevMode &pDevMode);
+    // Resolve a printer once, then print and query jobs on it without resolving it again
+    ErrorMessage *openPrinter(std::string_view name, OpenedPrinter &printer, OperationContext *context = NULL);
+    ErrorMessage *refreshPrinter(OpenedPrinter &printer, OperationContext *context = NULL);
+    ErrorMessage *closePrinter(OpenedPrinter &printer);
+    ErrorMessage *printDirect(OpenedPrinter &printer, const std::string &docName, const std::string &type, std::string_view data, int &jobId, OperationContext *context = NULL);
+    ErrorMessage *getOneJob(OpenedPrinter &printer, int jobId, JobInfo &jobInfo, OperationContext *context = NULL);
+    // Push based status: waitWatch blocks until the spooler reports changes. interruptWatch may be
+    // called from any thread and makes a pending waitWatch return without events; it never blocks,
+    // the waiting thread notices it within a fraction of a second. openWatch and closeWatch may
+    // block on the spooler (Create-/Cancel-Subscription); openWatch gives up once interrupted is
+    // set, and closeWatch must not be called before waitWatch has returned
+    ErrorMessage *openWatch(std::string_view name, PrinterWatch &watch);
+    ErrorMessage *waitWatch(PrinterWatch &watch, std::vector<PrinterEvent> &events);
+    void interruptWatch(PrinterWatch &watch);
+    ErrorMessage *closeWatch(PrinterWatch &watch);
+
+private:
+    // Type the backend is given for a sniffed format
+    static std::string getSniffedType(DocumentFormat format);
 };
 
 #endif
\ No newline at end of file
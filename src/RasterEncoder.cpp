@@ -0,0 +1,412 @@
+#include "RasterEncoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <system_error>
+#include <thread>
+
+#if !defined(NODE_PRINTING_NO_SSE2) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define RASTER_ENCODER_SSE2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// Pixels in one run or literal
+static const size_t MAX_RUN = 128;
+// Extra copies of a line in its repeat count byte
+static const size_t MAX_LINE_REPEAT = 255;
+
+static const size_t PWG_HEADER_SIZE = 1796;
+static const size_t URF_HEADER_SIZE = 32;
+
+// cups_cspace_t values of the PWG header
+static const uint32_t PWG_CSPACE_SGRAY = 18;
+static const uint32_t PWG_CSPACE_SRGB = 19;
+// URF color spaces
+static const uint8_t URF_CSPACE_SGRAY = 0;
+static const uint8_t URF_CSPACE_SRGB = 1;
+
+static size_t getInputBytesPerPixel(RasterPixelFormat format)
+{
+    switch (format)
+    {
+    case PIXEL_GRAY:
+        return 1;
+    case PIXEL_RGB:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+static size_t getOutputBytesPerPixel(RasterColorSpace colorSpace)
+{
+    return colorSpace == RASTER_SGRAY ? 1 : 3;
+}
+
+static void putInt(std::string &header, size_t offset, uint32_t value)
+{
+    header[offset] = (char)(value >> 24);
+    header[offset + 1] = (char)(value >> 16);
+    header[offset + 2] = (char)(value >> 8);
+    header[offset + 3] = (char)value;
+}
+
+static void putFloat(std::string &header, size_t offset, float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    putInt(header, offset, bits);
+}
+
+static void putString(std::string &header, size_t offset, const char *value)
+{
+    std::memcpy(&header[offset], value, std::strlen(value));
+}
+
+// cups_page_header2_t as PWG 5102.4 lays it out, big endian, fields the PWG does not use stay 0
+static void appendPwgHeader(const RasterPage &page, const RasterOptions &options, size_t pageCount, std::string &output)
+{
+    uint32_t bytesPerPixel = (uint32_t)getOutputBytesPerPixel(options.colorSpace);
+    float widthPoints = (float)page.width * 72 / options.resolution;
+    float heightPoints = (float)page.height * 72 / options.resolution;
+
+    std::string header(PWG_HEADER_SIZE, '\0');
+    putString(header, 0, "PwgRaster");
+    putInt(header, 276, (uint32_t)options.resolution);
+    putInt(header, 280, (uint32_t)options.resolution);
+    putInt(header, 352, (uint32_t)(widthPoints + 0.5f));
+    putInt(header, 356, (uint32_t)(heightPoints + 0.5f));
+    putInt(header, 372, page.width);
+    putInt(header, 376, page.height);
+    putInt(header, 384, 8);
+    putInt(header, 388, 8 * bytesPerPixel);
+    putInt(header, 392, page.width * bytesPerPixel);
+    putInt(header, 400, options.colorSpace == RASTER_SGRAY ? PWG_CSPACE_SGRAY : PWG_CSPACE_SRGB);
+    putInt(header, 420, bytesPerPixel);
+    putFloat(header, 428, widthPoints);
+    putFloat(header, 432, heightPoints);
+    // TotalPageCount, CrossFeedTransform, FeedTransform
+    putInt(header, 452, (uint32_t)pageCount);
+    putInt(header, 456, 1);
+    putInt(header, 460, 1);
+
+    output += header;
+}
+
+static void appendUrfHeader(const RasterPage &page, const RasterOptions &options, std::string &output)
+{
+    std::string header(URF_HEADER_SIZE, '\0');
+    header[0] = (char)(8 * getOutputBytesPerPixel(options.colorSpace));
+    header[1] = (char)(options.colorSpace == RASTER_SGRAY ? URF_CSPACE_SGRAY : URF_CSPACE_SRGB);
+    // Simplex, normal quality
+    header[2] = 1;
+    header[3] = 4;
+    putInt(header, 12, page.width);
+    putInt(header, 16, page.height);
+    putInt(header, 20, (uint32_t)options.resolution);
+
+    output += header;
+}
+
+std::string getRasterStreamHeader(const RasterOptions &options, size_t pageCount)
+{
+    if (options.format == RASTER_URF)
+    {
+        std::string header("UNIRAST\0\0\0\0\0", 12);
+        putInt(header, 8, (uint32_t)pageCount);
+        return header;
+    }
+    return "RaS2";
+}
+
+ErrorMessage *checkRasterPage(const RasterPage &page)
+{
+    if (page.width == 0 || page.height == 0)
+    {
+        static ErrorMessage errorMsg = "Raster page has no pixels";
+        return &errorMsg;
+    }
+
+    size_t rowBytes = (size_t)page.width * getInputBytesPerPixel(page.format);
+    size_t stride = page.stride != 0 ? page.stride : rowBytes;
+    if (stride < rowBytes || page.pixels.size() < stride * (page.height - 1) + rowBytes)
+    {
+        static ErrorMessage errorMsg = "Raster page data is smaller than its size";
+        return &errorMsg;
+    }
+
+    return NULL;
+}
+
+const uint8_t *convertRasterRow(const RasterPage &page, uint32_t y, RasterColorSpace colorSpace, uint8_t *line)
+{
+    size_t inputBytes = getInputBytesPerPixel(page.format);
+    size_t stride = page.stride != 0 ? page.stride : page.width * inputBytes;
+    const uint8_t *row = (const uint8_t *)page.pixels.data() + y * stride;
+    if ((page.format == PIXEL_GRAY && colorSpace == RASTER_SGRAY) ||
+        (page.format == PIXEL_RGB && colorSpace == RASTER_SRGB))
+    {
+        return row;
+    }
+
+    for (uint32_t x = 0; x < page.width; x++, row += inputBytes)
+    {
+        uint32_t red = row[0];
+        uint32_t green = inputBytes == 1 ? row[0] : row[1];
+        uint32_t blue = inputBytes == 1 ? row[0] : row[2];
+        if (inputBytes == 4)
+        {
+            // Over white paper
+            uint32_t alpha = row[3];
+            red = (red * alpha + 255 * (255 - alpha) + 127) / 255;
+            green = (green * alpha + 255 * (255 - alpha) + 127) / 255;
+            blue = (blue * alpha + 255 * (255 - alpha) + 127) / 255;
+        }
+
+        if (colorSpace == RASTER_SGRAY)
+        {
+            // Rec. 601 luma in 8 bit fixed point
+            line[x] = (uint8_t)((77 * red + 150 * green + 29 * blue + 128) >> 8);
+        }
+        else
+        {
+            line[3 * x] = (uint8_t)red;
+            line[3 * x + 1] = (uint8_t)green;
+            line[3 * x + 2] = (uint8_t)blue;
+        }
+    }
+    return line;
+}
+
+#ifdef RASTER_ENCODER_SSE2
+static unsigned lowestBit(uint64_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    if (_BitScanForward(&index, (unsigned long)mask))
+    {
+        return (unsigned)index;
+    }
+    _BitScanForward(&index, (unsigned long)(mask >> 32));
+    return (unsigned)index + 32;
+#else
+    return (unsigned)__builtin_ctzll(mask);
+#endif
+}
+
+// Byte i of the 16 bytes at a equals byte i at b, as bit i
+static uint64_t compareBytes(const uint8_t *a, const uint8_t *b)
+{
+    __m128i left = _mm_loadu_si128((const __m128i *)a);
+    __m128i right = _mm_loadu_si128((const __m128i *)b);
+    return (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(left, right));
+}
+#endif
+
+static bool equalsNext(const uint8_t *line, size_t pixel, size_t bytesPerPixel)
+{
+    const uint8_t *current = line + pixel * bytesPerPixel;
+    return std::memcmp(current, current + bytesPerPixel, bytesPerPixel) == 0;
+}
+
+// First pixel in [from, to) whose equality with the pixel after it is equal, to when there is none.
+// to is at most the last pixel of the line
+static size_t findEqualNext(const uint8_t *line, size_t width, size_t bytesPerPixel, size_t from, size_t to, bool equal)
+{
+    size_t pixel = from;
+
+#ifdef RASTER_ENCODER_SSE2
+    // 16 pixels at a time, compared byte wise with the pixel after them; for RGB a
+    // pixel matches when its 3 bytes do, read at the first byte of every pixel
+    static const uint64_t FIRST_BYTES_RGB = 0x0000249249249249ULL;
+    static const uint64_t FIRST_BYTES_GRAY = 0x000000000000FFFFULL;
+
+    while (pixel < to && pixel + 17 <= width)
+    {
+        const uint8_t *bytes = line + pixel * bytesPerPixel;
+        uint64_t matches;
+        uint64_t firstBytes;
+        if (bytesPerPixel == 1)
+        {
+            matches = compareBytes(bytes, bytes + 1);
+            firstBytes = FIRST_BYTES_GRAY;
+        }
+        else
+        {
+            uint64_t equalBytes = compareBytes(bytes, bytes + 3) | compareBytes(bytes + 16, bytes + 19) << 16 |
+                                  compareBytes(bytes + 32, bytes + 35) << 32;
+            matches = equalBytes & equalBytes >> 1 & equalBytes >> 2;
+            firstBytes = FIRST_BYTES_RGB;
+        }
+
+        uint64_t found = (equal ? matches : ~matches) & firstBytes;
+        if (found != 0)
+        {
+            size_t result = pixel + lowestBit(found) / bytesPerPixel;
+            return result < to ? result : to;
+        }
+        pixel += 16;
+    }
+#endif
+
+    for (; pixel < to; pixel++)
+    {
+        if (equalsNext(line, pixel, bytesPerPixel) == equal)
+        {
+            return pixel;
+        }
+    }
+    return to;
+}
+
+// A line as runs (count - 1, one pixel) and literals (257 - count, count pixels)
+static void encodeLine(const uint8_t *line, size_t width, size_t bytesPerPixel, std::string &output)
+{
+    size_t pixel = 0;
+
+    while (pixel < width)
+    {
+        const char *start = (const char *)line + pixel * bytesPerPixel;
+        size_t last = width - 1;
+
+        if (pixel == last || equalsNext(line, pixel, bytesPerPixel))
+        {
+            size_t end = pixel == last ? last : findEqualNext(line, width, bytesPerPixel, pixel, (std::min)(pixel + MAX_RUN - 1, last), false);
+            size_t count = end - pixel + 1;
+            output.push_back((char)(count - 1));
+            output.append(start, bytesPerPixel);
+            pixel += count;
+            continue;
+        }
+
+        size_t end = findEqualNext(line, width, bytesPerPixel, pixel + 1, (std::min)(pixel + MAX_RUN, last), true);
+        size_t count = end - pixel;
+        // Nothing repeats up to the end of the line, its last pixel joins the literal
+        if (end == last && count < MAX_RUN)
+        {
+            count++;
+        }
+        if (count == 1)
+        {
+            output.push_back(0);
+        }
+        else
+        {
+            output.push_back((char)(257 - count));
+        }
+        output.append(start, count * bytesPerPixel);
+        pixel += count;
+    }
+}
+
+/**
+ * Rows of a page in the output color space. Rows already in it are used in
+ * place, the others are converted into one of two buffers, so the line being
+ * encoded stays valid while the next one is read.
+ */
+class RasterRows
+{
+public:
+    RasterRows(const RasterPage &page, RasterColorSpace colorSpace)
+        : page(page), colorSpace(colorSpace)
+    {
+        // Unused when convertRasterRow returns the rows in place
+        size_t lineBytes = page.width * getOutputBytesPerPixel(colorSpace);
+        buffers[0].resize(lineBytes);
+        buffers[1].resize(lineBytes);
+    }
+
+    // Row y, in the buffer not holding the row kept by keep()
+    const uint8_t *get(uint32_t y)
+    {
+        return convertRasterRow(page, y, colorSpace, buffers[1 - kept].data());
+    }
+
+    // The row last returned by get() is kept, the next one goes to the other buffer
+    void keep()
+    {
+        kept = 1 - kept;
+    }
+
+private:
+    const RasterPage &page;
+    RasterColorSpace colorSpace;
+    std::vector<uint8_t> buffers[2];
+    int kept = 0;
+};
+
+void encodeRasterPage(const RasterPage &page, const RasterOptions &options, size_t pageCount, std::string &output)
+{
+    if (options.format == RASTER_URF)
+    {
+        appendUrfHeader(page, options, output);
+    }
+    else
+    {
+        appendPwgHeader(page, options, pageCount, output);
+    }
+
+    size_t bytesPerPixel = getOutputBytesPerPixel(options.colorSpace);
+    size_t lineBytes = page.width * bytesPerPixel;
+    RasterRows rows(page, options.colorSpace);
+
+    const uint8_t *line = rows.get(0);
+    rows.keep();
+    for (uint32_t y = 1; line != NULL;)
+    {
+        // Identical lines that follow are only counted
+        const uint8_t *next = NULL;
+        size_t repeat = 0;
+        for (; y < page.height; y++)
+        {
+            next = rows.get(y);
+            if (repeat == MAX_LINE_REPEAT || std::memcmp(next, line, lineBytes) != 0)
+            {
+                break;
+            }
+            next = NULL;
+            repeat++;
+        }
+
+        output.push_back((char)repeat);
+        encodeLine(line, page.width, bytesPerPixel, output);
+
+        if (next != NULL)
+        {
+            rows.keep();
+            y++;
+        }
+        line = next;
+    }
+}
+
+void encodeRasterPages(const std::vector<RasterPage> &pages, size_t first, size_t count, const RasterOptions &options,
+                       std::vector<std::string> &output)
+{
+    output.clear();
+    output.resize(count);
+
+    // The calling thread takes the first page, a thread each the others
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < count; i++)
+    {
+        try
+        {
+            threads.emplace_back(encodeRasterPage, std::cref(pages[first + i]), std::cref(options), pages.size(), std::ref(output[i]));
+        }
+        catch (const std::system_error &)
+        {
+            // Out of threads, the page is encoded here instead
+            encodeRasterPage(pages[first + i], options, pages.size(), output[i]);
+        }
+    }
+    encodeRasterPage(pages[first], options, pages.size(), output[0]);
+
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+}
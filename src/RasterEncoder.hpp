@@ -0,0 +1,35 @@
+#ifndef RASTER_ENCODER_HPP
+#define RASTER_ENCODER_HPP
+
+#include "PrinterManager.hpp"
+
+#include <string>
+#include <vector>
+
+/**
+ * PWG raster (PWG 5102.4) and Apple URF writer for RasterPage pixels, 8 bit
+ * sGray or sRGB. Both share the line compression: a repeat count for
+ * identical lines, then PackBits style runs and literals of whole pixels.
+ * Runs are found 16 pixels at a time with SSE2 where the compiler targets
+ * it (not with NODE_PRINTING_NO_SSE2); identical lines are compared with memcmp.
+ */
+
+// Stream header: "RaS2" for PWG, "UNIRAST" and the page count for URF
+std::string getRasterStreamHeader(const RasterOptions &options, size_t pageCount);
+
+// Whether pixels holds height rows of width pixels at the given stride
+ErrorMessage *checkRasterPage(const RasterPage &page);
+
+// Row y of a page checked by checkRasterPage in 8 bit sGray or sRGB, alpha composited on white
+// before any conversion. Rows already in that color space are returned in place, the others are
+// converted into line, width bytes per pixel of the color space
+const uint8_t *convertRasterRow(const RasterPage &page, uint32_t y, RasterColorSpace colorSpace, uint8_t *line);
+
+// Appends the page header and compressed lines of a page checked by checkRasterPage
+void encodeRasterPage(const RasterPage &page, const RasterOptions &options, size_t pageCount, std::string &output);
+
+// Encodes pages[first, first + count) into output, a page per thread
+void encodeRasterPages(const std::vector<RasterPage> &pages, size_t first, size_t count, const RasterOptions &options,
+                       std::vector<std::string> &output);
+
+#endif
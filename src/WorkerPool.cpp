@@ -0,0 +1,254 @@
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <system_error>
+#include <thread>
+
+WorkerPool &WorkerPool::getInstance()
+{
+    // Never destroyed, detached threads may still use it while the process exits
+    static WorkerPool *instance = new WorkerPool();
+    return *instance;
+}
+
+void WorkerPool::setOptions(const WorkerPoolOptions &options)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    this->options.size = options.size > 0 ? options.size : 1;
+    this->options.queueLength = options.queueLength > 0 ? options.queueLength : 0;
+    this->options.perPrinter = options.perPrinter > 0 ? options.perPrinter : 1;
+    this->options.maxInFlight = options.maxInFlight > 0 ? options.maxInFlight : 0;
+
+    // Growing serves the tasks already waiting, raised limits may unblock some,
+    // shrinking lets idle threads exit
+    startThreads();
+    wakeup.notify_all();
+}
+
+WorkerPoolOptions WorkerPool::getOptions()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return options;
+}
+
+ErrorMessage *WorkerPool::submit(WorkerTask *task)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (options.queueLength > 0 && pending >= (size_t)options.queueLength)
+    {
+        stats.rejected++;
+        static ErrorMessage errorMsg = "Printer worker queue is full";
+        return &errorMsg;
+    }
+
+    if (task->priority < PRIORITY_HIGH || task->priority >= PRIORITY_LANES)
+    {
+        task->priority = PRIORITY_NORMAL;
+    }
+    task->submitted = std::chrono::steady_clock::now();
+
+    if (task->key.empty())
+    {
+        unkeyed[task->priority].push_back(task);
+    }
+    else
+    {
+        std::deque<WorkerTask *> &lane = printers[task->key].lanes[task->priority];
+        if (lane.empty())
+        {
+            turns[task->priority].push_back(task->key);
+        }
+        lane.push_back(task);
+    }
+    pending++;
+
+    WorkerLaneStats &laneStats = stats.lanes[task->priority];
+    laneStats.queued++;
+    laneStats.maxQueued = (std::max)(laneStats.maxQueued, laneStats.queued);
+    stats.maxQueued = (std::max)(stats.maxQueued, pending);
+
+    startThreads();
+    wakeup.notify_one();
+
+    return NULL;
+}
+
+WorkerPoolStats WorkerPool::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    WorkerPoolStats result = stats;
+    result.threads = threads;
+    result.inFlight = inFlight;
+    result.queued = pending;
+    for (std::map<std::string, Printer>::value_type &printer : printers)
+    {
+        if (printer.second.running < options.perPrinter)
+        {
+            continue;
+        }
+        for (int lane = 0; lane < PRIORITY_LANES; lane++)
+        {
+            result.serialized += printer.second.lanes[lane].size();
+        }
+    }
+    result.queued -= result.serialized;
+    return result;
+}
+
+// Called with the lock held: one more thread for every waiting task no idle thread can take.
+// Tasks held back by the printer limits count too, their threads just wait a little longer
+void WorkerPool::startThreads()
+{
+    while (threads < options.size && pending > (size_t)idle)
+    {
+        try
+        {
+            std::thread(&WorkerPool::run, this).detach();
+        }
+        catch (const std::system_error &)
+        {
+            // Out of threads, the running ones pick the task up later
+            break;
+        }
+        threads++;
+        // Counted as idle until it picks its task, so the loop does not start one too many
+        idle++;
+    }
+}
+
+// Called with the lock held: pops a waiting task and records how long it waited
+WorkerTask *WorkerPool::take(std::deque<WorkerTask *> &lane, WorkerPriority priority)
+{
+    WorkerTask *task = lane.front();
+    lane.pop_front();
+    pending--;
+
+    WorkerLaneStats &laneStats = stats.lanes[priority];
+    double waitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - task->submitted).count();
+    laneStats.queued--;
+    laneStats.started++;
+    laneStats.totalWaitMs += waitMs;
+    laneStats.maxWaitMs = (std::max)(laneStats.maxWaitMs, waitMs);
+
+    return task;
+}
+
+// Called with the lock held: the first task allowed to start, highest lane first,
+// taking the printers of a lane in turn. NULL when every waiting task is held back
+WorkerTask *WorkerPool::next()
+{
+    for (int lane = 0; lane < PRIORITY_LANES; lane++)
+    {
+        WorkerPriority priority = (WorkerPriority)lane;
+
+        // Lookups are not printer work, the printer limits do not apply
+        if (!unkeyed[lane].empty())
+        {
+            return take(unkeyed[lane], priority);
+        }
+
+        if (options.maxInFlight > 0 && inFlight >= options.maxInFlight)
+        {
+            continue;
+        }
+
+        std::deque<std::string> &laneTurns = turns[lane];
+        for (size_t i = 0; i < laneTurns.size(); i++)
+        {
+            std::string key = laneTurns.front();
+            laneTurns.pop_front();
+
+            Printer &printer = printers[key];
+            if (printer.running >= options.perPrinter)
+            {
+                laneTurns.push_back(key);
+                continue;
+            }
+
+            WorkerTask *task = take(printer.lanes[lane], priority);
+            if (!printer.lanes[lane].empty())
+            {
+                laneTurns.push_back(key);
+            }
+            printer.running++;
+            inFlight++;
+            return task;
+        }
+    }
+
+    return NULL;
+}
+
+// Called with the lock held once a keyed task is done: frees its printer slot
+void WorkerPool::release(const std::string &key)
+{
+    std::map<std::string, Printer>::iterator printer = printers.find(key);
+    if (printer == printers.end())
+    {
+        return;
+    }
+
+    printer->second.running--;
+    inFlight--;
+
+    for (int lane = 0; lane < PRIORITY_LANES; lane++)
+    {
+        if (!printer->second.lanes[lane].empty())
+        {
+            // The freed slot may unblock a task this thread does not pick itself
+            wakeup.notify_one();
+            return;
+        }
+    }
+    if (printer->second.running == 0)
+    {
+        printers.erase(printer);
+    }
+    if (options.maxInFlight > 0 && pending > 0)
+    {
+        wakeup.notify_one();
+    }
+}
+
+void WorkerPool::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+        WorkerTask *task = NULL;
+        while (threads <= options.size && (task = next()) == NULL)
+        {
+            wakeup.wait(lock);
+        }
+
+        if (task == NULL)
+        {
+            idle--;
+            threads--;
+            return;
+        }
+
+        idle--;
+        stats.busy++;
+        lock.unlock();
+
+        // Done may delete the task
+        std::string key = task->key;
+        task->Execute();
+        task->Done();
+
+        lock.lock();
+        stats.busy--;
+        stats.completed++;
+        idle++;
+        if (!key.empty())
+        {
+            release(key);
+        }
+    }
+}
@@ -0,0 +1,136 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include "PrinterManager.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Scheduling lanes, a waiting task of a higher lane always starts first
+enum WorkerPriority
+{
+    PRIORITY_HIGH,
+    PRIORITY_NORMAL,
+    PRIORITY_LOW,
+    PRIORITY_LANES
+};
+
+struct WorkerPoolOptions
+{
+    int size = 4;
+    // Waiting tasks, 0 for no limit
+    int queueLength = 0;
+    // Tasks of one printer running at once
+    int perPrinter = 1;
+    // Printer tasks running at once over all printers, 0 for no limit but size
+    int maxInFlight = 0;
+};
+
+struct WorkerLaneStats
+{
+    size_t queued = 0;
+    size_t maxQueued = 0;
+    uint64_t started = 0;
+    // Time from submit to start, in milliseconds
+    double totalWaitMs = 0;
+    double maxWaitMs = 0;
+};
+
+struct WorkerPoolStats
+{
+    int threads = 0;
+    int busy = 0;
+    // Printer tasks running
+    int inFlight = 0;
+    // Waiting for a thread
+    size_t queued = 0;
+    // Waiting behind the running tasks of the same printer
+    size_t serialized = 0;
+    size_t maxQueued = 0;
+    uint64_t completed = 0;
+    uint64_t rejected = 0;
+    WorkerLaneStats lanes[PRIORITY_LANES];
+};
+
+/**
+ * Work item of the WorkerPool. Execute() and then Done() are called on a pool
+ * thread; Done() hands the result over and may delete the task.
+ * A non empty key names the printer the task goes to: tasks of one key
+ * and lane start in submission order, and only perPrinter of them run at once.
+ */
+class WorkerTask
+{
+public:
+    virtual ~WorkerTask() {}
+
+    virtual void Execute() = 0;
+    virtual void Done() = 0;
+
+    std::string key;
+    WorkerPriority priority = PRIORITY_NORMAL;
+
+private:
+    friend class WorkerPool;
+    std::chrono::steady_clock::time_point submitted;
+};
+
+/**
+ * Threads running the blocking spooler calls of the async exports, kept
+ * apart from the libuv pool so a slow print server can not starve fs, crypto
+ * or zlib work. Threads are started on demand up to size and are never
+ * joined: a call stuck in the spooler must not hold up process exit.
+ * Printer tasks are bounded per printer and over all printers, so a burst
+ * of submissions reaches the spooler at the pace it can take; within a lane
+ * the printers with waiting tasks take turns.
+ */
+class WorkerPool
+{
+public:
+    static WorkerPool &getInstance();
+
+    // size and perPrinter are at least 1, the limits 0 for none
+    void setOptions(const WorkerPoolOptions &options);
+    WorkerPoolOptions getOptions();
+
+    // Fails without taking the task when the queue is full
+    ErrorMessage *submit(WorkerTask *task);
+
+    WorkerPoolStats getStats();
+
+private:
+    // The tasks waiting for one printer and how many of its tasks run
+    struct Printer
+    {
+        std::deque<WorkerTask *> lanes[PRIORITY_LANES];
+        int running = 0;
+    };
+
+    void run();
+    void startThreads();
+    WorkerTask *next();
+    WorkerTask *take(std::deque<WorkerTask *> &lane, WorkerPriority priority);
+    void release(const std::string &key);
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    WorkerPoolOptions options;
+    int threads = 0;
+    int idle = 0;
+    int inFlight = 0;
+    size_t pending = 0;
+
+    // Tasks without a printer, not subject to the printer limits
+    std::deque<WorkerTask *> unkeyed[PRIORITY_LANES];
+    std::map<std::string, Printer> printers;
+    // Per lane, the printers with a task waiting in that lane, in turn order
+    std::deque<std::string> turns[PRIORITY_LANES];
+
+    WorkerPoolStats stats;
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "node_columnar.hpp"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace
+{
+    /**
+     * Builds the columns of one listing. Strings are interned by value into a
+     * table shared by every column, so repeated values (driver names, ports,
+     * status keywords) are converted to JS strings once.
+     */
+    template <typename Row>
+    class ColumnBuilder
+    {
+    public:
+        ColumnBuilder(Napi::Env env, const std::vector<Row> &rows)
+            : env(env), rows(rows), columns(Napi::Object::New(env)) {}
+
+        void String(const char *name, std::string Row::*member)
+        {
+            Napi::Uint32Array column = Napi::Uint32Array::New(env, rows.size());
+            uint32_t *data = column.Data();
+            for (size_t i = 0; i < rows.size(); i++)
+            {
+                data[i] = Intern(rows[i].*member);
+            }
+            columns.Set(name, column);
+        }
+
+        void Int(const char *name, int Row::*member)
+        {
+            Napi::Int32Array column = Napi::Int32Array::New(env, rows.size());
+            int32_t *data = column.Data();
+            for (size_t i = 0; i < rows.size(); i++)
+            {
+                data[i] = rows[i].*member;
+            }
+            columns.Set(name, column);
+        }
+
+        void StringArray(const char *name, std::vector<std::string> Row::*member)
+        {
+            size_t total = 0;
+            for (const Row &row : rows)
+            {
+                total += (row.*member).size();
+            }
+
+            Napi::Uint32Array offsets = Napi::Uint32Array::New(env, rows.size() + 1);
+            Napi::Uint32Array values = Napi::Uint32Array::New(env, total);
+            uint32_t *offsetData = offsets.Data();
+            uint32_t *valueData = values.Data();
+
+            uint32_t offset = 0;
+            for (size_t i = 0; i < rows.size(); i++)
+            {
+                offsetData[i] = offset;
+                for (const std::string &value : rows[i].*member)
+                {
+                    valueData[offset++] = Intern(value);
+                }
+            }
+            offsetData[rows.size()] = offset;
+
+            Napi::Object column = Napi::Object::New(env);
+            column.Set("offsets", offsets);
+            column.Set("values", values);
+            columns.Set(name, column);
+        }
+
+        Napi::Object Finish()
+        {
+            Napi::Array table = Napi::Array::New(env, strings.size());
+            for (size_t i = 0; i < strings.size(); i++)
+            {
+                table[(uint32_t)i] = Napi::String::New(env, strings[i].data(), strings[i].size());
+            }
+
+            Napi::Object result = Napi::Object::New(env);
+            result.Set("length", Napi::Number::New(env, (double)rows.size()));
+            result.Set("strings", table);
+            result.Set("columns", columns);
+            return result;
+        }
+
+    private:
+        // Views point into rows, which outlive the builder
+        uint32_t Intern(const std::string &value)
+        {
+            std::pair<std::unordered_map<std::string_view, uint32_t>::iterator, bool> found =
+                index.emplace(std::string_view(value), (uint32_t)strings.size());
+            if (found.second)
+            {
+                strings.push_back(value);
+            }
+            return found.first->second;
+        }
+
+        Napi::Env env;
+        const std::vector<Row> &rows;
+        Napi::Object columns;
+        std::unordered_map<std::string_view, uint32_t> index;
+        std::vector<std::string_view> strings;
+    };
+}
+
+Napi::Object PrintersToColumns(Napi::Env env, const std::vector<PrinterInfo> &printersInfo, unsigned fields)
+{
+    ColumnBuilder<PrinterInfo> builder(env, printersInfo);
+
+    if (fields & PRINTER_FIELD_NAME)
+    {
+        builder.String("name", &PrinterInfo::name);
+    }
+    if (fields & PRINTER_FIELD_SERVER)
+    {
+        builder.String("server", &PrinterInfo::server);
+    }
+    if (fields & PRINTER_FIELD_SHARE_NAME)
+    {
+        builder.String("shareName", &PrinterInfo::shareName);
+    }
+    if (fields & PRINTER_FIELD_PORT_NAME)
+    {
+        builder.String("portName", &PrinterInfo::portName);
+    }
+    if (fields & PRINTER_FIELD_DRIVER_NAME)
+    {
+        builder.String("driverName", &PrinterInfo::driverName);
+    }
+    if (fields & PRINTER_FIELD_LOCATION)
+    {
+        builder.String("location", &PrinterInfo::location);
+    }
+    if (fields & PRINTER_FIELD_COMMENT)
+    {
+        builder.String("comment", &PrinterInfo::comment);
+    }
+    if (fields & PRINTER_FIELD_STATUS)
+    {
+        builder.Int("status", &PrinterInfo::status);
+    }
+    if (fields & PRINTER_FIELD_STATUS_ARRAY)
+    {
+        builder.StringArray("statusArray", &PrinterInfo::statusArray);
+    }
+    if (fields & PRINTER_FIELD_ATTRIBUTE_ARRAY)
+    {
+        builder.StringArray("attributeArray", &PrinterInfo::attributeArray);
+    }
+    if (fields & PRINTER_FIELD_AVERAGE_PPM)
+    {
+        builder.Int("averagePPM", &PrinterInfo::averagePPM);
+    }
+    if (fields & PRINTER_FIELD_C_JOBS)
+    {
+        builder.Int("cJobs", &PrinterInfo::cJobs);
+    }
+    if (fields & PRINTER_FIELD_DEFAULT_PRIORITY)
+    {
+        builder.Int("defaultPriority", &PrinterInfo::defaultPriority);
+    }
+    if (fields & PRINTER_FIELD_START_TIME)
+    {
+        builder.Int("startTime", &PrinterInfo::startTime);
+    }
+    if (fields & PRINTER_FIELD_UNTIL_TIME)
+    {
+        builder.Int("untilTime", &PrinterInfo::untilTime);
+    }
+
+    return builder.Finish();
+}
+
+Napi::Object JobsToColumns(Napi::Env env, const std::vector<JobInfo> &jobsInfo)
+{
+    ColumnBuilder<JobInfo> builder(env, jobsInfo);
+
+    builder.Int("id", &JobInfo::id);
+    builder.String("name", &JobInfo::name);
+    builder.String("user", &JobInfo::user);
+    builder.Int("priority", &JobInfo::priority);
+    builder.Int("size", &JobInfo::size);
+    builder.String("status", &JobInfo::status);
+    builder.Int("position", &JobInfo::position);
+    builder.Int("totalPages", &JobInfo::totalPages);
+    builder.Int("pagesPrinted", &JobInfo::pagesPrinted);
+
+    return builder.Finish();
+}
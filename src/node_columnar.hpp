@@ -0,0 +1,29 @@
+#ifndef NODE_COLUMNAR_HPP
+#define NODE_COLUMNAR_HPP
+
+#include "PrinterManager.hpp"
+
+#include <napi.h>
+
+#include <vector>
+
+/**
+ * Columnar form of large listings, built without a JS object per row:
+ *
+ * {
+ *   length: Number of rows,
+ *   strings: Array of String, every distinct string value once,
+ *   columns: {
+ *     <string property>: Uint32Array, index into strings per row
+ *     <number property>: Int32Array, value per row
+ *     <string array property>: { offsets: Uint32Array(length + 1), values: Uint32Array }
+ *        the strings of row i are values[offsets[i]] .. values[offsets[i + 1] - 1]
+ *   }
+ * }
+ *
+ * Property names are the ones of the row objects returned otherwise.
+ */
+Napi::Object PrintersToColumns(Napi::Env env, const std::vector<PrinterInfo> &printersInfo, unsigned fields);
+Napi::Object JobsToColumns(Napi::Env env, const std::vector<JobInfo> &jobsInfo);
+
+#endif
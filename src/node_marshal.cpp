@@ -0,0 +1,280 @@
+#include "node_marshal.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+    template <typename Row>
+    struct FieldDescriptor
+    {
+        const char *name;
+        // PrinterField bit checked against the row fields, 0 for properties always set
+        unsigned field;
+        Napi::Value (*value)(Napi::Env env, const Row &row);
+    };
+
+    template <typename Row, std::string Row::*Member>
+    Napi::Value StringField(Napi::Env env, const Row &row)
+    {
+        const std::string &value = row.*Member;
+        return Napi::String::New(env, value.data(), value.size());
+    }
+
+    template <typename Row, int Row::*Member>
+    Napi::Value IntField(Napi::Env env, const Row &row)
+    {
+        return Napi::Number::New(env, row.*Member);
+    }
+
+    template <typename Row, std::vector<std::string> Row::*Member>
+    Napi::Value StringArrayField(Napi::Env env, const Row &row)
+    {
+        const std::vector<std::string> &values = row.*Member;
+        Napi::Array result = Napi::Array::New(env, values.size());
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            result[(uint32_t)i] = Napi::String::New(env, values[i].data(), values[i].size());
+        }
+        return result;
+    }
+
+    template <typename Enum, const std::map<Enum, std::string> &Names>
+    Napi::Value EnumName(Napi::Env env, Enum value)
+    {
+        return Napi::String::New(env, Names.at(value));
+    }
+
+    const FieldDescriptor<PrinterInfo> PRINTER_INFO_FIELDS[] = {
+        {"name", PRINTER_FIELD_NAME, StringField<PrinterInfo, &PrinterInfo::name>},
+        {"server", PRINTER_FIELD_SERVER, StringField<PrinterInfo, &PrinterInfo::server>},
+        {"shareName", PRINTER_FIELD_SHARE_NAME, StringField<PrinterInfo, &PrinterInfo::shareName>},
+        {"portName", PRINTER_FIELD_PORT_NAME, StringField<PrinterInfo, &PrinterInfo::portName>},
+        {"driverName", PRINTER_FIELD_DRIVER_NAME, StringField<PrinterInfo, &PrinterInfo::driverName>},
+        {"location", PRINTER_FIELD_LOCATION, StringField<PrinterInfo, &PrinterInfo::location>},
+        {"comment", PRINTER_FIELD_COMMENT, StringField<PrinterInfo, &PrinterInfo::comment>},
+        {"status", PRINTER_FIELD_STATUS, IntField<PrinterInfo, &PrinterInfo::status>},
+        {"statusArray", PRINTER_FIELD_STATUS_ARRAY, StringArrayField<PrinterInfo, &PrinterInfo::statusArray>},
+        {"attributeArray", PRINTER_FIELD_ATTRIBUTE_ARRAY, StringArrayField<PrinterInfo, &PrinterInfo::attributeArray>},
+        {"averagePPM", PRINTER_FIELD_AVERAGE_PPM, IntField<PrinterInfo, &PrinterInfo::averagePPM>},
+        {"cJobs", PRINTER_FIELD_C_JOBS, IntField<PrinterInfo, &PrinterInfo::cJobs>},
+        {"defaultPriority", PRINTER_FIELD_DEFAULT_PRIORITY, IntField<PrinterInfo, &PrinterInfo::defaultPriority>},
+        {"startTime", PRINTER_FIELD_START_TIME, IntField<PrinterInfo, &PrinterInfo::startTime>},
+        {"untilTime", PRINTER_FIELD_UNTIL_TIME, IntField<PrinterInfo, &PrinterInfo::untilTime>},
+    };
+
+    const FieldDescriptor<JobInfo> JOB_INFO_FIELDS[] = {
+        {"id", 0, IntField<JobInfo, &JobInfo::id>},
+        {"name", 0, StringField<JobInfo, &JobInfo::name>},
+        {"user", 0, StringField<JobInfo, &JobInfo::user>},
+        {"priority", 0, IntField<JobInfo, &JobInfo::priority>},
+        {"size", 0, IntField<JobInfo, &JobInfo::size>},
+        {"status", 0, StringField<JobInfo, &JobInfo::status>},
+        {"position", 0, IntField<JobInfo, &JobInfo::position>},
+        {"totalPages", 0, IntField<JobInfo, &JobInfo::totalPages>},
+        {"pagesPrinted", 0, IntField<JobInfo, &JobInfo::pagesPrinted>},
+    };
+
+    const FieldDescriptor<PrinterDevMode> PRINTER_DEV_MODE_FIELDS[] = {
+        {"deviceName", 0, StringField<PrinterDevMode, &PrinterDevMode::deviceName>},
+        {"paperSize", 0, StringField<PrinterDevMode, &PrinterDevMode::paperSize>},
+        {"orientation", 0, [](Napi::Env env, const PrinterDevMode &devMode)
+         { return EnumName<Orientation, orientation_str>(env, devMode.orientation); }},
+        {"duplex", 0, [](Napi::Env env, const PrinterDevMode &devMode)
+         { return EnumName<Duplex, duplex_str>(env, devMode.duplex); }},
+        {"copies", 0, IntField<PrinterDevMode, &PrinterDevMode::copies>},
+        {"color", 0, [](Napi::Env env, const PrinterDevMode &devMode)
+         { return EnumName<Color, color_str>(env, devMode.color); }},
+        {"defaultSource", 0, StringField<PrinterDevMode, &PrinterDevMode::defaultSource>},
+        {"printQuality", 0, [](Napi::Env env, const PrinterDevMode &devMode)
+         { return EnumName<PrintQuality, printQuality_str>(env, devMode.printQuality); }},
+        {"scale", 0, IntField<PrinterDevMode, &PrinterDevMode::scale>},
+        {"collate", 0, [](Napi::Env env, const PrinterDevMode &devMode) -> Napi::Value
+         { return Napi::Boolean::New(env, devMode.collate); }},
+    };
+
+    // Property keys of every table, created on first use in an environment. They are held as
+    // the elements of arrays: below Node-API 10 a reference can not point to a string
+    struct MarshalKeys
+    {
+        Napi::Reference<Napi::Array> printerInfo;
+        Napi::Reference<Napi::Array> jobInfo;
+        Napi::Reference<Napi::Array> printerDevMode;
+    };
+
+    template <typename Row, size_t Count>
+    Napi::Reference<Napi::Array> CreateKeys(Napi::Env env, const FieldDescriptor<Row> (&descriptors)[Count])
+    {
+        Napi::Array keys = Napi::Array::New(env, Count);
+        for (uint32_t i = 0; i < Count; ++i)
+        {
+            keys.Set(i, Napi::String::New(env, descriptors[i].name));
+        }
+        return Napi::Persistent(keys);
+    }
+
+    MarshalKeys &GetMarshalKeys(Napi::Env env)
+    {
+        MarshalKeys *keys = env.GetInstanceData<MarshalKeys>();
+        if (keys == nullptr)
+        {
+            // Only handed to the environment once complete, a failure half way frees it
+            std::unique_ptr<MarshalKeys> created(new MarshalKeys());
+            created->printerInfo = CreateKeys(env, PRINTER_INFO_FIELDS);
+            created->jobInfo = CreateKeys(env, JOB_INFO_FIELDS);
+            created->printerDevMode = CreateKeys(env, PRINTER_DEV_MODE_FIELDS);
+            keys = created.release();
+            env.SetInstanceData(keys);
+        }
+        return *keys;
+    }
+
+    template <typename Row, size_t Count>
+    void DefineFields(Napi::Object &result, const FieldDescriptor<Row> (&descriptors)[Count],
+                      const Napi::Reference<Napi::Array> &keyArray, const Row &row, unsigned fields)
+    {
+        Napi::Env env = result.Env();
+        Napi::Array keys = keyArray.Value();
+
+        std::vector<Napi::PropertyDescriptor> properties;
+        properties.reserve(Count);
+        for (size_t i = 0; i < Count; ++i)
+        {
+            if (descriptors[i].field == 0 || (descriptors[i].field & fields))
+            {
+                // Same attributes as a property created by Set
+                properties.push_back(Napi::PropertyDescriptor::Value(
+                    keys.Get((uint32_t)i), descriptors[i].value(env, row),
+                    static_cast<napi_property_attributes>(napi_writable | napi_enumerable | napi_configurable)));
+            }
+        }
+
+        result.DefineProperties(properties);
+    }
+}
+
+void ParsePrinterObject(const PrinterInfo &printerInfo, Napi::Object &resultPrinter)
+{
+    DefineFields(resultPrinter, PRINTER_INFO_FIELDS, GetMarshalKeys(resultPrinter.Env()).printerInfo,
+                 printerInfo, printerInfo.fields);
+}
+
+void ParseJobObject(const JobInfo &jobInfo, Napi::Object &resultJob)
+{
+    DefineFields(resultJob, JOB_INFO_FIELDS, GetMarshalKeys(resultJob.Env()).jobInfo, jobInfo, PRINTER_FIELDS_ALL);
+}
+
+void ParseDevModeObject(const PrinterDevMode &printerDevMode, Napi::Object &result)
+{
+    DefineFields(result, PRINTER_DEV_MODE_FIELDS, GetMarshalKeys(result.Env()).printerDevMode,
+                 printerDevMode, PRINTER_FIELDS_ALL);
+}
+
+namespace
+{
+    template <typename Enum, const std::map<Enum, std::string> &Names>
+    void GetEnumOption(const Napi::Object &options, const char *name, unsigned field, unsigned &fields, Enum &value)
+    {
+        Napi::Value option = options.Get(name);
+        if (option.IsUndefined())
+        {
+            return;
+        }
+
+        std::string optionName = option.IsString() ? option.As<Napi::String>().Utf8Value() : std::string();
+        for (const auto &entry : Names)
+        {
+            if (entry.second == optionName)
+            {
+                value = entry.first;
+                fields |= field;
+                return;
+            }
+        }
+        throw Napi::TypeError::New(options.Env(), std::string("Unknown ") + name + ": " + optionName);
+    }
+
+    void GetStringOption(const Napi::Object &options, const char *name, std::string &value)
+    {
+        Napi::Value option = options.Get(name);
+        if (option.IsString())
+        {
+            value = option.As<Napi::String>().Utf8Value();
+        }
+        else if (!option.IsUndefined())
+        {
+            throw Napi::TypeError::New(options.Env(), std::string(name) + " must be a string");
+        }
+    }
+}
+
+void GetJobTicket(const Napi::Value &options, JobTicket &ticket)
+{
+    if (!options.IsObject())
+    {
+        return;
+    }
+    Napi::Value ticketValue = options.As<Napi::Object>().Get("ticket");
+    if (ticketValue.IsUndefined())
+    {
+        return;
+    }
+    if (!ticketValue.IsObject())
+    {
+        throw Napi::TypeError::New(options.Env(), "ticket must be an object");
+    }
+    Napi::Object ticketObject = ticketValue.As<Napi::Object>();
+
+    Napi::Value copies = ticketObject.Get("copies");
+    if (copies.IsNumber())
+    {
+        ticket.copies = copies.As<Napi::Number>().Int32Value();
+        ticket.fields |= TICKET_FIELD_COPIES;
+    }
+    else if (!copies.IsUndefined())
+    {
+        throw Napi::TypeError::New(options.Env(), "copies must be a number");
+    }
+
+    GetEnumOption<Duplex, duplex_str>(ticketObject, "duplex", TICKET_FIELD_DUPLEX, ticket.fields, ticket.duplex);
+    GetEnumOption<Orientation, orientation_str>(ticketObject, "orientation", TICKET_FIELD_ORIENTATION, ticket.fields, ticket.orientation);
+    GetEnumOption<Color, color_str>(ticketObject, "color", TICKET_FIELD_COLOR, ticket.fields, ticket.color);
+    GetEnumOption<PrintQuality, printQuality_str>(ticketObject, "printQuality", TICKET_FIELD_PRINT_QUALITY, ticket.fields, ticket.printQuality);
+    GetStringOption(ticketObject, "tray", ticket.tray);
+    GetStringOption(ticketObject, "jobName", ticket.jobName);
+}
+
+Utf8Value::Utf8Value(const Napi::Value &value) : _data(_inline), _length(0)
+{
+    napi_env env = value.Env();
+
+    if (!value.IsString())
+    {
+        throw Napi::TypeError::New(env, "String expected");
+    }
+
+    // Length first, so a long string is read once into a buffer of the right size
+    napi_status status = napi_get_value_string_utf8(env, value, NULL, 0, &_length);
+    if (status != napi_ok)
+    {
+        throw Napi::Error::New(env);
+    }
+
+    if (_length >= sizeof(_inline))
+    {
+        _heap.reset(new char[_length + 1]);
+        _data = _heap.get();
+    }
+
+    status = napi_get_value_string_utf8(env, value, _data, _length + 1, &_length);
+    if (status != napi_ok)
+    {
+        throw Napi::Error::New(env);
+    }
+}
+
+Napi::String Utf8ToNapiString(Napi::Env env, std::string_view str)
+{
+    return Napi::String::New(env, str.data(), str.size());
+}
@@ -0,0 +1,59 @@
+#ifndef NODE_MARSHAL_HPP
+#define NODE_MARSHAL_HPP
+
+#include "PrinterManager.hpp"
+
+#include <napi.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+/**
+ * Conversion of the PrinterManager structs to JS objects.
+ * Each struct is described once by a table of (property name, PrinterField
+ * bit, value getter). The property keys are created once per environment and
+ * kept in referenced arrays, and every object gets all its properties in a
+ * single DefineProperties call instead of one Set (and one key string) per
+ * property.
+ */
+void ParsePrinterObject(const PrinterInfo &printerInfo, Napi::Object &resultPrinter);
+void ParseJobObject(const JobInfo &jobInfo, Napi::Object &resultJob);
+void ParseDevModeObject(const PrinterDevMode &printerDevMode, Napi::Object &result);
+
+/**
+ * Reads the ticket of an options object, { ticket: { copies, duplex,
+ * orientation, color, printQuality, tray, jobName } }, with the enums named
+ * as getPrinterDevMode reports them. Leaves ticket empty when there is none,
+ * throws a TypeError for values of the wrong kind.
+ */
+void GetJobTicket(const Napi::Value &options, JobTicket &ticket);
+
+/**
+ * UTF-8 bytes of a JS string argument, read straight from the engine.
+ * Printer names and other short strings land in the inline buffer, only
+ * longer ones are allocated. view() is valid while the object lives and is
+ * followed by a terminating NUL. Throws a TypeError for non string values.
+ */
+class Utf8Value
+{
+public:
+    explicit Utf8Value(const Napi::Value &value);
+
+    Utf8Value(const Utf8Value &) = delete;
+    Utf8Value &operator=(const Utf8Value &) = delete;
+
+    std::string_view view() const { return std::string_view(_data, _length); }
+    operator std::string_view() const { return view(); }
+    std::string str() const { return std::string(_data, _length); }
+
+private:
+    char _inline[256];
+    std::unique_ptr<char[]> _heap;
+    char *_data;
+    size_t _length;
+};
+
+Napi::String Utf8ToNapiString(Napi::Env env, std::string_view str);
+
+#endif
@@ -0,0 +1,265 @@
+#include "node_print_job.hpp"
+
+#include "node_worker.hpp"
+
+#include <string>
+#include <system_error>
+#include <thread>
+
+namespace
+{
+    /**
+     * Base of the PrintJob operations. Keeps the JS object alive while the
+     * operation runs and releases the busy flag before the promise settles.
+     */
+    class PrintJobWorker : public PrinterWorker
+    {
+    public:
+        PrintJobWorker(Napi::Env env, PrintJobWrap *wrap)
+            : PrinterWorker(env), wrap(wrap), wrapRef(Napi::Persistent(wrap->Value())) {}
+
+    protected:
+        void OnOK() override
+        {
+            wrap->busy = false;
+            PrinterWorker::OnOK();
+        }
+
+        void OnError(const Napi::Error &error) override
+        {
+            wrap->busy = false;
+            PrinterWorker::OnError(error);
+        }
+
+        PrintJobWrap *wrap;
+
+    private:
+        Napi::ObjectReference wrapRef;
+    };
+
+    class OpenWorker : public PrintJobWorker
+    {
+    public:
+        OpenWorker(Napi::Env env, PrintJobWrap *wrap, std::string_view printerName,
+                   const std::string &docName, const std::string &type, const JobTicket &ticket)
+            : PrintJobWorker(env, wrap), printerName(printerName), docName(docName), type(type), ticket(ticket) {}
+
+    protected:
+        ErrorMessage *Run(PrinterManager &printerManager) override
+        {
+            return printerManager.startJob(printerName, docName, type, ticket, wrap->job, &context);
+        }
+
+        Napi::Value Result(Napi::Env env) override
+        {
+            return Napi::Number::New(env, wrap->job.id);
+        }
+
+    private:
+        PrinterName printerName;
+        std::string docName;
+        std::string type;
+        JobTicket ticket;
+    };
+
+    class WriteWorker : public PrintJobWorker
+    {
+    public:
+        WriteWorker(Napi::Env env, PrintJobWrap *wrap, const Napi::Value &data)
+            : PrintJobWorker(env, wrap)
+        {
+            this->data.Set(data);
+        }
+
+    protected:
+        ErrorMessage *Run(PrinterManager &printerManager) override
+        {
+            return printerManager.writeJob(wrap->job, data.data(), &context);
+        }
+
+        Napi::Value Result(Napi::Env env) override
+        {
+            return env.Undefined();
+        }
+
+    private:
+        PrintData data;
+    };
+
+    class CloseWorker : public PrintJobWorker
+    {
+    public:
+        CloseWorker(Napi::Env env, PrintJobWrap *wrap) : PrintJobWorker(env, wrap) {}
+
+    protected:
+        ErrorMessage *Run(PrinterManager &printerManager) override
+        {
+            return printerManager.endJob(wrap->job, &context);
+        }
+
+        Napi::Value Result(Napi::Env env) override
+        {
+            return Napi::Number::New(env, wrap->job.id);
+        }
+    };
+
+    class CancelWorker : public PrintJobWorker
+    {
+    public:
+        CancelWorker(Napi::Env env, PrintJobWrap *wrap) : PrintJobWorker(env, wrap) {}
+
+    protected:
+        ErrorMessage *Run(PrinterManager &printerManager) override
+        {
+            return printerManager.cancelJob(wrap->job);
+        }
+
+        Napi::Value Result(Napi::Env env) override
+        {
+            return env.Undefined();
+        }
+    };
+
+    /**
+     * Cancels the job of a PrintJob collected while it was open. The cancel is
+     * a spooler request (on CUPS a round trip on a new connection), so it runs
+     * on the pool rather than in the finalizer on the JS thread.
+     */
+    class FinalizeCancelTask : public WorkerTask
+    {
+    public:
+        FinalizeCancelTask(const PrintJob &job) : job(job)
+        {
+            priority = PRIORITY_LOW;
+        }
+
+        void Execute() override
+        {
+            PrinterManager::getInstance().cancelJob(job);
+        }
+
+        void Done() override
+        {
+            delete this;
+        }
+
+        // Outside of the pool, when its queue is full
+        void Run()
+        {
+            Execute();
+            Done();
+        }
+
+    private:
+        PrintJob job;
+    };
+}
+
+Napi::Function PrintJobWrap::Init(Napi::Env env)
+{
+    return DefineClass(env, "PrintJob",
+                       {
+                           InstanceMethod("open", &PrintJobWrap::Open),
+                           InstanceMethod("write", &PrintJobWrap::Write),
+                           InstanceMethod("close", &PrintJobWrap::Close),
+                           InstanceMethod("cancel", &PrintJobWrap::Cancel),
+                           InstanceMethod("isOpen", &PrintJobWrap::IsOpen),
+                       });
+}
+
+PrintJobWrap::PrintJobWrap(const Napi::CallbackInfo &info) : Napi::ObjectWrap<PrintJobWrap>(info)
+{
+}
+
+PrintJobWrap::~PrintJobWrap()
+{
+    // Collected without close(): never leave a half written job in the spooler
+    if (job.handle == NULL)
+    {
+        return;
+    }
+
+    FinalizeCancelTask *task = new FinalizeCancelTask(job);
+    job.handle = NULL;
+    if (WorkerPool::getInstance().submit(task) == NULL)
+    {
+        return;
+    }
+
+    // Full queue, the cancel still must not wait on the JS thread
+    try
+    {
+        std::thread(&FinalizeCancelTask::Run, task).detach();
+    }
+    catch (const std::system_error &)
+    {
+        task->Run();
+    }
+}
+
+void PrintJobWrap::Acquire(Napi::Env env)
+{
+    if (busy)
+    {
+        throw Napi::Error::New(env, "Print job is busy, wait for the previous call to complete");
+    }
+    busy = true;
+}
+
+Napi::Value PrintJobWrap::Open(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3)
+    {
+        throw Napi::Error::New(env, "Wrong number of arguments");
+    }
+
+    if (job.handle != NULL)
+    {
+        throw Napi::Error::New(env, "Print job is already open");
+    }
+
+    Utf8Value printerName(info[0]);
+    std::string docName = Utf8Value(info[1]).str();
+    std::string type = Utf8Value(info[2]).str();
+    JobTicket ticket;
+    GetJobTicket(info[3], ticket);
+
+    Acquire(env);
+    OpenWorker *worker = new OpenWorker(env, this, printerName, docName, type, ticket);
+    return worker->QueuePromise(printerName, info[3]);
+}
+
+Napi::Value PrintJobWrap::Write(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || (!info[0].IsBuffer() && !info[0].IsString()))
+    {
+        throw Napi::Error::New(env, "First argument must be a string or Buffer");
+    }
+
+    Acquire(env);
+    WriteWorker *worker = new WriteWorker(env, this, info[0]);
+    return worker->QueuePromise(std::string_view(), info[1]);
+}
+
+Napi::Value PrintJobWrap::Close(const Napi::CallbackInfo &info)
+{
+    Acquire(info.Env());
+    CloseWorker *worker = new CloseWorker(info.Env(), this);
+    return worker->QueuePromise(std::string_view(), info[0]);
+}
+
+Napi::Value PrintJobWrap::Cancel(const Napi::CallbackInfo &info)
+{
+    Acquire(info.Env());
+    CancelWorker *worker = new CancelWorker(info.Env(), this);
+    return worker->QueuePromise();
+}
+
+Napi::Value PrintJobWrap::IsOpen(const Napi::CallbackInfo &info)
+{
+    return Napi::Boolean::New(info.Env(), job.handle != NULL);
+}
@@ -0,0 +1,41 @@
+#ifndef NODE_PRINT_JOB_HPP
+#define NODE_PRINT_JOB_HPP
+
+#include "PrinterManager.hpp"
+
+#include <napi.h>
+
+/**
+ * Native side of createPrintStream: a spooler job that is opened once and
+ * gets its document written chunk by chunk. Every method returns a Promise
+ * and calls on the same job must not overlap.
+ *
+ * open(printer, docName, type[, options]) starts the job, resolves with the job id;
+ *   options.ticket frames the document with a PJL job ticket, as for printDirect
+ * write(data) String/Buffer, resolves once the chunk was handed to the spooler
+ * close() finishes the document, resolves with the job id
+ * cancel() aborts the job and drops what was written so far
+ * isOpen() true between a successful open and close/cancel
+ */
+class PrintJobWrap : public Napi::ObjectWrap<PrintJobWrap>
+{
+public:
+    static Napi::Function Init(Napi::Env env);
+
+    PrintJobWrap(const Napi::CallbackInfo &info);
+    ~PrintJobWrap();
+
+    PrintJob job;
+    bool busy = false;
+
+private:
+    void Acquire(Napi::Env env);
+
+    Napi::Value Open(const Napi::CallbackInfo &info);
+    Napi::Value Write(const Napi::CallbackInfo &info);
+    Napi::Value Close(const Napi::CallbackInfo &info);
+    Napi::Value Cancel(const Napi::CallbackInfo &info);
+    Napi::Value IsOpen(const Napi::CallbackInfo &info);
+};
+
+#endif
@@ -1,9 +1,21 @@
 #include "node_printer.hpp"
 
 #include "PrinterManager.hpp"
+#include "PrinterCache.hpp"
+#include "JobCoalescer.hpp"
+#include "PageAnalyzer.hpp"
+#include "Halftone.hpp"
+#include "WorkerPool.hpp"
+#include "node_worker.hpp"
+#include "node_marshal.hpp"
+#include "node_columnar.hpp"
+#include "node_print_job.hpp"
+#include "node_printer_wrap.hpp"
+#include "node_printer_watch.hpp"
 
 #include <napi.h>
 
+#include <deque>
 #include <string>
 #include <map>
 #include <utility>
@@ -110,61 +122,693 @@ namespace
     // }
 }
 
-Napi::String StdStringToNapiString(Napi::Env env, const std::string str)
+// Reads the optional { fields: [...] } argument of getPrinters/getPrinter into a PrinterField mask
+unsigned GetPrinterFieldsArgument(const Napi::Value &options)
 {
-    return Napi::String::New(env, str.c_str());
+    Napi::Env env = options.Env();
+
+    if (options.IsUndefined() || options.IsNull())
+    {
+        return PRINTER_FIELDS_ALL;
+    }
+    if (!options.IsObject())
+    {
+        throw Napi::TypeError::New(env, "Options must be an object");
+    }
+
+    Napi::Value fieldsValue = options.As<Napi::Object>().Get("fields");
+    if (fieldsValue.IsUndefined())
+    {
+        return PRINTER_FIELDS_ALL;
+    }
+    if (!fieldsValue.IsArray())
+    {
+        throw Napi::TypeError::New(env, "fields must be an array of property names");
+    }
+
+    Napi::Array fieldNames = fieldsValue.As<Napi::Array>();
+    unsigned fields = 0;
+    for (uint32_t i = 0; i < fieldNames.Length(); i++)
+    {
+        Napi::Value fieldName = fieldNames[i];
+        std::string name = fieldName.IsString() ? fieldName.As<Napi::String>().Utf8Value() : std::string();
+
+        unsigned field = 0;
+        for (const auto &printerField : printerField_str)
+        {
+            if (printerField.second == name)
+            {
+                field = printerField.first;
+                break;
+            }
+        }
+        if (field == 0)
+        {
+            throw Napi::TypeError::New(env, "Unknown printer field: " + name);
+        }
+        fields |= field;
+    }
+
+    return fields;
+}
+
+// Reads { columnar: true } from the optional options argument of the listing exports
+bool GetColumnarArgument(const Napi::Value &options)
+{
+    return options.IsObject() && options.As<Napi::Object>().Get("columnar").ToBoolean().Value();
+}
+
+Napi::Array PrintersToNapiArray(Napi::Env env, std::vector<PrinterInfo> &printersInfo)
+{
+    Napi::Array result = Napi::Array::New(env, printersInfo.size());
+    for (int i = 0; i < (int)printersInfo.size(); ++i)
+    {
+        Napi::Object printerObj = Napi::Object::New(env);
+        ParsePrinterObject(printersInfo[i], printerObj);
+
+        result[i] = printerObj;
+    }
+
+    return result;
+}
+
+Napi::Array JobsToNapiArray(Napi::Env env, std::vector<JobInfo> &jobsInfo)
+{
+    Napi::Array result = Napi::Array::New(env, jobsInfo.size());
+    for (int i = 0; i < (int)jobsInfo.size(); ++i)
+    {
+        Napi::Object jobObj = Napi::Object::New(env);
+        ParseJobObject(jobsInfo[i], jobObj);
+
+        result[i] = jobObj;
+    }
+
+    return result;
+}
+
+Napi::Array StringsToNapiArray(Napi::Env env, const std::vector<std::string> &strings)
+{
+    Napi::Array result = Napi::Array::New(env, strings.size());
+    for (int i = 0; i < (int)strings.size(); ++i)
+    {
+        result[i] = Utf8ToNapiString(env, strings[i]);
+    }
+
+    return result;
+}
+
+class GetOnePrinterWorker : public PrinterWorker
+{
+public:
+    GetOnePrinterWorker(Napi::Env env, std::string_view printerName, unsigned fields)
+        : PrinterWorker(env), printerName(printerName), fields(fields) {}
+
+protected:
+    ErrorMessage *Run(PrinterManager &) override
+    {
+        return PrinterCache::getInstance().getOnePrinter(printerName, printerInfo, fields, &context);
+    }
+
+    Napi::Value Result(Napi::Env env) override
+    {
+        Napi::Object resultPrinter = Napi::Object::New(env);
+        ParsePrinterObject(printerInfo, resultPrinter);
+        return resultPrinter;
+    }
+
+private:
+    PrinterName printerName;
+    unsigned fields;
+    PrinterInfo printerInfo;
+};
+
+class GetDefaultPrinterNameWorker : public PrinterWorker
+{
+public:
+    GetDefaultPrinterNameWorker(Napi::Env env) : PrinterWorker(env) {}
+
+protected:
+    ErrorMessage *Run(PrinterManager &printerManager) override
+    {
+        return printerManager.getDefaultPrinterName(defaultPrinterName, &context);
+    }
+
+    Napi::Value Result(Napi::Env env) override
+    {
+        return Utf8ToNapiString(env, defaultPrinterName);
+    }
+
+private:
+    PrinterName defaultPrinterName;
+};
+
+class GetPrintersWorker : public PrinterWorker
+{
+public:
+    GetPrintersWorker(Napi::Env env, unsigned fields, bool columnar)
+        : PrinterWorker(env), fields(fields), columnar(columnar) {}
+
+protected:
+    ErrorMessage *Run(PrinterManager &) override
+    {
+        return PrinterCache::getInstance().getPrinters(printersInfo, fields, &context);
+    }
+
+    Napi::Value Result(Napi::Env env) override
+    {
+        if (columnar)
+        {
+            return PrintersToColumns(env, printersInfo, fields);
+        }
+        return PrintersToNapiArray(env, printersInfo);
+    }
+
+private:
+    unsigned fields;
+    bool columnar;
+    std::vector<PrinterInfo> printersInfo;
+};
+
+class PrintDirectWorker : public PrinterWorker, public CoalescedJob
+{
+public:
+    PrintDirectWorker(Napi::Env env, const Napi::Value &data, std::string_view printerName,
+                      const std::string &docName, const std::string &type, const JobTicket &ticket)
+        : PrinterWorker(env), printerName(printerName), docName(docName), type(type), ticket(ticket)
+    {
+        this->data.Set(data);
+    }
+
+protected:
+    ErrorMessage *Run(PrinterManager &printerManager) override
+    {
+        return printerManager.printDirect(printerName, docName, type, ticket, data.data(), jobId, &context);
+    }
+
+    // Small RAW jobs wait for others of their printer when coalescing is on,
+    // a job with a ticket of its own is never merged with others
+    ErrorMessage *Submit() override
+    {
+        JobCoalescer &coalescer = JobCoalescer::getInstance();
+        if (!ticket.empty() || !coalescer.accepts(type, data.data().size()))
+        {
+            return PrinterWorker::Submit();
+        }
+        return coalescer.add(printerName, docName, type, data.data(), this, &context);
+    }
+
+    void Coalesced(ErrorMessage *errorMessage, int jobId) override
+    {
+        this->jobId = jobId;
+        Finish(errorMessage);
+    }
+
+    Napi::Value Result(Napi::Env env) override
+    {
+        return Napi::Number::New(env, jobId);
+    }
+
+private:
+    PrinterName printerName;
+    std::string docName;
+    std::string type;
+    JobTicket ticket;
+    PrintData data;
+    int jobId = 0;
+};
+
+class PrintFileWorker : public PrinterWorker
+{
+public:
+    PrintFileWorker(Napi::Env env, const std::string &path, std::string_view printerName,
+                    const std::string &docName, const std::string &type)
+        : PrinterWorker(env), path(path), printerName(printerName), docName(docName), type(type) {}
+
+protected:
+    ErrorMessage *Run(PrinterManager &printerManager) override
+    {
+        return printerManager.printFile(printerName, path, docName, type, jobId, &context);
+    }
+
+    Napi::Value Result(Napi::Env env) override
+    {
+        return Napi::Number::New(env, jobId);
+    }
+
+private:
+    std::string path;
+    PrinterName printerName;
+    std::string docName;
+    std::string type;
+    int jobId = 0;
+};
+
+// Reads the (printer, documents[, options]) arguments of printBatch. A document is a string, a
+// Buffer or { data, docname, type }; options give the job name and the type of the others.
+// The documents borrow from data, which has to stay in place
+void GetPrintBatchArguments(const Napi::CallbackInfo &info, PrinterName &printerName, std::string &jobName,
+                            std::deque<PrintData> &data, std::vector<BatchDocument> &documents)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2)
+    {
+        throw Napi::Error::New(env, "Wrong number of arguments");
+    }
+
+    if (!info[1].IsArray())
+    {
+        throw Napi::TypeError::New(env, "Documents must be an array");
+    }
+
+    printerName = Utf8Value(info[0]).str();
+    jobName = "batch";
+    std::string type = "RAW";
+
+    if (info.Length() > 2 && info[2].IsObject())
+    {
+        Napi::Object options = info[2].As<Napi::Object>();
+        if (!options.Get("jobName").IsUndefined())
+        {
+            jobName = Utf8Value(options.Get("jobName")).str();
+        }
+        if (!options.Get("type").IsUndefined())
+        {
+            type = Utf8Value(options.Get("type")).str();
+        }
+    }
+
+    Napi::Array items = info[1].As<Napi::Array>();
+    if (items.Length() == 0)
+    {
+        throw Napi::Error::New(env, "Batch has no documents");
+    }
+
+    documents.resize(items.Length());
+    for (uint32_t i = 0; i < items.Length(); i++)
+    {
+        Napi::Value item = items[i];
+        BatchDocument &document = documents[i];
+        document.docName = jobName;
+        document.type = type;
+
+        if (item.IsObject() && !item.IsBuffer())
+        {
+            Napi::Object object = item.As<Napi::Object>();
+            item = object.Get("data");
+            if (!object.Get("docname").IsUndefined())
+            {
+                document.docName = Utf8Value(object.Get("docname")).str();
+            }
+            if (!object.Get("type").IsUndefined())
+            {
+                document.type = Utf8Value(object.Get("type")).str();
+            }
+        }
+
+        if (!item.IsBuffer() && !item.IsString())
+        {
+            throw Napi::TypeError::New(env, "Batch documents must be strings, Buffers or { data } objects");
+        }
+
+        data.emplace_back();
+        data.back().Set(item);
+        document.data = data.back().data();
+    }
 }
 
-Napi::String StdStringToNapiString(Napi::Env env, const std::wstring str)
+// Reads an optional integer option, keeps value when it is undefined
+void GetIntOption(const Napi::Object &options, const char *name, const char *error, int &value)
 {
-    std::string strTo(str.begin(), str.end());
-    return Napi::String::New(env, strTo.c_str());
+    Napi::Value option = options.Get(name);
+    if (option.IsNumber())
+    {
+        value = option.As<Napi::Number>().Int32Value();
+    }
+    else if (!option.IsUndefined())
+    {
+        throw Napi::TypeError::New(options.Env(), error);
+    }
 }
 
-std::wstring GetWStringFromNapiValue(const Napi::Value &value)
+// Reads a { data, width, height, format: 'gray' | 'rgb' | 'rgba', stride } image; page borrows from data
+void GetRasterPage(const Napi::Value &item, PrintData &data, RasterPage &page)
 {
-    if (!value.IsString())
+    Napi::Env env = item.Env();
+
+    if (!item.IsObject())
+    {
+        throw Napi::TypeError::New(env, "Pages must be { data, width, height } objects");
+    }
+    Napi::Object object = item.As<Napi::Object>();
+
+    int width = 0, height = 0, stride = 0;
+    GetIntOption(object, "width", "width must be a number of pixels", width);
+    GetIntOption(object, "height", "height must be a number of pixels", height);
+    GetIntOption(object, "stride", "stride must be a number of bytes", stride);
+    if (width <= 0 || height <= 0 || stride < 0)
     {
-        throw Napi::TypeError::New(value.Env(), "String expected");
+        throw Napi::RangeError::New(env, "Page width and height must be positive, stride can not be negative");
     }
-    std::u16string temp = value.As<Napi::String>().Utf16Value();
-    return std::wstring(temp.begin(), temp.end());
+    page.width = (uint32_t)width;
+    page.height = (uint32_t)height;
+    page.stride = (size_t)stride;
+
+    if (!object.Get("format").IsUndefined())
+    {
+        std::string format = Utf8Value(object.Get("format")).str();
+        if (format == "gray")
+        {
+            page.format = PIXEL_GRAY;
+        }
+        else if (format == "rgb")
+        {
+            page.format = PIXEL_RGB;
+        }
+        else if (format != "rgba")
+        {
+            throw Napi::TypeError::New(env, "Page format must be 'gray', 'rgb' or 'rgba'");
+        }
+    }
+
+    Napi::Value pixels = object.Get("data");
+    if (!pixels.IsBuffer() && !pixels.IsTypedArray())
+    {
+        throw Napi::TypeError::New(env, "Page data must be a Buffer or typed array");
+    }
+    data.Set(pixels);
+    page.pixels = data.data();
 }
 
-void AddResultStringArray(Napi::Env env, Napi::Object &result, const std::vector<std::string> &array, const std::string &name)
+// Reads the (printer, pages[, options]) arguments of printRaster, pages read by GetRasterPage and
+// options { resolution, colorSpace: 'sgray' | 'srgb', format: 'pwg' | 'urf', jobName }. The pages
+// borrow from data, which has to stay in place
+void GetPrintRasterArguments(const Napi::CallbackInfo &info, PrinterName &printerName, std::string &jobName,
+                             RasterOptions &rasterOptions, std::deque<PrintData> &data, std::vector<RasterPage> &pages)
 {
-    Napi::Array arrayResult = Napi::Array::New(env, array.size());
-    for (int i = 0; i < (int)array.size(); ++i)
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2)
+    {
+        throw Napi::Error::New(env, "Wrong number of arguments");
+    }
+    if (!info[1].IsArray())
+    {
+        throw Napi::TypeError::New(env, "Pages must be an array");
+    }
+
+    printerName = Utf8Value(info[0]).str();
+    jobName = "raster";
+
+    if (info.Length() > 2 && info[2].IsObject())
+    {
+        Napi::Object options = info[2].As<Napi::Object>();
+        if (!options.Get("jobName").IsUndefined())
+        {
+            jobName = Utf8Value(options.Get("jobName")).str();
+        }
+        GetIntOption(options, "resolution", "resolution must be a number of dots per inch", rasterOptions.resolution);
+        if (!options.Get("colorSpace").IsUndefined())
+        {
+            std::string colorSpace = Utf8Value(options.Get("colorSpace")).str();
+            if (colorSpace != "sgray" && colorSpace != "srgb")
+            {
+                throw Napi::TypeError::New(env, "colorSpace must be 'sgray' or 'srgb'");
+            }
+            rasterOptions.colorSpace = colorSpace == "sgray" ? RASTER_SGRAY : RASTER_SRGB;
+        }
+        if (!options.Get("format").IsUndefined())
+        {
+            std::string format = Utf8Value(options.Get("format")).str();
+            if (format != "pwg" && format != "urf")
+            {
+                throw Napi::TypeError::New(env, "format must be 'pwg' or 'urf'");
+            }
+            rasterOptions.format = format == "urf" ? RASTER_URF : RASTER_PWG;
+        }
+    }
+
+    Napi::Array items = info[1].As<Napi::Array>();
+    pages.resize(items.Length());
+    for (uint32_t i = 0; i < items.Length(); i++)
     {
-        arrayResult[i] = StdStringToNapiString(env, array[i]);
+        data.emplace_back();
+        GetRasterPage(items[i], data.back(), pages[i]);
     }
-    result.Set(name, arrayResult);
 }
 
-void ParsePrinterObject(PrinterInfo &printerInfo, Napi::Object &resultPrinter)
+class PrintRasterWorker : public PrinterWorker
 {
+public:
+    PrintRasterWorker(const Napi::CallbackInfo &info) : PrinterWorker(info.Env())
+    {
+        GetPrintRasterArguments(info, printerName, jobName, options, data, pages);
+    }
+
+    const PrinterName &printer() const { return printerName; }
+
+protected:
+    ErrorMessage *Run(PrinterManager &printerManager) override
+    {
+        return printerManager.printRaster(printerName, jobName, pages, options, jobId, &context);
+    }
+
+    Napi::Value Result(Napi::Env env) override
+    {
+        return Napi::Number::New(env, jobId);
+    }
 
-    Napi::Env env = resultPrinter.Env();
+private:
+    PrinterName printerName;
+    std::string jobName;
+    RasterOptions options;
+    std::deque<PrintData> data;
+    std::vector<RasterPage> pages;
+    int jobId = 0;
+};
 
-    resultPrinter.Set("name", StdStringToNapiString(env, printerInfo.name));
-    resultPrinter.Set("server", StdStringToNapiString(env, printerInfo.server));
-    resultPrinter.Set("shareName", StdStringToNapiString(env, printerInfo.shareName));
-    resultPrinter.Set("portName", StdStringToNapiString(env, printerInfo.portName));
-    resultPrinter.Set("driverName", StdStringToNapiString(env, printerInfo.driverName));
-    resultPrinter.Set("location", StdStringToNapiString(env, printerInfo.location));
-    resultPrinter.Set("comment", StdStringToNapiString(env, printerInfo.comment));
-    resultPrinter.Set("status", Napi::Number::New(env, printerInfo.status));
+// Reads the (image[, options]) arguments of halftone, the image read by GetRasterPage and options
+// { method: 'threshold' | 'ordered' | 'floyd-steinberg', threshold, output: 'bitmap' | 'zpl' | 'escpos' }
+void GetHalftoneArguments(const Napi::CallbackInfo &info, PrintData &data, RasterPage &page, HalftoneOptions &options)
+{
+    Napi::Env env = info.Env();
 
-    AddResultStringArray(env, resultPrinter, printerInfo.statusArray, std::string("statusArray"));
-    AddResultStringArray(env, resultPrinter, printerInfo.attributeArray, std::string("attributeArray"));
+    if (info.Length() < 1)
+    {
+        throw Napi::Error::New(env, "Wrong number of arguments");
+    }
 
-    resultPrinter.Set("averagePPM", Napi::Number::New(env, printerInfo.averagePPM));
-    resultPrinter.Set("cJobs", Napi::Number::New(env, printerInfo.cJobs));
-    resultPrinter.Set("defaultPriority", Napi::Number::New(env, printerInfo.defaultPriority));
-    resultPrinter.Set("startTime", Napi::Number::New(env, printerInfo.startTime));
-    resultPrinter.Set("untilTime", Napi::Number::New(env, printerInfo.untilTime));
+    GetRasterPage(info[0], data, page);
+
+    if (info.Length() > 1 && info[1].IsObject())
+    {
+        Napi::Object object = info[1].As<Napi::Object>();
+        if (!object.Get("method").IsUndefined())
+        {
+            std::string method = Utf8Value(object.Get("method")).str();
+            if (method == "threshold")
+            {
+                options.method = HALFTONE_THRESHOLD;
+            }
+            else if (method == "floyd-steinberg")
+            {
+                options.method = HALFTONE_FLOYD_STEINBERG;
+            }
+            else if (method != "ordered")
+            {
+                throw Napi::TypeError::New(env, "method must be 'threshold', 'ordered' or 'floyd-steinberg'");
+            }
+        }
+        GetIntOption(object, "threshold", "threshold must be a gray level", options.threshold);
+        if (!object.Get("output").IsUndefined())
+        {
+            std::string output = Utf8Value(object.Get("output")).str();
+            if (output == "zpl")
+            {
+                options.output = BITMAP_ZPL;
+            }
+            else if (output == "escpos")
+            {
+                options.output = BITMAP_ESCPOS;
+            }
+            else if (output != "bitmap")
+            {
+                throw Napi::TypeError::New(env, "output must be 'bitmap', 'zpl' or 'escpos'");
+            }
+        }
+    }
 }
 
+class PrintBatchWorker : public PrinterWorker
+{
+public:
+    PrintBatchWorker(const Napi::CallbackInfo &info) : PrinterWorker(info.Env())
+    {
+        GetPrintBatchArguments(info, printerName, jobName, data, documents);
+    }
+
+    const PrinterName &printer() const { return printerName; }
+
+protected:
+    ErrorMessage *Run(PrinterManager &printerManager) override
+    {
+        return printerManager.printBatch(printerName, jobName, documents, jobId, &context);
+    }
+
+    Napi::Value Result(Napi::Env env) override
+    {
+        return Napi::Number::New(env, jobId);
+    }
+
+private:
+    PrinterName printerName;
+    std::string jobName;
+    std::deque<PrintData> data;
+    std::vector<BatchDocument> documents;
+    int jobId = 0;
+};
+
+class AnalyzeFileWorker : public PrinterWorker
+{
+public:
+    AnalyzeFileWorker(Napi::Env env, const std::string &path) : PrinterWorker(env), path(path) {}
+
+protected:
+    ErrorMessage *Run(PrinterManager &printerManager) override
+    {
+        return analyzeFile(path, analysis, &context);
+    }
+
+    Napi::Value Result(Napi::Env env) override;
+
+private:
+    std::string path;
+    PageAnalysis analysis;
+};
+
+class HalftoneWorker : public PrinterWorker
+{
+public:
+    HalftoneWorker(const Napi::CallbackInfo &info) : PrinterWorker(info.Env())
+    {
+        GetHalftoneArguments(info, data, page, options);
+    }
+
+protected:
+    ErrorMessage *Run(PrinterManager &printerManager) override
+    {
+        return renderBitmap(page, options, output);
+    }
+
+    Napi::Value Result(Napi::Env env) override
+    {
+        return Napi::Buffer<char>::Copy(env, output.data(), output.size());
+    }
+
+private:
+    PrintData data;
+    RasterPage page;
+    HalftoneOptions options;
+    std::string output;
+};
+
+class GetOneJobWorker : public PrinterWorker
+{
+public:
+    GetOneJobWorker(Napi::Env env, std::string_view printerName, int jobId)
+        : PrinterWorker(env), printerName(printerName), jobId(jobId) {}
+
+protected:
+    ErrorMessage *Run(PrinterManager &printerManager) override
+    {
+        return printerManager.getOneJob(printerName, jobId, jobInfo, &context);
+    }
+
+    Napi::Value Result(Napi::Env env) override
+    {
+        Napi::Object resultPrinterJob = Napi::Object::New(env);
+        ParseJobObject(jobInfo, resultPrinterJob);
+        return resultPrinterJob;
+    }
+
+private:
+    PrinterName printerName;
+    int jobId;
+    JobInfo jobInfo;
+};
+
+class GetJobsWorker : public PrinterWorker
+{
+public:
+    GetJobsWorker(Napi::Env env, std::string_view printerName, const std::vector<int> &jobIds, bool columnar)
+        : PrinterWorker(env), printerName(printerName), jobIds(jobIds), columnar(columnar) {}
+
+protected:
+    ErrorMessage *Run(PrinterManager &printerManager) override
+    {
+        return printerManager.getJobs(printerName, jobIds, jobsInfo, &context);
+    }
+
+    Napi::Value Result(Napi::Env env) override
+    {
+        if (columnar)
+        {
+            return JobsToColumns(env, jobsInfo);
+        }
+        return JobsToNapiArray(env, jobsInfo);
+    }
+
+private:
+    PrinterName printerName;
+    std::vector<int> jobIds;
+    bool columnar;
+    std::vector<JobInfo> jobsInfo;
+};
+
+class GetSupportedPrintFormatsWorker : public PrinterWorker
+{
+public:
+    GetSupportedPrintFormatsWorker(Napi::Env env) : PrinterWorker(env) {}
+
+protected:
+    ErrorMessage *Run(PrinterManager &printerManager) override
+    {
+        return printerManager.getSupportedPrintFormats(dataTypes);
+    }
+
+    Napi::Value Result(Napi::Env env) override
+    {
+        return StringsToNapiArray(env, dataTypes);
+    }
+
+private:
+    std::vector<std::string> dataTypes;
+};
+
+class GetPrinterDevModeWorker : public PrinterWorker
+{
+public:
+    GetPrinterDevModeWorker(Napi::Env env, std::string_view printerName)
+        : PrinterWorker(env), printerName(printerName) {}
+
+protected:
+    ErrorMessage *Run(PrinterManager &printerManager) override
+    {
+        return printerManager.getPrinterDevMode(printerName, printerDevMode);
+    }
+
+    Napi::Value Result(Napi::Env env) override
+    {
+        Napi::Object result = Napi::Object::New(env);
+        ParseDevModeObject(printerDevMode, result);
+        return result;
+    }
+
+private:
+    PrinterName printerName;
+    PrinterDevMode printerDevMode;
+};
+
 // N-API function implementations
 Napi::Value GetOnePrinter(const Napi::CallbackInfo &info)
 {
@@ -185,13 +829,12 @@ Napi::Value GetOnePrinter(const Napi::CallbackInfo &info)
         return env.Null();
     }
 
-    // Convert JS string to wide string
-    std::wstring printerName = GetWStringFromNapiValue(info[0]);
+    Utf8Value printerName(info[0]);
+    unsigned fields = GetPrinterFieldsArgument(info[1]);
 
-    PrinterManager *printerManager = new PrinterManager();
     PrinterInfo printerInfo;
 
-    ErrorMessage *errorMessage = printerManager->getOnePrinter(printerName, printerInfo);
+    ErrorMessage *errorMessage = PrinterCache::getInstance().getOnePrinter(printerName, printerInfo, fields);
     if (errorMessage != NULL)
     {
         Napi::Error::New(env, (std::string)*errorMessage).ThrowAsJavaScriptException();
@@ -204,46 +847,79 @@ Napi::Value GetOnePrinter(const Napi::CallbackInfo &info)
     return resultPrinter;
 }
 
+Napi::Value GetOnePrinterAsync(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1)
+    {
+        Napi::TypeError::New(env, "Wrong number of arguments")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    if (!info[0].IsString())
+    {
+        Napi::TypeError::New(env, "String expected")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Utf8Value printerName(info[0]);
+    unsigned fields = GetPrinterFieldsArgument(info[1]);
+
+    GetOnePrinterWorker *worker = new GetOnePrinterWorker(env, printerName, fields);
+    return worker->QueuePromise(std::string_view(), info[1]);
+}
+
 Napi::String GetDefaultPrinterName(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
 
-    PrinterManager *printerManager = new PrinterManager();
+    PrinterManager &printerManager = PrinterManager::getInstance();
     PrinterName defaultPrinterName;
 
-    ErrorMessage *errorMessage = printerManager->getDefaultPrinterName(defaultPrinterName);
+    ErrorMessage *errorMessage = printerManager.getDefaultPrinterName(defaultPrinterName);
     if (errorMessage != NULL)
     {
         Napi::Error::New(env, (std::string)*errorMessage).ThrowAsJavaScriptException();
         return Napi::String::New(env, "");
     }
 
-    return StdStringToNapiString(env, defaultPrinterName);
+    return Utf8ToNapiString(env, defaultPrinterName);
+}
+
+Napi::Value GetDefaultPrinterNameAsync(const Napi::CallbackInfo &info)
+{
+    GetDefaultPrinterNameWorker *worker = new GetDefaultPrinterNameWorker(info.Env());
+    return worker->QueuePromise(std::string_view(), info[0]);
 }
 
-Napi::Array GetPrinters(const Napi::CallbackInfo &info)
+Napi::Value GetPrinters(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
 
-    PrinterManager *printerManager = new PrinterManager();
+    unsigned fields = GetPrinterFieldsArgument(info[0]);
     std::vector<PrinterInfo> printersInfo;
-    ErrorMessage *errorMessage = printerManager->getPrinters(printersInfo);
+    ErrorMessage *errorMessage = PrinterCache::getInstance().getPrinters(printersInfo, fields);
     if (errorMessage != NULL)
     {
         Napi::Error::New(env, (std::string)*errorMessage).ThrowAsJavaScriptException();
         return Napi::Array::New(env, 0);
     }
 
-    Napi::Array result = Napi::Array::New(env, printersInfo.size());
-    for (int i = 0; i < (int)printersInfo.size(); ++i)
+    if (GetColumnarArgument(info[0]))
     {
-        Napi::Object printerObj = Napi::Object::New(env);
-        ParsePrinterObject(printersInfo[i], printerObj);
-
-        result[i] = printerObj;
+        return PrintersToColumns(env, printersInfo, fields);
     }
+    return PrintersToNapiArray(env, printersInfo);
+}
 
-    return result;
+Napi::Value GetPrintersAsync(const Napi::CallbackInfo &info)
+{
+    unsigned fields = GetPrinterFieldsArgument(info[0]);
+    GetPrintersWorker *worker = new GetPrintersWorker(info.Env(), fields, GetColumnarArgument(info[0]));
+    return worker->QueuePromise(std::string_view(), info[0]);
 }
 
 Napi::Value PrintDirect(const Napi::CallbackInfo &info)
@@ -255,80 +931,320 @@ Napi::Value PrintDirect(const Napi::CallbackInfo &info)
         throw Napi::Error::New(env, "Wrong number of arguments");
     }
 
-    std::string data;
-    if (info[0].IsString())
+    PrintData data;
+    data.Set(info[0]);
+
+    Utf8Value printerName(info[1]);
+    std::string docName = Utf8Value(info[2]).str();
+    std::string type = Utf8Value(info[3]).str();
+    JobTicket ticket;
+    GetJobTicket(info[4], ticket);
+
+    int jobId = 0;
+
+    PrinterManager &printerManager = PrinterManager::getInstance();
+    ErrorMessage *errorMessage = printerManager.printDirect(printerName, docName, type, ticket, data.data(), jobId);
+    if (errorMessage != NULL)
     {
-        data = info[0].As<Napi::String>().Utf8Value();
+        Napi::Error::New(env, (std::string)*errorMessage).ThrowAsJavaScriptException();
+        return env.Null();
     }
-    else if (info[0].IsBuffer())
+    // std::wstring printerName = GetWStringFromNapiValue(info[1]);
+    // std::wstring docName = GetWStringFromNapiValue(info[2]);
+    // std::wstring type = GetWStringFromNapiValue(info[3]);
+
+    // PrinterHandle printerHandle((LPWSTR)printerName.c_str());
+
+    // if (!printerHandle)
+    // {
+    //     std::string error = "PrinterHandle error: " + GetLastErrorMessage();
+    //     throw Napi::Error::New(env, error);
+    // }
+
+    // DOC_INFO_1W DocInfo;
+    // DocInfo.pDocName = (LPWSTR)docName.c_str();
+    // DocInfo.pOutputFile = NULL;
+    // DocInfo.pDatatype = (LPWSTR)type.c_str();
+
+    // DWORD jobId = StartDocPrinterW(*printerHandle, 1, (LPBYTE)&DocInfo);
+    // if (jobId == 0)
+    // {
+    //     std::string error = "StartDocPrinter error: " + GetLastErrorMessage();
+    //     throw Napi::Error::New(env, error);
+    // }
+
+    // if (!StartPagePrinter(*printerHandle))
+    // {
+    //     std::string error = "StartPagePrinter error: " + GetLastErrorMessage();
+    //     throw Napi::Error::New(env, error);
+    // }
+
+    // DWORD bytesWritten = 0;
+    // BOOL success = WritePrinter(*printerHandle, (LPVOID)data.c_str(),
+    //                             (DWORD)data.size(), &bytesWritten);
+
+    // EndPagePrinter(*printerHandle);
+    // EndDocPrinter(*printerHandle);
+
+    // if (!success || bytesWritten != data.size())
+    // {
+    //     throw Napi::Error::New(env, "Failed to write all data to printer");
+    // }
+
+    return Napi::Number::New(env, jobId);
+}
+
+Napi::Value PrintDirectAsync(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 4)
+    {
+        throw Napi::Error::New(env, "Wrong number of arguments");
+    }
+
+    if (!info[0].IsBuffer() && !info[0].IsString())
     {
-        Napi::Buffer<char> buffer = info[0].As<Napi::Buffer<char>>();
-        data = std::string(buffer.Data(), buffer.Length());
+        throw Napi::Error::New(env, "First argument must be a string or Buffer");
     }
-    else
+
+    Utf8Value printerName(info[1]);
+    std::string docName = Utf8Value(info[2]).str();
+    std::string type = Utf8Value(info[3]).str();
+    JobTicket ticket;
+    GetJobTicket(info[4], ticket);
+
+    PrintDirectWorker *worker = new PrintDirectWorker(env, info[0], printerName, docName, type, ticket);
+    return worker->QueuePromise(printerName, info[4]);
+}
+
+// Reads the (filename, printer[, docname[, type]]) arguments of printFile
+void GetPrintFileArguments(const Napi::CallbackInfo &info, std::string &path, PrinterName &printerName,
+                           std::string &docName, std::string &type)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2)
+    {
+        throw Napi::Error::New(env, "Wrong number of arguments");
+    }
+
+    if (!info[0].IsString())
+    {
+        throw Napi::TypeError::New(env, "File name must be a string");
+    }
+
+    path = info[0].As<Napi::String>().Utf8Value();
+    printerName = Utf8Value(info[1]).str();
+    docName = path;
+    type = "RAW";
+
+    if (info.Length() > 2 && !info[2].IsUndefined())
+    {
+        docName = Utf8Value(info[2]).str();
+    }
+
+    if (info.Length() > 3 && !info[3].IsUndefined())
+    {
+        type = Utf8Value(info[3]).str();
+    }
+}
+
+Napi::Value PrintFile(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    std::string path, docName, type;
+    PrinterName printerName;
+    GetPrintFileArguments(info, path, printerName, docName, type);
+
+    int jobId = 0;
+
+    PrinterManager &printerManager = PrinterManager::getInstance();
+    ErrorMessage *errorMessage = printerManager.printFile(printerName, path, docName, type, jobId);
+    if (errorMessage != NULL)
+    {
+        Napi::Error::New(env, (std::string)*errorMessage).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    return Napi::Number::New(env, jobId);
+}
+
+Napi::Value PrintFileAsync(const Napi::CallbackInfo &info)
+{
+    std::string path, docName, type;
+    PrinterName printerName;
+    GetPrintFileArguments(info, path, printerName, docName, type);
+
+    PrintFileWorker *worker = new PrintFileWorker(info.Env(), path, printerName, docName, type);
+    return worker->QueuePromise(printerName, info[4]);
+}
+
+Napi::Value PrintBatch(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    PrinterName printerName;
+    std::string jobName;
+    std::deque<PrintData> data;
+    std::vector<BatchDocument> documents;
+    GetPrintBatchArguments(info, printerName, jobName, data, documents);
+
+    int jobId = 0;
+    ErrorMessage *errorMessage = PrinterManager::getInstance().printBatch(printerName, jobName, documents, jobId);
+    if (errorMessage != NULL)
+    {
+        throw Napi::Error::New(env, *errorMessage);
+    }
+
+    return Napi::Number::New(env, jobId);
+}
+
+Napi::Value PrintBatchAsync(const Napi::CallbackInfo &info)
+{
+    PrintBatchWorker *worker = new PrintBatchWorker(info);
+    return worker->QueuePromise(worker->printer(), info[2]);
+}
+
+Napi::Value PrintRaster(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    PrinterName printerName;
+    std::string jobName;
+    RasterOptions options;
+    std::deque<PrintData> data;
+    std::vector<RasterPage> pages;
+    GetPrintRasterArguments(info, printerName, jobName, options, data, pages);
+
+    int jobId = 0;
+    ErrorMessage *errorMessage = PrinterManager::getInstance().printRaster(printerName, jobName, pages, options, jobId);
+    if (errorMessage != NULL)
+    {
+        throw Napi::Error::New(env, *errorMessage);
+    }
+
+    return Napi::Number::New(env, jobId);
+}
+
+Napi::Value PrintRasterAsync(const Napi::CallbackInfo &info)
+{
+    PrintRasterWorker *worker = new PrintRasterWorker(info);
+    return worker->QueuePromise(worker->printer(), info[2]);
+}
+
+Napi::Value Halftone(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    PrintData data;
+    RasterPage page;
+    HalftoneOptions options;
+    GetHalftoneArguments(info, data, page, options);
+
+    std::string output;
+    ErrorMessage *errorMessage = renderBitmap(page, options, output);
+    if (errorMessage != NULL)
+    {
+        throw Napi::Error::New(env, *errorMessage);
+    }
+
+    return Napi::Buffer<char>::Copy(env, output.data(), output.size());
+}
+
+Napi::Value HalftoneAsync(const Napi::CallbackInfo &info)
+{
+    HalftoneWorker *worker = new HalftoneWorker(info);
+    return worker->QueuePromise({}, info[1]);
+}
+
+Napi::Value DetectDocumentFormat(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || (!info[0].IsBuffer() && !info[0].IsString()))
+    {
+        throw Napi::TypeError::New(env, "First argument must be a string or Buffer");
+    }
+
+    PrintData data;
+    data.Set(info[0]);
+
+    return Napi::String::New(env, getDocumentFormatName(sniffDocumentFormat(data.data())));
+}
+
+// { language, pages, copies, duplex, pageEnds, bytes }; offsets are doubles, archives pass 4GB
+static Napi::Object ParsePageAnalysis(Napi::Env env, const PageAnalysis &analysis)
+{
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("language", Napi::String::New(env, getDocumentFormatName(analysis.language)));
+    result.Set("pages", Napi::Number::New(env, analysis.pages));
+    result.Set("copies", Napi::Number::New(env, analysis.copies));
+    result.Set("duplex", Napi::Boolean::New(env, analysis.duplex));
+
+    Napi::Float64Array pageEnds = Napi::Float64Array::New(env, analysis.pageEnds.size());
+    for (size_t i = 0; i < analysis.pageEnds.size(); i++)
     {
-        throw Napi::Error::New(env, "First argument must be a string or Buffer");
+        pageEnds[i] = (double)analysis.pageEnds[i];
     }
+    result.Set("pageEnds", pageEnds);
+    result.Set("bytes", Napi::Number::New(env, (double)analysis.bytes));
+    return result;
+}
 
-    std::wstring printerNameWide = GetWStringFromNapiValue(info[1]);
-    std::wstring docNameWide = GetWStringFromNapiValue(info[2]);
-    std::wstring typeWide = GetWStringFromNapiValue(info[3]);
-
-    std::string docName = std::string(docNameWide.begin(), docNameWide.end());
-    std::string type = std::string(typeWide.begin(), typeWide.end());
+Napi::Value AnalyzeFileWorker::Result(Napi::Env env)
+{
+    return ParsePageAnalysis(env, analysis);
+}
 
-    int jobId = 0;
+Napi::Value AnalyzeJob(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
 
-    PrinterManager *printerManager = new PrinterManager();
-    ErrorMessage *errorMessage = printerManager->printDirect(printerNameWide, docName, type, data, jobId);
-    if (errorMessage != NULL)
+    if (info.Length() < 1 || (!info[0].IsBuffer() && !info[0].IsString()))
     {
-        Napi::Error::New(env, (std::string)*errorMessage).ThrowAsJavaScriptException();
-        return env.Null();
+        throw Napi::TypeError::New(env, "First argument must be a string or Buffer");
     }
-    // std::wstring printerName = GetWStringFromNapiValue(info[1]);
-    // std::wstring docName = GetWStringFromNapiValue(info[2]);
-    // std::wstring type = GetWStringFromNapiValue(info[3]);
 
-    // PrinterHandle printerHandle((LPWSTR)printerName.c_str());
+    PrintData data;
+    data.Set(info[0]);
 
-    // if (!printerHandle)
-    // {
-    //     std::string error = "PrinterHandle error: " + GetLastErrorMessage();
-    //     throw Napi::Error::New(env, error);
-    // }
+    PageAnalyzer analyzer;
+    analyzer.feed(data.data());
+    return ParsePageAnalysis(env, analyzer.finish());
+}
 
-    // DOC_INFO_1W DocInfo;
-    // DocInfo.pDocName = (LPWSTR)docName.c_str();
-    // DocInfo.pOutputFile = NULL;
-    // DocInfo.pDatatype = (LPWSTR)type.c_str();
+Napi::Value AnalyzeFile(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
 
-    // DWORD jobId = StartDocPrinterW(*printerHandle, 1, (LPBYTE)&DocInfo);
-    // if (jobId == 0)
-    // {
-    //     std::string error = "StartDocPrinter error: " + GetLastErrorMessage();
-    //     throw Napi::Error::New(env, error);
-    // }
+    if (info.Length() < 1 || !info[0].IsString())
+    {
+        throw Napi::TypeError::New(env, "First argument must be a file path");
+    }
 
-    // if (!StartPagePrinter(*printerHandle))
-    // {
-    //     std::string error = "StartPagePrinter error: " + GetLastErrorMessage();
-    //     throw Napi::Error::New(env, error);
-    // }
+    PageAnalysis analysis;
+    ErrorMessage *errorMessage = analyzeFile(info[0].As<Napi::String>().Utf8Value(), analysis);
+    if (errorMessage != NULL)
+    {
+        throw Napi::Error::New(env, *errorMessage);
+    }
 
-    // DWORD bytesWritten = 0;
-    // BOOL success = WritePrinter(*printerHandle, (LPVOID)data.c_str(),
-    //                             (DWORD)data.size(), &bytesWritten);
+    return ParsePageAnalysis(env, analysis);
+}
 
-    // EndPagePrinter(*printerHandle);
-    // EndDocPrinter(*printerHandle);
+Napi::Value AnalyzeFileAsync(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
 
-    // if (!success || bytesWritten != data.size())
-    // {
-    //     throw Napi::Error::New(env, "Failed to write all data to printer");
-    // }
+    if (info.Length() < 1 || !info[0].IsString())
+    {
+        throw Napi::TypeError::New(env, "First argument must be a file path");
+    }
 
-    return Napi::Number::New(env, jobId);
+    AnalyzeFileWorker *worker = new AnalyzeFileWorker(env, info[0].As<Napi::String>().Utf8Value());
+    return worker->QueuePromise({}, info[1]);
 }
 
 Napi::Value GetSupportedJobCommands(const Napi::CallbackInfo &info)
@@ -364,7 +1280,7 @@ Napi::Value GetOneJob(const Napi::CallbackInfo &info)
         return env.Null();
     }
 
-    std::wstring printerNameWide = GetWStringFromNapiValue(info[0]);
+    Utf8Value printerName(info[0]);
 
     int jobId = info[1].As<Napi::Number>().Int32Value();
     if (jobId < 0)
@@ -373,11 +1289,11 @@ Napi::Value GetOneJob(const Napi::CallbackInfo &info)
         return env.Null();
     }
 
-    PrinterManager *printerManager = new PrinterManager();
+    PrinterManager &printerManager = PrinterManager::getInstance();
 
     JobInfo jobInfo;
 
-    ErrorMessage *errorMessage = printerManager->getOneJob((PrinterName)printerNameWide, jobId, jobInfo);
+    ErrorMessage *errorMessage = printerManager.getOneJob(printerName, jobId, jobInfo);
     if (errorMessage != NULL)
     {
         Napi::Error::New(env, (std::string)*errorMessage).ThrowAsJavaScriptException();
@@ -385,15 +1301,7 @@ Napi::Value GetOneJob(const Napi::CallbackInfo &info)
     }
 
     Napi::Object resultPrinterJob = Napi::Object::New(env);
-    resultPrinterJob.Set("id", Napi::Number::New(env, jobInfo.id));
-    resultPrinterJob.Set("name", StdStringToNapiString(env, jobInfo.name));
-    resultPrinterJob.Set("user", StdStringToNapiString(env, jobInfo.user));
-    resultPrinterJob.Set("priority", Napi::Number::New(env, jobInfo.priority));
-    resultPrinterJob.Set("size", Napi::Number::New(env, jobInfo.size));
-    resultPrinterJob.Set("status", StdStringToNapiString(env, jobInfo.status));
-    resultPrinterJob.Set("position", Napi::Number::New(env, jobInfo.position));
-    resultPrinterJob.Set("totalPages", Napi::Number::New(env, jobInfo.totalPages));
-    resultPrinterJob.Set("pagesPrinted", Napi::Number::New(env, jobInfo.pagesPrinted));
+    ParseJobObject(jobInfo, resultPrinterJob);
     return resultPrinterJob;
 
     // // Open a handle to the printer
@@ -431,6 +1339,120 @@ Napi::Value GetOneJob(const Napi::CallbackInfo &info)
     // return resultPrinterJob;
 }
 
+Napi::Value GetOneJobAsync(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2)
+    {
+        Napi::TypeError::New(env, "Expected two arguments").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (!info[0].IsString() || !info[1].IsNumber())
+    {
+        Napi::TypeError::New(env, "Expected a string and a number").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Utf8Value printerName(info[0]);
+
+    int jobId = info[1].As<Napi::Number>().Int32Value();
+    if (jobId < 0)
+    {
+        Napi::Error::New(env, "Wrong job number").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    GetOneJobWorker *worker = new GetOneJobWorker(env, printerName, jobId);
+    return worker->QueuePromise(std::string_view(), info[2]);
+}
+
+// Returns false when the ids argument is an empty array, there is nothing to ask the spooler then
+bool GetJobsArguments(const Napi::CallbackInfo &info, PrinterName &printerName, std::vector<int> &jobIds)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString())
+    {
+        throw Napi::TypeError::New(env, "Expected a string");
+    }
+
+    printerName = Utf8Value(info[0]).str();
+
+    if (info.Length() < 2 || info[1].IsUndefined())
+    {
+        return true;
+    }
+
+    if (!info[1].IsArray())
+    {
+        throw Napi::TypeError::New(env, "Job ids must be an array of numbers");
+    }
+
+    Napi::Array ids = info[1].As<Napi::Array>();
+    jobIds.reserve(ids.Length());
+    for (uint32_t i = 0; i < ids.Length(); i++)
+    {
+        Napi::Value id = ids[i];
+        if (!id.IsNumber() || id.As<Napi::Number>().Int32Value() <= 0)
+        {
+            throw Napi::Error::New(env, "Wrong job number");
+        }
+        jobIds.push_back(id.As<Napi::Number>().Int32Value());
+    }
+
+    return !jobIds.empty();
+}
+
+Napi::Value GetJobs(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    PrinterName printerName;
+    std::vector<int> jobIds;
+    bool query = GetJobsArguments(info, printerName, jobIds);
+    bool columnar = GetColumnarArgument(info[2]);
+
+    std::vector<JobInfo> jobsInfo;
+    if (query)
+    {
+        PrinterManager &printerManager = PrinterManager::getInstance();
+        ErrorMessage *errorMessage = printerManager.getJobs(printerName, jobIds, jobsInfo);
+        if (errorMessage != NULL)
+        {
+            Napi::Error::New(env, (std::string)*errorMessage).ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
+
+    if (columnar)
+    {
+        return JobsToColumns(env, jobsInfo);
+    }
+    return JobsToNapiArray(env, jobsInfo);
+}
+
+Napi::Value GetJobsAsync(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    PrinterName printerName;
+    std::vector<int> jobIds;
+    bool query = GetJobsArguments(info, printerName, jobIds);
+    bool columnar = GetColumnarArgument(info[2]);
+
+    if (!query)
+    {
+        std::vector<JobInfo> jobsInfo;
+        Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+        deferred.Resolve(columnar ? (Napi::Value)JobsToColumns(env, jobsInfo) : (Napi::Value)JobsToNapiArray(env, jobsInfo));
+        return deferred.Promise();
+    }
+
+    GetJobsWorker *worker = new GetJobsWorker(env, printerName, jobIds, columnar);
+    return worker->QueuePromise(std::string_view(), info[2]);
+}
+
 // Napi::Value SetOneJob(const Napi::CallbackInfo &info)
 // {
 //     Napi::Env env = info.Env();
@@ -447,7 +1469,7 @@ Napi::Value GetOneJob(const Napi::CallbackInfo &info)
 //         return env.Undefined();
 //     }
 
-//     std::wstring printerName = GetWStringFromNapiValue(info[0]);
+//     Utf8Value printerName(info[0]);
 //     int jobId = info[1].As<Napi::Number>().Int32Value();
 //     if (jobId < 0)
 //     {
@@ -483,9 +1505,9 @@ Napi::Value GetSupportedPrintFormats(const Napi::CallbackInfo &info)
 {
     Napi::Env env = info.Env();
 
-    PrinterManager *printerManager = new PrinterManager();
+    PrinterManager &printerManager = PrinterManager::getInstance();
     std::vector<std::string> dataTypes;
-    ErrorMessage *errorMessage = printerManager->getSupportedPrintFormats(dataTypes);
+    ErrorMessage *errorMessage = printerManager.getSupportedPrintFormats(dataTypes);
 
     if (errorMessage != NULL)
     {
@@ -493,13 +1515,13 @@ Napi::Value GetSupportedPrintFormats(const Napi::CallbackInfo &info)
         return env.Null();
     }
 
-    Napi::Array result = Napi::Array::New(env, dataTypes.size());
-    for (int i = 0; i < (int)dataTypes.size(); ++i)
-    {
-        result[i] = Napi::String::New(env, dataTypes[i].c_str());
-    }
+    return StringsToNapiArray(env, dataTypes);
+}
 
-    return result;
+Napi::Value GetSupportedPrintFormatsAsync(const Napi::CallbackInfo &info)
+{
+    GetSupportedPrintFormatsWorker *worker = new GetSupportedPrintFormatsWorker(info.Env());
+    return worker->QueuePromise();
 }
 
 Napi::Value GetPrinterDevMode(const Napi::CallbackInfo &info)
@@ -518,11 +1540,11 @@ Napi::Value GetPrinterDevMode(const Napi::CallbackInfo &info)
         return env.Undefined();
     }
 
-    std::wstring printerNameWide = GetWStringFromNapiValue(info[0]);
+    Utf8Value printerName(info[0]);
 
-    PrinterManager *printerManager = new PrinterManager();
+    PrinterManager &printerManager = PrinterManager::getInstance();
     PrinterDevMode printerDevMode;
-    ErrorMessage *errorMessage = printerManager->getPrinterDevMode(printerNameWide, printerDevMode);
+    ErrorMessage *errorMessage = printerManager.getPrinterDevMode(printerName, printerDevMode);
 
     if (errorMessage != NULL)
     {
@@ -531,20 +1553,244 @@ Napi::Value GetPrinterDevMode(const Napi::CallbackInfo &info)
     }
 
     Napi::Object result = Napi::Object::New(env);
-    result.Set("deviceName", StdStringToNapiString(env, printerDevMode.deviceName));
-    result.Set("paperSize", StdStringToNapiString(env, printerDevMode.paperSize));
-    result.Set("orientation", StdStringToNapiString(env, orientation_str.at(printerDevMode.orientation)));
-    result.Set("duplex", StdStringToNapiString(env, duplex_str.at(printerDevMode.duplex)));
-    result.Set("copies", Napi::Number::New(env, printerDevMode.copies));
-    result.Set("color", StdStringToNapiString(env, color_str.at(printerDevMode.color)));
-    result.Set("defaultSource", StdStringToNapiString(env, printerDevMode.defaultSource));
-    result.Set("printQuality", StdStringToNapiString(env, printQuality_str.at(printerDevMode.printQuality)));
-    result.Set("scale", Napi::Number::New(env, printerDevMode.scale));
-    result.Set("collate", Napi::Boolean::New(env, printerDevMode.collate));
+    ParseDevModeObject(printerDevMode, result);
+
+    return result;
+}
+
+Napi::Value GetPrinterDevModeAsync(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1)
+    {
+        Napi::TypeError::New(env, "Expected one arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!info[0].IsString())
+    {
+        Napi::TypeError::New(env, "Expected a string").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    Utf8Value printerName(info[0]);
+
+    GetPrinterDevModeWorker *worker = new GetPrinterDevModeWorker(env, printerName);
+    return worker->QueuePromise();
+}
+
+Napi::Object PrinterCacheOptionsToNapiObject(Napi::Env env)
+{
+    int ttl, checkInterval;
+    PrinterCache::getInstance().getOptions(ttl, checkInterval);
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("ttl", Napi::Number::New(env, ttl));
+    result.Set("checkInterval", Napi::Number::New(env, checkInterval));
+    return result;
+}
+
+Napi::Value SetPrinterCacheOptions(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsObject())
+    {
+        Napi::TypeError::New(env, "Options object expected")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Object options = info[0].As<Napi::Object>();
+    int ttl, checkInterval;
+    PrinterCache::getInstance().getOptions(ttl, checkInterval);
+
+    Napi::Value value = options.Get("ttl");
+    if (value.IsNumber())
+    {
+        ttl = value.As<Napi::Number>().Int32Value();
+    }
+    else if (!value.IsUndefined())
+    {
+        Napi::TypeError::New(env, "ttl must be a number of milliseconds")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    value = options.Get("checkInterval");
+    if (value.IsNumber())
+    {
+        checkInterval = value.As<Napi::Number>().Int32Value();
+    }
+    else if (!value.IsUndefined())
+    {
+        Napi::TypeError::New(env, "checkInterval must be a number of milliseconds")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    PrinterCache::getInstance().setOptions(ttl, checkInterval);
+
+    return PrinterCacheOptionsToNapiObject(env);
+}
+
+Napi::Value RefreshPrinterCache(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() > 0 && info[0].IsString())
+    {
+        PrinterCache::getInstance().invalidate(Utf8Value(info[0]).str());
+    }
+    else
+    {
+        PrinterCache::getInstance().invalidate();
+    }
+
+    return env.Undefined();
+}
+
+Napi::Value GetPrinterCacheStats(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    PrinterCacheStats stats = PrinterCache::getInstance().getStats();
+
+    Napi::Object result = PrinterCacheOptionsToNapiObject(env);
+    result.Set("hits", Napi::Number::New(env, (double)stats.hits));
+    result.Set("misses", Napi::Number::New(env, (double)stats.misses));
+    result.Set("revalidations", Napi::Number::New(env, (double)stats.revalidations));
+    result.Set("invalidations", Napi::Number::New(env, (double)stats.invalidations));
+    result.Set("entries", Napi::Number::New(env, (double)stats.entries));
+    return result;
+}
+
+Napi::Object WorkerPoolOptionsToNapiObject(Napi::Env env)
+{
+    WorkerPoolOptions options = WorkerPool::getInstance().getOptions();
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("size", Napi::Number::New(env, options.size));
+    result.Set("queueLength", Napi::Number::New(env, options.queueLength));
+    result.Set("perPrinter", Napi::Number::New(env, options.perPrinter));
+    result.Set("maxInFlight", Napi::Number::New(env, options.maxInFlight));
+    return result;
+}
+
+Napi::Value SetWorkerPoolOptions(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsObject())
+    {
+        Napi::TypeError::New(env, "Options object expected")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Object options = info[0].As<Napi::Object>();
+    WorkerPoolOptions poolOptions = WorkerPool::getInstance().getOptions();
+
+    GetIntOption(options, "size", "size must be a number of threads", poolOptions.size);
+    GetIntOption(options, "queueLength", "queueLength must be a number of tasks", poolOptions.queueLength);
+    GetIntOption(options, "perPrinter", "perPrinter must be a number of tasks", poolOptions.perPrinter);
+    GetIntOption(options, "maxInFlight", "maxInFlight must be a number of tasks", poolOptions.maxInFlight);
+
+    WorkerPool::getInstance().setOptions(poolOptions);
+
+    return WorkerPoolOptionsToNapiObject(env);
+}
+
+Napi::Value GetWorkerPoolStats(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    WorkerPoolStats stats = WorkerPool::getInstance().getStats();
+
+    Napi::Object result = WorkerPoolOptionsToNapiObject(env);
+    result.Set("threads", Napi::Number::New(env, stats.threads));
+    result.Set("busy", Napi::Number::New(env, stats.busy));
+    result.Set("inFlight", Napi::Number::New(env, stats.inFlight));
+    result.Set("queued", Napi::Number::New(env, (double)stats.queued));
+    result.Set("serialized", Napi::Number::New(env, (double)stats.serialized));
+    result.Set("maxQueued", Napi::Number::New(env, (double)stats.maxQueued));
+    result.Set("completed", Napi::Number::New(env, (double)stats.completed));
+    result.Set("rejected", Napi::Number::New(env, (double)stats.rejected));
+
+    Napi::Object lanes = Napi::Object::New(env);
+    for (int lane = 0; lane < PRIORITY_LANES; lane++)
+    {
+        const WorkerLaneStats &laneStats = stats.lanes[lane];
+        Napi::Object laneObject = Napi::Object::New(env);
+        laneObject.Set("queued", Napi::Number::New(env, (double)laneStats.queued));
+        laneObject.Set("maxQueued", Napi::Number::New(env, (double)laneStats.maxQueued));
+        laneObject.Set("started", Napi::Number::New(env, (double)laneStats.started));
+        laneObject.Set("averageWaitMs", Napi::Number::New(env, laneStats.started > 0 ? laneStats.totalWaitMs / laneStats.started : 0));
+        laneObject.Set("maxWaitMs", Napi::Number::New(env, laneStats.maxWaitMs));
+        lanes.Set(PriorityName((WorkerPriority)lane), laneObject);
+    }
+    result.Set("lanes", lanes);
+    return result;
+}
+
+Napi::Object JobCoalescingOptionsToNapiObject(Napi::Env env)
+{
+    int windowMs;
+    size_t maxBytes;
+    JobCoalescer::getInstance().getOptions(windowMs, maxBytes);
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("windowMs", Napi::Number::New(env, windowMs));
+    result.Set("maxBytes", Napi::Number::New(env, (double)maxBytes));
+    return result;
+}
+
+Napi::Value SetJobCoalescingOptions(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsObject())
+    {
+        Napi::TypeError::New(env, "Options object expected")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Object options = info[0].As<Napi::Object>();
+    int windowMs;
+    size_t maxBytes;
+    JobCoalescer::getInstance().getOptions(windowMs, maxBytes);
+
+    int maxBytesOption = (int)maxBytes;
+    GetIntOption(options, "windowMs", "windowMs must be a number of milliseconds", windowMs);
+    GetIntOption(options, "maxBytes", "maxBytes must be a number of bytes", maxBytesOption);
+
+    JobCoalescer::getInstance().setOptions(windowMs, maxBytesOption > 0 ? (size_t)maxBytesOption : 0);
+
+    return JobCoalescingOptionsToNapiObject(env);
+}
+
+Napi::Value GetJobCoalescingStats(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
 
+    JobCoalescerStats stats = JobCoalescer::getInstance().getStats();
+
+    Napi::Object result = JobCoalescingOptionsToNapiObject(env);
+    result.Set("coalesced", Napi::Number::New(env, (double)stats.coalesced));
+    result.Set("flushed", Napi::Number::New(env, (double)stats.flushed));
+    result.Set("capped", Napi::Number::New(env, (double)stats.capped));
+    result.Set("dropped", Napi::Number::New(env, (double)stats.dropped));
+    result.Set("pending", Napi::Number::New(env, (double)stats.pending));
     return result;
 }
 
+Napi::Value FlushCoalescedJobs(const Napi::CallbackInfo &info)
+{
+    JobCoalescer::getInstance().flush();
+    return info.Env().Undefined();
+}
+
 Napi::Object Init(Napi::Env env, Napi::Object exports)
 {
     // Set methods
@@ -554,12 +1800,46 @@ Napi::Object Init(Napi::Env env, Napi::Object exports)
     exports.Set("getPrinter", Napi::Function::New(env, GetOnePrinter));
     //  exports.Set("getPrinterDriverOptions", Napi::Function::New(env, GetPrinterDriverOptions));
     exports.Set("getJob", Napi::Function::New(env, GetOneJob));
+    exports.Set("getJobs", Napi::Function::New(env, GetJobs));
     // exports.Set("setJob", Napi::Function::New(env, SetOneJob));
     exports.Set("printDirect", Napi::Function::New(env, PrintDirect));
-    // exports.Set("printFile", Napi::Function::New(env, PrintFile));
+    exports.Set("printFile", Napi::Function::New(env, PrintFile));
+    exports.Set("printBatch", Napi::Function::New(env, PrintBatch));
+    exports.Set("printRaster", Napi::Function::New(env, PrintRaster));
+    exports.Set("halftone", Napi::Function::New(env, Halftone));
     exports.Set("getPrinterDevMode", Napi::Function::New(env, GetPrinterDevMode));
     exports.Set("getSupportedPrintFormats", Napi::Function::New(env, GetSupportedPrintFormats));
     exports.Set("getSupportedJobCommands", Napi::Function::New(env, GetSupportedJobCommands));
+    exports.Set("detectDocumentFormat", Napi::Function::New(env, DetectDocumentFormat));
+    exports.Set("analyzeJob", Napi::Function::New(env, AnalyzeJob));
+    exports.Set("analyzeFile", Napi::Function::New(env, AnalyzeFile));
+
+    exports.Set("getPrintersAsync", Napi::Function::New(env, GetPrintersAsync));
+    exports.Set("getDefaultPrinterNameAsync", Napi::Function::New(env, GetDefaultPrinterNameAsync));
+    exports.Set("getPrinterAsync", Napi::Function::New(env, GetOnePrinterAsync));
+    exports.Set("getJobAsync", Napi::Function::New(env, GetOneJobAsync));
+    exports.Set("getJobsAsync", Napi::Function::New(env, GetJobsAsync));
+    exports.Set("printDirectAsync", Napi::Function::New(env, PrintDirectAsync));
+    exports.Set("printFileAsync", Napi::Function::New(env, PrintFileAsync));
+    exports.Set("printBatchAsync", Napi::Function::New(env, PrintBatchAsync));
+    exports.Set("printRasterAsync", Napi::Function::New(env, PrintRasterAsync));
+    exports.Set("halftoneAsync", Napi::Function::New(env, HalftoneAsync));
+    exports.Set("analyzeFileAsync", Napi::Function::New(env, AnalyzeFileAsync));
+    exports.Set("getPrinterDevModeAsync", Napi::Function::New(env, GetPrinterDevModeAsync));
+    exports.Set("getSupportedPrintFormatsAsync", Napi::Function::New(env, GetSupportedPrintFormatsAsync));
+
+    exports.Set("setPrinterCacheOptions", Napi::Function::New(env, SetPrinterCacheOptions));
+    exports.Set("refreshPrinterCache", Napi::Function::New(env, RefreshPrinterCache));
+    exports.Set("getPrinterCacheStats", Napi::Function::New(env, GetPrinterCacheStats));
+    exports.Set("setWorkerPoolOptions", Napi::Function::New(env, SetWorkerPoolOptions));
+    exports.Set("getWorkerPoolStats", Napi::Function::New(env, GetWorkerPoolStats));
+    exports.Set("setJobCoalescingOptions", Napi::Function::New(env, SetJobCoalescingOptions));
+    exports.Set("getJobCoalescingStats", Napi::Function::New(env, GetJobCoalescingStats));
+    exports.Set("flushCoalescedJobs", Napi::Function::New(env, FlushCoalescedJobs));
+
+    exports.Set("PrintJob", PrintJobWrap::Init(env));
+    exports.Set("Printer", PrinterWrap::Init(env));
+    exports.Set("PrinterWatch", PrinterWatchWrap::Init(env));
 
     return exports;
 }
@@ -7,30 +7,110 @@
 /**
  * Send data to printer
  *
- * @param data String/NativeBuffer, mandatory, raw data bytes
+ * @param data String/NativeBuffer, mandatory, raw data bytes.
+ *        Buffers are handed to the spooler in place, without copying, so they
+ *        must not be modified until the call (or the promise of printDirectAsync) completes.
  * @param printername String, mandatory, specifying printer name
  * @param docname String, mandatory, specifying document name
  * @param type String, mandatory, specifying data type. E.G.: RAW, TEXT, ...
+ * @param options Object, optional. { ticket: { copies, duplex, orientation, color, printQuality, tray, jobName } }
+ *        frames RAW data with a PJL job ticket, written apart from the data so it is never copied
  *
  * @returns true for success, false for failure.
  */
 // Napi::Value PrintDirect(const Napi::CallbackInfo& info);
 
 /**
- * Send file to printer
+ * Send file to printer.
+ * The file is read from disk by the native layer in fixed size chunks
+ * and streamed to the spooler, it never passes through the V8 heap.
  *
  * @param filename String, mandatory, specifying filename to print
- * @param docname String, mandatory, specifying document name
  * @param printer String, mandatory, specifying printer name
+ * @param docname String, optional, specifying document name, defaults to filename
+ * @param type String, optional, specifying data type, defaults to RAW
  *
  * @returns jobId for success, or error message for failure.
  */
-// Napi::Value PrintFile(const Napi::CallbackInfo& info);
+Napi::Value PrintFile(const Napi::CallbackInfo &info);
+
+/**
+ * Classify a print payload from its first bytes, as type "AUTO" does
+ *
+ * @param data String/NativeBuffer, mandatory
+ *
+ * @returns one of UNKNOWN, PJL, PCL, PCLXL, POSTSCRIPT, PDF, ZPL, ESCPOS, PWG, URF
+ */
+Napi::Value DetectDocumentFormat(const Napi::CallbackInfo &info);
+
+/**
+ * Count the pages of a PJL wrapped PCL5 or PCL XL job before it is submitted,
+ * and pick up the copies and duplex it asks for
+ *
+ * @param data String/NativeBuffer, mandatory
+ *
+ * @returns { language: String, as detectDocumentFormat, pages: Number, copies: Number,
+ *          duplex: Boolean, pageEnds: Float64Array, offset past each page, bytes: Number }
+ */
+Napi::Value AnalyzeJob(const Napi::CallbackInfo &info);
+
+/**
+ * Same as analyzeJob for a file, read by the native layer in 1MB chunks
+ *
+ * @param path String, mandatory
+ */
+Napi::Value AnalyzeFile(const Napi::CallbackInfo &info);
+
+/**
+ * Send many documents to a printer as a single spooler job.
+ * CUPS gets one Create-Job and a Send-Document per document; on Windows every
+ * document is a page of the job and all of them must share one type.
+ *
+ * @param printer String, mandatory, specifying printer name
+ * @param documents Array, mandatory, of String/NativeBuffer or { data, docname, type } objects
+ * @param options Object, optional. { jobName: String, type: String, the type of documents without one, defaults to RAW }
+ *
+ * @returns the jobId of the whole batch, or error message for failure.
+ */
+Napi::Value PrintBatch(const Napi::CallbackInfo &info);
+
+/**
+ * Print pixel pages rendered by the caller, encoded natively as PWG raster or
+ * URF and sent as image/pwg-raster or image/urf, which IPP Everywhere and
+ * AirPrint queues take without a filter. Pages are encoded on as many threads
+ * as there are cores. On Windows the stream goes out RAW.
+ *
+ * @param printer String, mandatory, specifying printer name
+ * @param pages Array, mandatory, of { data: Buffer/TypedArray, width, height,
+ *        format: 'gray' | 'rgb' | 'rgba' (default), stride: bytes per row, defaults to packed rows }
+ * @param options Object, optional. { resolution: dpi, defaults to 300, colorSpace: 'sgray' | 'srgb' (default),
+ *        format: 'pwg' (default) | 'urf', jobName: String }
+ *
+ * @returns the jobId, or error message for failure.
+ */
+Napi::Value PrintRaster(const Napi::CallbackInfo &info);
+
+/**
+ * Halftone an image to 1 bit per pixel for thermal, label and receipt
+ * printers, and wrap it as a ZPL ^GF label or ESC/POS GS v 0 commands to
+ * send with printDirect type RAW. Threshold and ordered dithering run with
+ * SSE2 where available; Floyd-Steinberg is serial within an image.
+ *
+ * @param image Object, mandatory, { data, width, height, format, stride } as a printRaster page
+ * @param options Object, optional. { method: 'threshold' | 'ordered' (default) | 'floyd-steinberg',
+ *        threshold: gray level 0-255 under which a pixel is black, defaults to 128,
+ *        output: 'bitmap' (default, packed rows, MSB first, 1 = black) | 'zpl' | 'escpos' }
+ *
+ * @returns Buffer, or error message for failure.
+ */
+Napi::Value Halftone(const Napi::CallbackInfo &info);
 
 /** Retrieve all printers and jobs
  * posix: minimum version: CUPS 1.1.21/OS X 10.4
+ * @param options Object, optional. { fields: Array of property names } returns only those properties,
+ *        { columnar: true } returns typed array columns instead of one object per printer (see node_columnar.hpp)
  */
-Napi::Array GetPrinters(const Napi::CallbackInfo &info);
+Napi::Value GetPrinters(const Napi::CallbackInfo &info);
 
 /**
  * Return default printer name, if null then default printer is not set
@@ -39,6 +119,7 @@ Napi::String GetDefaultPrinterName(const Napi::CallbackInfo &info);
 
 /** Retrieve printer info and jobs
  * @param printer name String
+ * @param options Object, optional. { fields: Array of property names } as for getPrinters
  */
 Napi::Value GetOnePrinter(const Napi::CallbackInfo &info);
 
@@ -53,6 +134,14 @@ Napi::Value GetOnePrinter(const Napi::CallbackInfo &info);
  */
 Napi::Value GetOneJob(const Napi::CallbackInfo &info);
 
+/** Retrieve many jobs of a printer in one spooler request
+ *  @param printer name String
+ *  @param job ids Array of Number, optional. Every job the spooler keeps when omitted
+ *  @param options Object, optional. { columnar: true } as for getPrinters
+ *  @return Array of job info in the order of the ids, unknown ids are left out
+ */
+Napi::Value GetJobs(const Napi::CallbackInfo &info);
+
 /** Set job command.
  * arguments:
  * @param printer name String
@@ -79,4 +168,71 @@ Napi::Value SetOneJob(const Napi::CallbackInfo &info);
  */
 Napi::Value GetSupportedJobCommands(const Napi::CallbackInfo &info);
 
+/** Configure the cache behind getPrinters/getPrinter
+ * @param options Object { ttl: Number ms (0 disables the cache), checkInterval: Number ms }
+ * @return the options now in effect
+ */
+Napi::Value SetPrinterCacheOptions(const Napi::CallbackInfo &info);
+
+/** Drop cached printers so the next call asks the spooler
+ * @param printer name String, optional. All printers when omitted
+ */
+Napi::Value RefreshPrinterCache(const Napi::CallbackInfo &info);
+
+/** Get cache options and hit/miss/revalidation/invalidation counters
+ */
+Napi::Value GetPrinterCacheStats(const Napi::CallbackInfo &info);
+
+/** Configure the threads running the *Async exports
+ * @param options Object { size: Number of threads, queueLength: Number of waiting calls (0 for no limit),
+ *                perPrinter: Number of calls running at once per printer,
+ *                maxInFlight: Number of printer calls running at once (0 for no limit) }
+ * @return the options now in effect
+ */
+Napi::Value SetWorkerPoolOptions(const Napi::CallbackInfo &info);
+
+/** Get pool options with threads, busy, inFlight, queued, serialized, maxQueued, completed and
+ * rejected counts, and per priority lane queue depth and wait times
+ */
+Napi::Value GetWorkerPoolStats(const Napi::CallbackInfo &info);
+
+/** Configure coalescing of small RAW printDirectAsync jobs per printer and type
+ * @param options Object { windowMs: Number, how long a job waits for others (0 disables),
+ *                maxBytes: Number, size of a combined job that is sent without waiting (0 disables) }
+ * @return the options now in effect
+ */
+Napi::Value SetJobCoalescingOptions(const Napi::CallbackInfo &info);
+
+/** Get coalescing options with coalesced, flushed, capped, dropped and pending counts
+ */
+Napi::Value GetJobCoalescingStats(const Napi::CallbackInfo &info);
+
+/** Send every waiting coalesced job now
+ */
+Napi::Value FlushCoalescedJobs(const Napi::CallbackInfo &info);
+
+/**
+ * Promise based variants of the exports above.
+ * They take the same arguments, run the PrinterManager call on a worker
+ * thread and resolve with the same value the synchronous version returns.
+ * Errors reported by the spooler reject the promise.
+ * An options object { timeout: milliseconds, signal: AbortSignal } bounds the
+ * call: the fields/columnar options object where there is one, otherwise an
+ * extra last argument (printDirectAsync, printFileAsync, getJobAsync).
+ * Its priority: 'high' | 'normal' | 'low' picks the worker pool lane.
+ */
+Napi::Value GetPrintersAsync(const Napi::CallbackInfo &info);
+Napi::Value GetDefaultPrinterNameAsync(const Napi::CallbackInfo &info);
+Napi::Value GetOnePrinterAsync(const Napi::CallbackInfo &info);
+Napi::Value GetOneJobAsync(const Napi::CallbackInfo &info);
+Napi::Value GetJobsAsync(const Napi::CallbackInfo &info);
+Napi::Value PrintDirectAsync(const Napi::CallbackInfo &info);
+Napi::Value PrintFileAsync(const Napi::CallbackInfo &info);
+Napi::Value PrintBatchAsync(const Napi::CallbackInfo &info);
+Napi::Value PrintRasterAsync(const Napi::CallbackInfo &info);
+Napi::Value HalftoneAsync(const Napi::CallbackInfo &info);
+Napi::Value AnalyzeFileAsync(const Napi::CallbackInfo &info);
+Napi::Value GetPrinterDevModeAsync(const Napi::CallbackInfo &info);
+Napi::Value GetSupportedPrintFormatsAsync(const Napi::CallbackInfo &info);
+
 #endif
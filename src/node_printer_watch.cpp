@@ -0,0 +1,264 @@
+#include "node_printer_watch.hpp"
+
+#include "PrinterCache.hpp"
+#include "node_worker.hpp"
+
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace
+{
+    // One waitWatch result on its way to the JS thread
+    struct WatchPayload
+    {
+        std::vector<PrinterEvent> events;
+        std::string error;
+    };
+
+    Napi::Object EventToNapiObject(Napi::Env env, PrinterEvent &event)
+    {
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("event", Napi::String::New(env, event.event));
+        result.Set("printer", Napi::String::New(env, event.printer));
+
+        if (event.job.id != 0)
+        {
+            Napi::Object job = Napi::Object::New(env);
+            ParseJobObject(event.job, job);
+            result.Set("job", job);
+        }
+        else
+        {
+            Napi::Array status = Napi::Array::New(env, event.statusArray.size());
+            for (size_t i = 0; i < event.statusArray.size(); i++)
+            {
+                status.Set(i, Napi::String::New(env, event.statusArray[i]));
+            }
+            result.Set("state", Napi::String::New(env, event.state));
+            result.Set("status", status);
+        }
+
+        return result;
+    }
+
+    void CallJs(Napi::Env env, Napi::Function callback, WatchPayload *payload)
+    {
+        if (env != nullptr && callback != nullptr)
+        {
+            if (!payload->error.empty())
+            {
+                callback.Call({Napi::Error::New(env, payload->error).Value(), env.Null()});
+            }
+            else
+            {
+                Napi::Array events = Napi::Array::New(env, payload->events.size());
+                for (size_t i = 0; i < payload->events.size(); i++)
+                {
+                    events.Set(i, EventToNapiObject(env, payload->events[i]));
+                }
+                callback.Call({env.Null(), events});
+            }
+        }
+
+        delete payload;
+    }
+
+    // Cached PrinterInfo is stale as soon as the spooler reports a printer change
+    void InvalidateCache(const std::vector<PrinterEvent> &events)
+    {
+        PrinterCache &printerCache = PrinterCache::getInstance();
+
+        for (const PrinterEvent &event : events)
+        {
+            if (event.event == "printer-added" || event.event == "printer-deleted")
+            {
+                printerCache.invalidate();
+            }
+            else if (event.job.id == 0)
+            {
+                printerCache.invalidate(event.printer);
+            }
+        }
+    }
+}
+
+Napi::Function PrinterWatchWrap::Init(Napi::Env env)
+{
+    return DefineClass(env, "PrinterWatch",
+                       {
+                           InstanceMethod("close", &PrinterWatchWrap::Close),
+                           InstanceMethod("ref", &PrinterWatchWrap::Ref),
+                           InstanceMethod("unref", &PrinterWatchWrap::Unref),
+                       });
+}
+
+PrinterWatchWrap::PrinterWatchWrap(const Napi::CallbackInfo &info) : Napi::ObjectWrap<PrinterWatchWrap>(info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[1].IsFunction())
+    {
+        throw Napi::TypeError::New(env, "Expected printer name and callback");
+    }
+
+    PrinterName printerName;
+    if (info[0].IsString())
+    {
+        printerName = Utf8Value(info[0]).str();
+    }
+    else if (!info[0].IsUndefined() && !info[0].IsNull())
+    {
+        throw Napi::TypeError::New(env, "String expected");
+    }
+
+    State *state = new State();
+    state->printer = printerName;
+    state->callback = Napi::ThreadSafeFunction::New(env, info[1].As<Napi::Function>(), "nodeprinting", 0, 1);
+    try
+    {
+        state->thread = std::thread(&PrinterWatchWrap::Run, state);
+    }
+    catch (const std::system_error &)
+    {
+        state->callback.Release();
+        Finish(state);
+        throw Napi::Error::New(env, "Could not start the watch thread");
+    }
+    this->state = state;
+}
+
+PrinterWatchWrap::~PrinterWatchWrap()
+{
+    Stop();
+}
+
+// Watch thread: subscribes, then forwards every batch of events until interrupted or the subscription fails
+void PrinterWatchWrap::Run(State *state)
+{
+    PrinterManager &printerManager = PrinterManager::getInstance();
+    PrinterWatch &watch = state->watch;
+
+    // Stop releases the callback under the lock, it is never called after that
+    auto deliver = [state](WatchPayload *payload)
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (state->watch.interrupted || state->callback.BlockingCall(payload, CallJs) != napi_ok)
+        {
+            delete payload;
+            return false;
+        }
+        return true;
+    };
+
+    // Subscribing waits on the spooler, which the JS thread must not
+    ErrorMessage *errorMessage = watch.interrupted ? NULL : printerManager.openWatch(state->printer, watch);
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->opened = true;
+    }
+    if (errorMessage != NULL)
+    {
+        WatchPayload *payload = new WatchPayload();
+        payload->error = *errorMessage;
+        deliver(payload);
+        return;
+    }
+
+    while (!watch.interrupted)
+    {
+        WatchPayload *payload = new WatchPayload();
+
+        errorMessage = printerManager.waitWatch(watch, payload->events);
+        if (watch.interrupted)
+        {
+            delete payload;
+            break;
+        }
+
+        if (errorMessage != NULL)
+        {
+            payload->error = *errorMessage;
+        }
+        else
+        {
+            InvalidateCache(payload->events);
+        }
+
+        if (!deliver(payload) || errorMessage != NULL)
+        {
+            break;
+        }
+    }
+}
+
+// Joins the watch thread and cancels the subscription, may wait on the spooler
+void PrinterWatchWrap::Finish(State *state)
+{
+    if (state->thread.joinable())
+    {
+        state->thread.join();
+    }
+    PrinterManager::getInstance().closeWatch(state->watch);
+    delete state;
+}
+
+void PrinterWatchWrap::Stop()
+{
+    if (state == NULL)
+    {
+        return;
+    }
+
+    State *state = this->state;
+    this->state = NULL;
+
+    // No more callbacks are queued once close() returns, even if the thread takes a while to notice.
+    // Until openWatch has returned only the flag is set, which also makes it give up
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->watch.interrupted = true;
+        if (state->opened)
+        {
+            PrinterManager::getInstance().interruptWatch(state->watch);
+        }
+        state->callback.Release();
+    }
+
+    try
+    {
+        std::thread(&PrinterWatchWrap::Finish, state).detach();
+    }
+    catch (const std::system_error &)
+    {
+        // Out of threads, wait here rather than leak the subscription
+        Finish(state);
+    }
+}
+
+Napi::Value PrinterWatchWrap::Close(const Napi::CallbackInfo &info)
+{
+    Stop();
+    return info.Env().Undefined();
+}
+
+Napi::Value PrinterWatchWrap::Ref(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (state != NULL)
+    {
+        state->callback.Ref(env);
+    }
+    return env.Undefined();
+}
+
+Napi::Value PrinterWatchWrap::Unref(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    if (state != NULL)
+    {
+        state->callback.Unref(env);
+    }
+    return env.Undefined();
+}
@@ -0,0 +1,61 @@
+#ifndef NODE_PRINTER_WATCH_HPP
+#define NODE_PRINTER_WATCH_HPP
+
+#include "PrinterManager.hpp"
+
+#include <napi.h>
+
+#include <mutex>
+#include <thread>
+
+/**
+ * Native side of watch(printer): one spooler subscription drained by a
+ * thread of its own, which hands every batch of changes to the JS thread
+ * through a thread safe function instead of having JS poll getJob.
+ *
+ * new PrinterWatch(printer, callback) printer String, all printers when empty.
+ *     The subscription is made on the watch thread, a failure is the first
+ *     callback
+ * callback(error, events) events is an Array of
+ *     { event, printer, job } for job changes, job has the getJob shape
+ *     { event, printer, state, status } for printer changes
+ * close() cancels the subscription, no callback follows an error. It only
+ *     interrupts the watch thread, the thread is joined and the subscription
+ *     cancelled on a thread of their own so the JS thread never waits on cupsd
+ * ref() / unref() whether the open watch keeps the event loop alive
+ */
+class PrinterWatchWrap : public Napi::ObjectWrap<PrinterWatchWrap>
+{
+public:
+    static Napi::Function Init(Napi::Env env);
+
+    PrinterWatchWrap(const Napi::CallbackInfo &info);
+    ~PrinterWatchWrap();
+
+private:
+    // Everything the watch thread uses, handed over to the closing thread by Stop
+    // so it can outlive the JS object
+    struct State
+    {
+        PrinterName printer;
+        PrinterWatch watch;
+        Napi::ThreadSafeFunction callback;
+        std::thread thread;
+        // Held around every call of callback and its release, and guards opened
+        std::mutex mutex;
+        // Whether openWatch has returned, watch.handle is not touched by Stop before that
+        bool opened = false;
+    };
+
+    static void Run(State *state);
+    static void Finish(State *state);
+    void Stop();
+
+    Napi::Value Close(const Napi::CallbackInfo &info);
+    Napi::Value Ref(const Napi::CallbackInfo &info);
+    Napi::Value Unref(const Napi::CallbackInfo &info);
+
+    State *state = NULL;
+};
+
+#endif
@@ -0,0 +1,340 @@
+#include "node_printer_wrap.hpp"
+
+#include "node_worker.hpp"
+
+#include <string>
+
+namespace
+{
+    /**
+     * Base of the asynchronous Printer methods. Keeps the JS object alive and
+     * counts as pending while the operation runs, so close() can not pull the
+     * handle away from under it. They are queued under the printer name, so
+     * calls on one handle wait in the pool instead of on its lock.
+     */
+    class PrinterWrapWorker : public PrinterWorker
+    {
+    public:
+        PrinterWrapWorker(Napi::Env env, PrinterWrap *wrap)
+            : PrinterWorker(env), wrap(wrap), wrapRef(Napi::Persistent(wrap->Value()))
+        {
+            wrap->pending++;
+        }
+
+    protected:
+        void OnOK() override
+        {
+            wrap->pending--;
+            PrinterWorker::OnOK();
+        }
+
+        void OnError(const Napi::Error &error) override
+        {
+            wrap->pending--;
+            PrinterWorker::OnError(error);
+        }
+
+        PrinterWrap *wrap;
+
+    private:
+        Napi::ObjectReference wrapRef;
+    };
+
+    class PrintWorker : public PrinterWrapWorker
+    {
+    public:
+        PrintWorker(Napi::Env env, PrinterWrap *wrap, const Napi::Value &data,
+                    const std::string &docName, const std::string &type)
+            : PrinterWrapWorker(env, wrap), docName(docName), type(type)
+        {
+            this->data.Set(data);
+        }
+
+    protected:
+        ErrorMessage *Run(PrinterManager &printerManager) override
+        {
+            return printerManager.printDirect(wrap->printer, docName, type, data.data(), jobId, &context);
+        }
+
+        Napi::Value Result(Napi::Env env) override
+        {
+            return Napi::Number::New(env, jobId);
+        }
+
+    private:
+        PrintData data;
+        std::string docName;
+        std::string type;
+        int jobId = 0;
+    };
+
+    class GetJobWorker : public PrinterWrapWorker
+    {
+    public:
+        GetJobWorker(Napi::Env env, PrinterWrap *wrap, int jobId)
+            : PrinterWrapWorker(env, wrap), jobId(jobId) {}
+
+    protected:
+        ErrorMessage *Run(PrinterManager &printerManager) override
+        {
+            return printerManager.getOneJob(wrap->printer, jobId, jobInfo, &context);
+        }
+
+        Napi::Value Result(Napi::Env env) override
+        {
+            Napi::Object resultPrinterJob = Napi::Object::New(env);
+            ParseJobObject(jobInfo, resultPrinterJob);
+            return resultPrinterJob;
+        }
+
+    private:
+        int jobId;
+        JobInfo jobInfo;
+    };
+
+    class RefreshWorker : public PrinterWrapWorker
+    {
+    public:
+        RefreshWorker(Napi::Env env, PrinterWrap *wrap) : PrinterWrapWorker(env, wrap)
+        {
+            wrap->refreshing = true;
+        }
+
+    protected:
+        ErrorMessage *Run(PrinterManager &printerManager) override
+        {
+            return printerManager.refreshPrinter(wrap->printer, &context);
+        }
+
+        void OnOK() override
+        {
+            wrap->refreshing = false;
+            PrinterWrapWorker::OnOK();
+        }
+
+        void OnError(const Napi::Error &error) override
+        {
+            wrap->refreshing = false;
+            PrinterWrapWorker::OnError(error);
+        }
+
+        Napi::Value Result(Napi::Env env) override
+        {
+            Napi::Object resultPrinter = Napi::Object::New(env);
+            ParsePrinterObject(wrap->printer.info, resultPrinter);
+            return resultPrinter;
+        }
+    };
+
+    // Reads the (data, docname, type) arguments of print/printAsync
+    void GetPrintArguments(const Napi::CallbackInfo &info, std::string &docName, std::string &type)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 3)
+        {
+            throw Napi::Error::New(env, "Wrong number of arguments");
+        }
+
+        if (!info[0].IsBuffer() && !info[0].IsString())
+        {
+            throw Napi::Error::New(env, "First argument must be a string or Buffer");
+        }
+
+        docName = Utf8Value(info[1]).str();
+        type = Utf8Value(info[2]).str();
+    }
+
+    int GetJobIdArgument(const Napi::CallbackInfo &info)
+    {
+        Napi::Env env = info.Env();
+
+        if (info.Length() < 1 || !info[0].IsNumber())
+        {
+            throw Napi::TypeError::New(env, "Expected a number");
+        }
+
+        int jobId = info[0].As<Napi::Number>().Int32Value();
+        if (jobId < 0)
+        {
+            throw Napi::Error::New(env, "Wrong job number");
+        }
+
+        return jobId;
+    }
+}
+
+Napi::Function PrinterWrap::Init(Napi::Env env)
+{
+    return DefineClass(env, "Printer",
+                       {
+                           InstanceAccessor("name", &PrinterWrap::GetName, nullptr),
+                           InstanceMethod("info", &PrinterWrap::Info),
+                           InstanceMethod("refresh", &PrinterWrap::Refresh),
+                           InstanceMethod("refreshAsync", &PrinterWrap::RefreshAsync),
+                           InstanceMethod("print", &PrinterWrap::Print),
+                           InstanceMethod("printAsync", &PrinterWrap::PrintAsync),
+                           InstanceMethod("getJob", &PrinterWrap::GetJob),
+                           InstanceMethod("getJobAsync", &PrinterWrap::GetJobAsync),
+                           InstanceMethod("close", &PrinterWrap::Close),
+                       });
+}
+
+PrinterWrap::PrinterWrap(const Napi::CallbackInfo &info) : Napi::ObjectWrap<PrinterWrap>(info)
+{
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsString())
+    {
+        throw Napi::TypeError::New(env, "String expected");
+    }
+
+    ErrorMessage *errorMessage = PrinterManager::getInstance().openPrinter(Utf8Value(info[0]), printer);
+    if (errorMessage != NULL)
+    {
+        throw Napi::Error::New(env, *errorMessage);
+    }
+}
+
+PrinterWrap::~PrinterWrap()
+{
+    PrinterManager::getInstance().closePrinter(printer);
+}
+
+void PrinterWrap::CheckOpen(Napi::Env env)
+{
+    if (printer.handle == NULL)
+    {
+        throw Napi::Error::New(env, "Printer is closed");
+    }
+}
+
+Napi::Value PrinterWrap::GetName(const Napi::CallbackInfo &info)
+{
+    return Napi::String::New(info.Env(), printer.name);
+}
+
+Napi::Value PrinterWrap::Info(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    CheckOpen(env);
+
+    // refreshAsync rewrites the info on a pool thread
+    if (refreshing)
+    {
+        throw Napi::Error::New(env, "Printer is busy, wait for refreshAsync to complete");
+    }
+
+    Napi::Object resultPrinter = Napi::Object::New(env);
+    ParsePrinterObject(printer.info, resultPrinter);
+
+    return resultPrinter;
+}
+
+Napi::Value PrinterWrap::Refresh(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    CheckOpen(env);
+
+    if (pending > 0)
+    {
+        throw Napi::Error::New(env, "Printer is busy, wait for pending calls to complete");
+    }
+
+    ErrorMessage *errorMessage = PrinterManager::getInstance().refreshPrinter(printer);
+    if (errorMessage != NULL)
+    {
+        throw Napi::Error::New(env, *errorMessage);
+    }
+
+    return Info(info);
+}
+
+Napi::Value PrinterWrap::RefreshAsync(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    CheckOpen(env);
+
+    if (pending > 0)
+    {
+        throw Napi::Error::New(env, "Printer is busy, wait for pending calls to complete");
+    }
+
+    RefreshWorker *worker = new RefreshWorker(env, this);
+    return worker->QueuePromise(printer.name, info[0]);
+}
+
+Napi::Value PrinterWrap::Print(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    CheckOpen(env);
+
+    std::string docName, type;
+    GetPrintArguments(info, docName, type);
+
+    PrintData data;
+    data.Set(info[0]);
+
+    int jobId = 0;
+    ErrorMessage *errorMessage = PrinterManager::getInstance().printDirect(printer, docName, type, data.data(), jobId);
+    if (errorMessage != NULL)
+    {
+        throw Napi::Error::New(env, *errorMessage);
+    }
+
+    return Napi::Number::New(env, jobId);
+}
+
+Napi::Value PrinterWrap::PrintAsync(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    CheckOpen(env);
+
+    std::string docName, type;
+    GetPrintArguments(info, docName, type);
+
+    PrintWorker *worker = new PrintWorker(env, this, info[0], docName, type);
+    return worker->QueuePromise(printer.name, info[3]);
+}
+
+Napi::Value PrinterWrap::GetJob(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    CheckOpen(env);
+
+    int jobId = GetJobIdArgument(info);
+
+    JobInfo jobInfo;
+    ErrorMessage *errorMessage = PrinterManager::getInstance().getOneJob(printer, jobId, jobInfo);
+    if (errorMessage != NULL)
+    {
+        throw Napi::Error::New(env, *errorMessage);
+    }
+
+    Napi::Object resultPrinterJob = Napi::Object::New(env);
+    ParseJobObject(jobInfo, resultPrinterJob);
+    return resultPrinterJob;
+}
+
+Napi::Value PrinterWrap::GetJobAsync(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+    CheckOpen(env);
+
+    GetJobWorker *worker = new GetJobWorker(env, this, GetJobIdArgument(info));
+    return worker->QueuePromise(printer.name, info[1]);
+}
+
+Napi::Value PrinterWrap::Close(const Napi::CallbackInfo &info)
+{
+    Napi::Env env = info.Env();
+
+    if (pending > 0)
+    {
+        throw Napi::Error::New(env, "Printer is busy, wait for pending calls to complete");
+    }
+
+    PrinterManager::getInstance().closePrinter(printer);
+
+    return env.Undefined();
+}
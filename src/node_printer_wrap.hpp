@@ -0,0 +1,49 @@
+#ifndef NODE_PRINTER_WRAP_HPP
+#define NODE_PRINTER_WRAP_HPP
+
+#include "PrinterManager.hpp"
+
+#include <napi.h>
+
+/**
+ * Printer object returned by openPrinter(name).
+ * The destination (CUPS) or printer handle (Windows) and its PrinterInfo are
+ * resolved once in the constructor and reused by every method, so loops
+ * printing many jobs to one device pay the resolution cost a single time.
+ *
+ * name String, the name the printer was opened with
+ * info() cached printer info, same shape as getPrinter
+ * refresh() reload the cached printer info from the spooler, blocking the JS thread
+ * refreshAsync([options]) same on the worker pool, resolves with the new info;
+ *   info() throws until it settles
+ * print(data, docname, type) / printAsync(...) same as printDirect
+ * getJob(id) / getJobAsync(id) same as getJob
+ * close() release the handle, the object can not be used afterwards
+ */
+class PrinterWrap : public Napi::ObjectWrap<PrinterWrap>
+{
+public:
+    static Napi::Function Init(Napi::Env env);
+
+    PrinterWrap(const Napi::CallbackInfo &info);
+    ~PrinterWrap();
+
+    OpenedPrinter printer;
+    int pending = 0;
+    bool refreshing = false;
+
+private:
+    void CheckOpen(Napi::Env env);
+
+    Napi::Value GetName(const Napi::CallbackInfo &info);
+    Napi::Value Info(const Napi::CallbackInfo &info);
+    Napi::Value Refresh(const Napi::CallbackInfo &info);
+    Napi::Value RefreshAsync(const Napi::CallbackInfo &info);
+    Napi::Value Print(const Napi::CallbackInfo &info);
+    Napi::Value PrintAsync(const Napi::CallbackInfo &info);
+    Napi::Value GetJob(const Napi::CallbackInfo &info);
+    Napi::Value GetJobAsync(const Napi::CallbackInfo &info);
+    Napi::Value Close(const Napi::CallbackInfo &info);
+};
+
+#endif
@@ -0,0 +1,295 @@
+#ifndef NODE_WORKER_HPP
+#define NODE_WORKER_HPP
+
+#include "PrinterManager.hpp"
+#include "node_marshal.hpp"
+#include "WorkerPool.hpp"
+
+#include <napi.h>
+
+#include <string>
+#include <string_view>
+
+/**
+ * Print payload passed to PrinterManager without copying it.
+ * A Buffer is read in place and kept alive by a reference until the
+ * object is destroyed; a string has to be transcoded to UTF-8 once.
+ */
+class PrintData
+{
+public:
+    void Set(const Napi::Value &value)
+    {
+        if (value.IsBuffer())
+        {
+            Napi::Buffer<char> buffer = value.As<Napi::Buffer<char>>();
+            view = std::string_view(buffer.Data(), buffer.Length());
+            bufferRef = Napi::Persistent(buffer.As<Napi::Object>());
+        }
+        else if (value.IsTypedArray())
+        {
+            // Pixels of an ImageData (Uint8ClampedArray) and other typed arrays, borrowed like a Buffer
+            Napi::TypedArray array = value.As<Napi::TypedArray>();
+            view = std::string_view((const char *)array.ArrayBuffer().Data() + array.ByteOffset(), array.ByteLength());
+            bufferRef = Napi::Persistent(array.As<Napi::Object>());
+        }
+        else if (value.IsString())
+        {
+            storage = value.As<Napi::String>().Utf8Value();
+            view = std::string_view();
+        }
+        else
+        {
+            throw Napi::Error::New(value.Env(), "First argument must be a string or Buffer");
+        }
+    }
+
+    std::string_view data() const
+    {
+        return bufferRef.IsEmpty() ? std::string_view(storage) : view;
+    }
+
+private:
+    std::string_view view;
+    std::string storage;
+    Napi::ObjectReference bufferRef;
+};
+
+// Names of the WorkerPriority lanes in options and stats objects
+static const char *const PRIORITY_NAMES[PRIORITY_LANES] = {"high", "normal", "low"};
+
+inline const char *PriorityName(WorkerPriority priority)
+{
+    return PRIORITY_NAMES[priority];
+}
+
+/**
+ * Base class of the *Async exports.
+ * Run() is called on a WorkerPool thread and must only touch native state;
+ * Result() is called back on the JS thread to build the resolved value.
+ * An ErrorMessage returned by Run() rejects the promise, and so does a full
+ * pool queue. Workers queued with the same key (a printer name) run one
+ * after the other.
+ * The optional { timeout, signal } options bound the call: the timeout in
+ * milliseconds counts from the call, waiting in the queue included, and an
+ * AbortSignal cancels it. Run() hands the context to PrinterManager.
+ * A priority of "high", "normal" or "low" picks the WorkerPool lane.
+ */
+class PrinterWorker : public WorkerTask
+{
+public:
+    PrinterWorker(Napi::Env env)
+        : env(env), deferred(Napi::Promise::Deferred::New(env))
+    {
+    }
+
+    Napi::Promise QueuePromise(std::string_view key = std::string_view(), const Napi::Value &options = Napi::Value())
+    {
+        Napi::Promise promise = deferred.Promise();
+
+        // Bad options reject like any other failure, so subclasses get to undo their bookkeeping
+        try
+        {
+            SetOperationOptions(options);
+        }
+        catch (const Napi::Error &error)
+        {
+            OnError(error);
+            delete this;
+            return promise;
+        }
+
+        if (context.stopped())
+        {
+            Complete(env, this, context.error());
+            return promise;
+        }
+
+        this->key = key;
+        // Keeps the event loop alive until the result is back, like a libuv work request
+        completion = Napi::ThreadSafeFunction::New(env, Napi::Function(), "nodeprinting", 0, 1);
+
+        ErrorMessage *errorMessage = Submit();
+        if (errorMessage != NULL)
+        {
+            completion.Release();
+            Complete(env, this, errorMessage);
+        }
+
+        return promise;
+    }
+
+protected:
+    virtual ErrorMessage *Run(PrinterManager &printerManager) = 0;
+    virtual Napi::Value Result(Napi::Env env) = 0;
+
+    // Hands the worker over to whatever runs it, the pool unless overridden.
+    // Once it returns NULL the worker may already be done
+    virtual ErrorMessage *Submit()
+    {
+        return WorkerPool::getInstance().submit(this);
+    }
+
+    // Completes a worker that was run outside of Execute(), from any thread
+    void Finish(ErrorMessage *errorMessage)
+    {
+        this->errorMessage = errorMessage;
+        Done();
+    }
+
+    virtual void OnOK()
+    {
+        deferred.Resolve(Result(Env()));
+    }
+
+    virtual void OnError(const Napi::Error &error)
+    {
+        deferred.Reject(error.Value());
+    }
+
+    Napi::Env Env() const { return env; }
+
+    OperationContext context;
+
+private:
+    void SetOperationOptions(const Napi::Value &options)
+    {
+        if (options.IsEmpty() || options.IsUndefined() || options.IsNull())
+        {
+            return;
+        }
+        if (!options.IsObject())
+        {
+            throw Napi::TypeError::New(env, "Options must be an object");
+        }
+
+        Napi::Object object = options.As<Napi::Object>();
+        Napi::Value timeout = object.Get("timeout");
+        if (!timeout.IsUndefined())
+        {
+            if (!timeout.IsNumber())
+            {
+                throw Napi::TypeError::New(env, "timeout must be a number of milliseconds");
+            }
+            context.setTimeout(timeout.As<Napi::Number>().Int32Value());
+        }
+
+        Napi::Value priorityValue = object.Get("priority");
+        if (!priorityValue.IsUndefined())
+        {
+            std::string name = priorityValue.IsString() ? priorityValue.As<Napi::String>().Utf8Value() : std::string();
+            int lane = 0;
+            while (lane < PRIORITY_LANES && name != PRIORITY_NAMES[lane])
+            {
+                lane++;
+            }
+            if (lane == PRIORITY_LANES)
+            {
+                throw Napi::TypeError::New(env, "priority must be 'high', 'normal' or 'low'");
+            }
+            priority = (WorkerPriority)lane;
+        }
+
+        Napi::Value signal = object.Get("signal");
+        if (signal.IsUndefined())
+        {
+            return;
+        }
+        if (!signal.IsObject())
+        {
+            throw Napi::TypeError::New(env, "signal must be an AbortSignal");
+        }
+
+        Napi::Object signalObject = signal.As<Napi::Object>();
+        if (signalObject.Get("aborted").ToBoolean())
+        {
+            context.cancel();
+            return;
+        }
+
+        // The listener only flags the context, the worker thread notices it at its next step
+        OperationContext *workerContext = &context;
+        Napi::Function onAbort = Napi::Function::New(
+            env, [workerContext](const Napi::CallbackInfo &)
+            { workerContext->cancel(); },
+            "onAbort");
+        signalObject.Get("addEventListener").As<Napi::Function>().Call(signalObject, {Napi::String::New(env, "abort"), onAbort});
+        abortSignal = Napi::Persistent(signalObject);
+        abortListener = Napi::Persistent(onAbort);
+    }
+
+    void RemoveAbortListener()
+    {
+        if (abortSignal.IsEmpty())
+        {
+            return;
+        }
+
+        Napi::Object signalObject = abortSignal.Value();
+        signalObject.Get("removeEventListener").As<Napi::Function>().Call(signalObject, {Napi::String::New(env, "abort"), abortListener.Value()});
+    }
+
+    void Execute() override
+    {
+        if (context.stopped())
+        {
+            errorMessage = context.error();
+            return;
+        }
+
+        errorMessage = Run(PrinterManager::getInstance());
+        // A call cut short fails with whatever step it was in, report why instead
+        if (errorMessage != NULL && context.stopped())
+        {
+            errorMessage = context.error();
+        }
+    }
+
+    void Done() override
+    {
+        // The JS thread may delete the worker as soon as the call is queued.
+        // The call only fails while the environment shuts down, the worker is leaked then
+        Napi::ThreadSafeFunction completion = this->completion;
+        completion.BlockingCall(this, CallJs);
+        completion.Release();
+    }
+
+    static void CallJs(Napi::Env env, Napi::Function, PrinterWorker *worker)
+    {
+        Complete(env, worker, worker->errorMessage);
+    }
+
+    static void Complete(Napi::Env env, PrinterWorker *worker, ErrorMessage *errorMessage)
+    {
+        if (env != nullptr)
+        {
+            try
+            {
+                worker->RemoveAbortListener();
+                if (errorMessage != NULL)
+                {
+                    worker->OnError(Napi::Error::New(env, *errorMessage));
+                }
+                else
+                {
+                    worker->OnOK();
+                }
+            }
+            catch (const Napi::Error &error)
+            {
+                worker->deferred.Reject(error.Value());
+            }
+        }
+
+        delete worker;
+    }
+
+    Napi::Env env;
+    Napi::Promise::Deferred deferred;
+    Napi::ThreadSafeFunction completion;
+    ErrorMessage *errorMessage = NULL;
+    Napi::ObjectReference abortSignal;
+    Napi::FunctionReference abortListener;
+};
+
+#endif
@@ -4,17 +4,183 @@
 #include <stdexcept>
 #include <sstream>
 #include <string>
+#include <cstring>
+#include <strings.h>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <ctime>
+#include <vector>
+#include <memory>
 
-// Helper function to convert const char* to std::wstring
-std::wstring charToWString(const char *str)
+// Documents are handed to cupsd in pieces of this size, so the first bytes
+// reach the spooler at once and no second copy of the payload is needed.
+static const size_t PRINT_CHUNK_SIZE = 64 * 1024;
+
+// Idle keep-alive connections kept around for reuse. Connections in use are not limited,
+// a streaming job holds its connection until the document is finished.
+static const size_t MAX_IDLE_CONNECTIONS = 8;
+static const int CONNECT_TIMEOUT_MS = 30000;
+// How often a blocked read or write on a connection checks whether its operation was stopped
+static const double OPERATION_POLL_SECONDS = 0.25;
+// Limit of the cleanup requests (Cancel-Job, Cancel-Subscription), made without a caller's context
+static const int CLEANUP_TIMEOUT_MS = 5000;
+
+/**
+ * Process wide pool of keep-alive connections to cupsd.
+ * Opening a connection per call dominates the latency of short requests, so
+ * released connections are parked and handed out again to the next caller.
+ * An http_t is only ever used by one thread at a time.
+ */
+class ConnectionPool
+{
+public:
+    ~ConnectionPool()
+    {
+        for (http_t *http : idle)
+        {
+            httpClose(http);
+        }
+    }
+
+    // A new connection waits no longer than the time context has left
+    http_t *acquire(OperationContext *context = NULL)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!idle.empty())
+            {
+                http_t *http = idle.back();
+                idle.pop_back();
+                return http;
+            }
+        }
+
+        int timeoutMs = context != NULL ? context->remainingMs(CONNECT_TIMEOUT_MS) : CONNECT_TIMEOUT_MS;
+        if (timeoutMs <= 0)
+        {
+            return NULL;
+        }
+
+        return httpConnect2(cupsServer(), ippPort(), NULL, AF_UNSPEC, cupsEncryption(), 1, timeoutMs, NULL);
+    }
+
+    // Connections left in an unknown state (aborted request) must not be reused
+    void release(http_t *http, bool reusable)
+    {
+        if (http == NULL)
+        {
+            return;
+        }
+
+        if (reusable)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (idle.size() < MAX_IDLE_CONNECTIONS)
+            {
+                idle.push_back(http);
+                return;
+            }
+        }
+
+        httpClose(http);
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<http_t *> idle;
+};
+
+ConnectionPool &getConnectionPool()
+{
+    static ConnectionPool pool;
+    return pool;
+}
+
+// httpSetTimeout callback: 0 makes the blocked read or write fail, 1 keeps waiting
+static int OperationTimeoutCallback(http_t *, void *context)
 {
-    std::string s(str);
-    return std::wstring(s.begin(), s.end());
+    return ((OperationContext *)context)->stopped() ? 0 : 1;
 }
 
-ErrorMessage *PrinterManager::getDefaultPrinterName(PrinterName &printerName)
+/**
+ * Binds the requests made on a connection to an OperationContext for the
+ * lifetime of the object: a request blocked on cupsd gives up once the
+ * operation is cancelled or past its deadline.
+ */
+class OperationTimeout
+{
+public:
+    OperationTimeout(http_t *http, OperationContext *context) : _http(context != NULL ? http : NULL)
+    {
+        if (_http != NULL)
+        {
+            httpSetTimeout(_http, OPERATION_POLL_SECONDS, OperationTimeoutCallback, context);
+        }
+    }
+
+    ~OperationTimeout()
+    {
+        if (_http != NULL)
+        {
+            httpSetTimeout(_http, 0.0, NULL, NULL);
+        }
+    }
+
+private:
+    http_t *_http;
+};
+
+struct PooledConnection
+{
+    PooledConnection(OperationContext *context = NULL)
+        : _http(getConnectionPool().acquire(context)), _reusable(true), _context(context)
+    {
+        if (_http != NULL && _context != NULL)
+        {
+            httpSetTimeout(_http, OPERATION_POLL_SECONDS, OperationTimeoutCallback, _context);
+        }
+    }
+
+    ~PooledConnection()
+    {
+        // A request given up half way leaves the connection in an unknown state
+        if (_context != NULL && _context->stopped())
+        {
+            _reusable = false;
+        }
+        if (_http != NULL && _context != NULL)
+        {
+            httpSetTimeout(_http, 0.0, NULL, NULL);
+        }
+        getConnectionPool().release(_http, _reusable);
+    }
+
+    void discard() { _reusable = false; }
+
+    operator http_t *() { return _http; }
+    operator bool() { return _http != NULL; }
+
+    http_t *_http;
+    bool _reusable;
+    OperationContext *_context;
+};
+
+ErrorMessage *PrinterManager::getDefaultPrinterName(PrinterName &printerName, OperationContext *context)
 {
-    const char *defaultDest = cupsGetDefault();
+    PooledConnection http(context);
+    if (!http)
+    {
+        static ErrorMessage errorMsg = "Could not connect to the CUPS server";
+        return &errorMsg;
+    }
+
+    const char *defaultDest = cupsGetDefault2(http);
 
     if (defaultDest == NULL)
     {
@@ -22,24 +188,31 @@ ErrorMessage *PrinterManager::getDefaultPrinterName(PrinterName &printerName)
         return &errorMsg;
     }
 
-    printerName = charToWString(defaultDest);
+    printerName = defaultDest;
 
     return NULL;
 }
 
-ErrorMessage *PrinterManager::getOnePrinter(PrinterName name, PrinterInfo &printerInfo)
+// printer-state enum value and its keyword, as reported by getPrinter
+void SetPrinterState(int state, PrinterInfo &printerInfo)
 {
-
-    const char *printerName = std::string(name.begin(), name.end()).c_str();
-    cups_dest_t *printer = NULL;
-    printer = cupsGetNamedDest(NULL, printerName, NULL);
-
-    if (printer == NULL)
+    printerInfo.status = state;
+    if (state == 3)
     {
-        static ErrorMessage errorMsg = "Error could not get printer info";
-        return &errorMsg;
+        printerInfo.statusArray.push_back("idle");
+    }
+    else if (state == 4)
+    {
+        printerInfo.statusArray.push_back("printing");
     }
+    else if (state == 5)
+    {
+        printerInfo.statusArray.push_back("stopped");
+    }
+}
 
+void ParseDestObject(cups_dest_t *printer, PrinterInfo &printerInfo)
+{
     printerInfo.name = std::string(printer->name);
 
     if (printer->instance != NULL)
@@ -66,23 +239,1264 @@ ErrorMessage *PrinterManager::getOnePrinter(PrinterName name, PrinterInfo &print
         }
         else if (strcmp(option->name, "printer-state") == 0)
         {
-            printerInfo.status = atoi(option->value);
-            if (atoi(option->value) == 3)
-            {
-                printerInfo.statusArray.push_back("idle");
-            }
-            else if (atoi(option->value) == 4)
-            {
-                printerInfo.statusArray.push_back("printing");
-            }
-            else if (atoi(option->value) == 5)
+            SetPrinterState(atoi(option->value), printerInfo);
+        }
+    }
+}
+
+// Printer attributes needed to fill a PrinterInfo, the same ones ParseDestObject reads.
+// printer-name is always requested, it delimits the printers of a response
+static const std::pair<unsigned, const char *> PRINTER_ATTRIBUTES[] = {
+    {PRINTER_FIELDS_ALL, "printer-name"},
+    {PRINTER_FIELD_SERVER, "printer-info"},
+    {PRINTER_FIELD_LOCATION, "printer-location"},
+    {PRINTER_FIELD_PORT_NAME, "printer-make-and-model"},
+    {PRINTER_FIELD_STATUS | PRINTER_FIELD_STATUS_ARRAY, "printer-state"},
+};
+
+std::vector<const char *> getPrinterAttributes(unsigned fields)
+{
+    std::vector<const char *> attributes;
+    for (const std::pair<unsigned, const char *> &attribute : PRINTER_ATTRIBUTES)
+    {
+        if (attribute.first & fields)
+        {
+            attributes.push_back(attribute.second);
+        }
+    }
+    return attributes;
+}
+
+// URI of a resource on the configured CUPS server. A domain socket (cupsServer() starting
+// with '/') is the local scheduler, which knows itself as localhost
+std::string getServerUri(const char *resource)
+{
+    const char *server = cupsServer();
+    char uri[HTTP_MAX_URI];
+    httpAssembleURI(HTTP_URI_CODING_ALL, uri, sizeof(uri), "ipp", NULL, server[0] == '/' ? "localhost" : server, ippPort(), resource);
+    return uri;
+}
+
+std::string getPrinterUri(const std::string &printerName)
+{
+    return getServerUri(("/printers/" + printerName).c_str());
+}
+
+// Fill printerInfo from the attributes of one printer group, starting at attr.
+// Returns the first attribute after the group.
+ipp_attribute_t *ParsePrinterAttributes(ipp_t *response, ipp_attribute_t *attr, PrinterInfo &printerInfo)
+{
+    for (; attr != NULL && ippGetGroupTag(attr) == IPP_TAG_PRINTER; attr = ippNextAttribute(response))
+    {
+        const char *name = ippGetName(attr);
+        if (name == NULL)
+        {
+            continue;
+        }
+
+        if (strcmp(name, "printer-state") == 0)
+        {
+            SetPrinterState(ippGetInteger(attr, 0), printerInfo);
+            continue;
+        }
+
+        const char *value = ippGetString(attr, 0, NULL);
+        if (value == NULL)
+        {
+            continue;
+        }
+
+        if (strcmp(name, "printer-name") == 0)
+        {
+            printerInfo.name = value;
+        }
+        else if (strcmp(name, "printer-info") == 0)
+        {
+            printerInfo.server = value;
+        }
+        else if (strcmp(name, "printer-location") == 0)
+        {
+            printerInfo.location = value;
+        }
+        else if (strcmp(name, "printer-make-and-model") == 0)
+        {
+            printerInfo.portName = value;
+        }
+    }
+
+    return attr;
+}
+
+ErrorMessage *PrinterManager::getPrinters(std::vector<PrinterInfo> &printersInfo, unsigned fields, OperationContext *context)
+{
+    PooledConnection http(context);
+    if (!http)
+    {
+        static ErrorMessage errorMsg = "Could not connect to the CUPS server";
+        return &errorMsg;
+    }
+
+    // Every queue comes back in this one response, instead of a request per destination.
+    // Only the attributes behind the requested fields are encoded by cupsd
+    std::vector<const char *> attributes = getPrinterAttributes(fields);
+
+    ipp_t *request = ippNewRequest(IPP_OP_CUPS_GET_PRINTERS);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsUser());
+    ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes",
+                  (int)attributes.size(), NULL, attributes.data());
+
+    ipp_t *response = cupsDoRequest(http, request, "/");
+    if (response == NULL)
+    {
+        static ErrorMessage errorMsg = "Error on CUPS-Get-Printers";
+        return &errorMsg;
+    }
+
+    // No queue at all is reported as not-found, that is an empty list
+    if (ippGetStatusCode(response) == IPP_STATUS_ERROR_NOT_FOUND)
+    {
+        ippDelete(response);
+        return NULL;
+    }
+
+    if (ippGetStatusCode(response) > IPP_STATUS_OK_IGNORED_OR_SUBSTITUTED)
+    {
+        ippDelete(response);
+        static ErrorMessage errorMsg = "Error on CUPS-Get-Printers";
+        return &errorMsg;
+    }
+
+    ipp_attribute_t *attr = ippFirstAttribute(response);
+    while (attr != NULL)
+    {
+        if (ippGetGroupTag(attr) != IPP_TAG_PRINTER)
+        {
+            attr = ippNextAttribute(response);
+            continue;
+        }
+
+        PrinterInfo printerInfo;
+        printerInfo.fields = fields;
+        attr = ParsePrinterAttributes(response, attr, printerInfo);
+        if (!printerInfo.name.empty())
+        {
+            printersInfo.push_back(printerInfo);
+        }
+    }
+
+    ippDelete(response);
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::getOnePrinter(std::string_view name, PrinterInfo &printerInfo, unsigned fields, OperationContext *context)
+{
+    PooledConnection http(context);
+    if (!http)
+    {
+        static ErrorMessage errorMsg = "Could not connect to the CUPS server";
+        return &errorMsg;
+    }
+
+    // An instance ("queue/instance") is a local set of options, cupsd only knows its queue
+    std::string printerName(name);
+    std::string instance;
+    size_t slash = printerName.find('/');
+    if (slash != std::string::npos)
+    {
+        instance = printerName.substr(slash + 1);
+        printerName.resize(slash);
+    }
+
+    // Like getPrinters, only the attributes behind the requested fields instead of every
+    // attribute cupsGetNamedDest asks for
+    std::vector<const char *> attributes = getPrinterAttributes(fields);
+
+    ipp_t *request = ippNewRequest(IPP_OP_GET_PRINTER_ATTRIBUTES);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, getPrinterUri(printerName).c_str());
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsUser());
+    ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes",
+                  (int)attributes.size(), NULL, attributes.data());
+
+    ipp_t *response = cupsDoRequest(http, request, "/");
+    if (response == NULL || ippGetStatusCode(response) > IPP_STATUS_OK_IGNORED_OR_SUBSTITUTED)
+    {
+        ippDelete(response);
+        static ErrorMessage errorMsg = "Error could not get printer info";
+        return &errorMsg;
+    }
+
+    ipp_attribute_t *attr = ippFirstAttribute(response);
+    while (attr != NULL && ippGetGroupTag(attr) != IPP_TAG_PRINTER)
+    {
+        attr = ippNextAttribute(response);
+    }
+    ParsePrinterAttributes(response, attr, printerInfo);
+    ippDelete(response);
+
+    if (printerInfo.name.empty())
+    {
+        printerInfo.name = printerName;
+    }
+    if (!instance.empty())
+    {
+        printerInfo.name += " " + instance;
+    }
+    printerInfo.fields = fields;
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::openPrinter(std::string_view name, OpenedPrinter &printer, OperationContext *context)
+{
+    PooledConnection http(context);
+    if (!http)
+    {
+        static ErrorMessage errorMsg = "Could not connect to the CUPS server";
+        return &errorMsg;
+    }
+
+    std::string printerName(name);
+    cups_dest_t *dest = cupsGetNamedDest(http, printerName.c_str(), NULL);
+
+    if (dest == NULL)
+    {
+        static ErrorMessage errorMsg = "Error could not get printer info";
+        return &errorMsg;
+    }
+
+    printer.name = name;
+    printer.info = PrinterInfo();
+    ParseDestObject(dest, printer.info);
+    printer.handle = dest;
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::refreshPrinter(OpenedPrinter &printer, OperationContext *context)
+{
+    std::lock_guard<std::mutex> guard(printer.lock);
+
+    PooledConnection http(context);
+    if (!http)
+    {
+        static ErrorMessage errorMsg = "Could not connect to the CUPS server";
+        return &errorMsg;
+    }
+
+    cups_dest_t *dest = (cups_dest_t *)printer.handle;
+    if (dest == NULL)
+    {
+        static ErrorMessage errorMsg = "Printer is closed";
+        return &errorMsg;
+    }
+
+    cups_dest_t *updated = cupsGetNamedDest(http, dest->name, dest->instance);
+    if (updated == NULL)
+    {
+        static ErrorMessage errorMsg = "Error could not get printer info";
+        return &errorMsg;
+    }
+
+    printer.info = PrinterInfo();
+    ParseDestObject(updated, printer.info);
+    printer.handle = updated;
+    cupsFreeDests(1, dest);
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::closePrinter(OpenedPrinter &printer)
+{
+    std::lock_guard<std::mutex> guard(printer.lock);
+
+    if (printer.handle != NULL)
+    {
+        cupsFreeDests(1, (cups_dest_t *)printer.handle);
+        printer.handle = NULL;
+    }
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::printDirect(OpenedPrinter &printer, const std::string &docName, const std::string &type, std::string_view data, int &jobId, OperationContext *context)
+{
+    // Jobs are addressed by queue name, nothing left to resolve
+    return printDirect(printer.name, docName, type, data, jobId, context);
+}
+
+// Job attributes needed to fill a JobInfo
+static const char *const JOB_ATTRIBUTES[] = {
+    "job-id",
+    "job-printer-uri",
+    "job-originating-user-name",
+    "job-priority",
+    "job-k-octets",
+    "job-state",
+    "job-state-reasons",
+    "number-of-intervening-jobs",
+    "job-impressions",
+    "job-impressions-completed",
+};
+
+// Fill one JobInfo field from a job attribute, attributes JobInfo does not know are ignored
+void ParseJobAttribute(ipp_attribute_t *attr, const char *name, JobInfo &jobInfo)
+{
+    if (strcmp(name, "job-id") == 0)
+    {
+        jobInfo.id = ippGetInteger(attr, 0);
+    }
+    else if (strcmp(name, "job-printer-uri") == 0)
+    {
+        const char *uri = ippGetString(attr, 0, NULL);
+        const char *slash = uri != NULL ? strrchr(uri, '/') : NULL;
+        jobInfo.name = slash != NULL ? std::string(slash + 1) : std::string();
+    }
+    else if (strcmp(name, "job-originating-user-name") == 0)
+    {
+        const char *user = ippGetString(attr, 0, NULL);
+        jobInfo.user = user != NULL ? user : "";
+    }
+    else if (strcmp(name, "job-priority") == 0)
+    {
+        jobInfo.priority = ippGetInteger(attr, 0);
+    }
+    else if (strcmp(name, "job-k-octets") == 0)
+    {
+        jobInfo.size = ippGetInteger(attr, 0) * 1024;
+    }
+    else if (strcmp(name, "job-state") == 0)
+    {
+        const char *state = ippEnumString("job-state", ippGetInteger(attr, 0));
+        jobInfo.status = state != NULL ? state : "";
+    }
+    else if (strcmp(name, "job-state-reasons") == 0)
+    {
+        for (int i = 0; i < ippGetCount(attr); i++)
+        {
+            const char *reason = ippGetString(attr, i, NULL);
+            if (reason != NULL)
             {
-                printerInfo.statusArray.push_back("stopped");
+                jobInfo.statusArray.push_back(reason);
             }
         }
     }
+    else if (strcmp(name, "number-of-intervening-jobs") == 0)
+    {
+        jobInfo.position = ippGetInteger(attr, 0) + 1;
+    }
+    else if (strcmp(name, "job-impressions") == 0)
+    {
+        jobInfo.totalPages = ippGetInteger(attr, 0);
+    }
+    else if (strcmp(name, "job-impressions-completed") == 0)
+    {
+        jobInfo.pagesPrinted = ippGetInteger(attr, 0);
+    }
+}
+
+// Fill jobInfo from the attributes of one job group, starting at attr.
+// Returns the first attribute after the group.
+ipp_attribute_t *ParseJobAttributes(ipp_t *response, ipp_attribute_t *attr, JobInfo &jobInfo)
+{
+    for (; attr != NULL && ippGetGroupTag(attr) == IPP_TAG_JOB; attr = ippNextAttribute(response))
+    {
+        const char *name = ippGetName(attr);
+        if (name != NULL)
+        {
+            ParseJobAttribute(attr, name, jobInfo);
+        }
+    }
 
-    cupsFreeDests(1, printer);
+    return attr;
+}
 
-    return NULL;
-}
\ No newline at end of file
+ErrorMessage *PrinterManager::getOneJob(std::string_view name, int jobId, JobInfo &jobInfo, OperationContext *context)
+{
+    PooledConnection http(context);
+    if (!http)
+    {
+        static ErrorMessage errorMsg = "Could not connect to the CUPS server";
+        return &errorMsg;
+    }
+
+    std::string printerName(name);
+
+    ipp_t *request = ippNewRequest(IPP_OP_GET_JOB_ATTRIBUTES);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, getPrinterUri(printerName).c_str());
+    ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-id", jobId);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsUser());
+    ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes",
+                  (int)(sizeof(JOB_ATTRIBUTES) / sizeof(JOB_ATTRIBUTES[0])), NULL, JOB_ATTRIBUTES);
+
+    ipp_t *response = cupsDoRequest(http, request, "/");
+    if (response == NULL || ippGetStatusCode(response) > IPP_STATUS_OK_IGNORED_OR_SUBSTITUTED)
+    {
+        ippDelete(response);
+        static ErrorMessage errorMsg = "Error on Get-Job-Attributes. Wrong job id or it was deleted";
+        return &errorMsg;
+    }
+
+    ipp_attribute_t *attr = ippFirstAttribute(response);
+    while (attr != NULL && ippGetGroupTag(attr) != IPP_TAG_JOB)
+    {
+        attr = ippNextAttribute(response);
+    }
+    ParseJobAttributes(response, attr, jobInfo);
+
+    if (jobInfo.name.empty())
+    {
+        jobInfo.name = printerName;
+    }
+
+    ippDelete(response);
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::getJobs(std::string_view name, const std::vector<int> &jobIds, std::vector<JobInfo> &jobsInfo, OperationContext *context)
+{
+    PooledConnection http(context);
+    if (!http)
+    {
+        static ErrorMessage errorMsg = "Could not connect to the CUPS server";
+        return &errorMsg;
+    }
+
+    std::string printerName(name);
+
+    ipp_t *request = ippNewRequest(IPP_OP_GET_JOBS);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, getPrinterUri(printerName).c_str());
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsUser());
+    // job-ids already selects completed jobs too, which-jobs may not be combined with it
+    if (jobIds.empty())
+    {
+        ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "which-jobs", NULL, "all");
+    }
+    else
+    {
+        ippAddIntegers(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "job-ids", (int)jobIds.size(), jobIds.data());
+    }
+    ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes",
+                  (int)(sizeof(JOB_ATTRIBUTES) / sizeof(JOB_ATTRIBUTES[0])), NULL, JOB_ATTRIBUTES);
+
+    ipp_t *response = cupsDoRequest(http, request, "/");
+    if (response == NULL || ippGetStatusCode(response) > IPP_STATUS_OK_IGNORED_OR_SUBSTITUTED)
+    {
+        ippDelete(response);
+        static ErrorMessage errorMsg = "Error on Get-Jobs";
+        return &errorMsg;
+    }
+
+    std::map<int, JobInfo> jobs;
+    ipp_attribute_t *attr = ippFirstAttribute(response);
+    while (attr != NULL)
+    {
+        if (ippGetGroupTag(attr) != IPP_TAG_JOB)
+        {
+            attr = ippNextAttribute(response);
+            continue;
+        }
+
+        JobInfo jobInfo;
+        attr = ParseJobAttributes(response, attr, jobInfo);
+        if (jobInfo.name.empty())
+        {
+            jobInfo.name = printerName;
+        }
+        jobs[jobInfo.id] = jobInfo;
+    }
+
+    ippDelete(response);
+
+    if (jobIds.empty())
+    {
+        for (std::map<int, JobInfo>::value_type &job : jobs)
+        {
+            jobsInfo.push_back(job.second);
+        }
+        return NULL;
+    }
+
+    for (int jobId : jobIds)
+    {
+        std::map<int, JobInfo>::iterator job = jobs.find(jobId);
+        if (job != jobs.end())
+        {
+            jobsInfo.push_back(job->second);
+        }
+    }
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::getOneJob(OpenedPrinter &printer, int jobId, JobInfo &jobInfo, OperationContext *context)
+{
+    return getOneJob(printer.name, jobId, jobInfo, context);
+}
+
+ErrorMessage *PrinterManager::getPrinterChangeTimes(PrinterChangeTimes &changeTimes, OperationContext *context)
+{
+    PooledConnection http(context);
+    if (!http)
+    {
+        static ErrorMessage errorMsg = "Could not connect to the CUPS server";
+        return &errorMsg;
+    }
+
+    static const char *const attributes[] = {
+        "printer-name",
+        "printer-state-change-time",
+        "printer-config-change-time",
+    };
+
+    ipp_t *request = ippNewRequest(IPP_OP_CUPS_GET_PRINTERS);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsUser());
+    ippAddStrings(request, IPP_TAG_OPERATION, IPP_TAG_KEYWORD, "requested-attributes",
+                  (int)(sizeof(attributes) / sizeof(attributes[0])), NULL, attributes);
+
+    ipp_t *response = cupsDoRequest(http, request, "/");
+    if (response == NULL || ippGetStatusCode(response) > IPP_STATUS_OK_IGNORED_OR_SUBSTITUTED)
+    {
+        ippDelete(response);
+        static ErrorMessage errorMsg = "Error on CUPS-Get-Printers";
+        return &errorMsg;
+    }
+
+    std::string name;
+    PrinterChangeTime changeTime;
+
+    // One printer group per queue, groups are separated by attributes without a name
+    for (ipp_attribute_t *attr = ippFirstAttribute(response); ; attr = ippNextAttribute(response))
+    {
+        const char *attrName = attr != NULL ? ippGetName(attr) : NULL;
+
+        if (attrName == NULL || ippGetGroupTag(attr) != IPP_TAG_PRINTER)
+        {
+            if (!name.empty())
+            {
+                changeTimes[name] = changeTime;
+            }
+            name.clear();
+            changeTime = PrinterChangeTime();
+
+            if (attr == NULL)
+            {
+                break;
+            }
+            continue;
+        }
+
+        if (strcmp(attrName, "printer-name") == 0)
+        {
+            name = ippGetString(attr, 0, NULL);
+        }
+        else if (strcmp(attrName, "printer-state-change-time") == 0)
+        {
+            changeTime.state = ippGetInteger(attr, 0);
+        }
+        else if (strcmp(attrName, "printer-config-change-time") == 0)
+        {
+            changeTime.config = ippGetInteger(attr, 0);
+        }
+    }
+
+    ippDelete(response);
+
+    return NULL;
+}
+
+bool PrinterManager::hasPrinterChangeTimes()
+{
+    return true;
+}
+
+// Map the Windows style data types accepted by printDirect to CUPS document formats.
+// Anything that looks like a MIME type is passed through untouched.
+std::string getDocumentFormat(const std::string &type)
+{
+    if (type.empty() || strcasecmp(type.c_str(), "RAW") == 0)
+    {
+        return CUPS_FORMAT_RAW;
+    }
+    if (strcasecmp(type.c_str(), "TEXT") == 0)
+    {
+        return CUPS_FORMAT_TEXT;
+    }
+    if (strcasecmp(type.c_str(), "AUTO") == 0)
+    {
+        return CUPS_FORMAT_AUTO;
+    }
+
+    return type;
+}
+
+std::string PrinterManager::getSniffedType(DocumentFormat format)
+{
+    // Printer languages skip the cupsd filter chain, documents get their own format so
+    // only the filters they need run. Unknown data is still left to CUPS auto typing
+    if (isPrinterReadyFormat(format))
+    {
+        return CUPS_FORMAT_RAW;
+    }
+    switch (format)
+    {
+    case FORMAT_PDF:
+        return CUPS_FORMAT_PDF;
+    case FORMAT_POSTSCRIPT:
+        return CUPS_FORMAT_POSTSCRIPT;
+    case FORMAT_PWG_RASTER:
+        return "image/pwg-raster";
+    case FORMAT_URF:
+        return "image/urf";
+    default:
+        return CUPS_FORMAT_AUTO;
+    }
+}
+
+ErrorMessage *PrinterManager::startJob(std::string_view name, const std::string &docName, const std::string &type, PrintJob &job, OperationContext *context)
+{
+    // The job outlives this call and may be written from other threads, so it
+    // holds a pooled connection instead of the thread local CUPS_HTTP_DEFAULT
+    http_t *http = getConnectionPool().acquire(context);
+    if (http == NULL)
+    {
+        static ErrorMessage errorMsg = "Could not connect to the CUPS server";
+        return &errorMsg;
+    }
+
+    std::string format = getDocumentFormat(type);
+    job.printer = std::string(name);
+
+    // Create-Job, then a single Send-Document whose body is streamed by writeJob
+    bool started = false;
+    {
+        OperationTimeout timeout(http, context);
+        job.id = cupsCreateJob(http, job.printer.c_str(), docName.c_str(), 0, NULL);
+        started = job.id != 0 &&
+                  cupsStartDocument(http, job.printer.c_str(), job.id, docName.c_str(), format.c_str(), 1) == HTTP_STATUS_CONTINUE;
+    }
+
+    if (job.id == 0)
+    {
+        getConnectionPool().release(http, context == NULL || !context->stopped());
+        static ErrorMessage errorMsg = "Error on cupsCreateJob";
+        return &errorMsg;
+    }
+
+    if (!started)
+    {
+        getConnectionPool().release(http, false);
+        // Under the cleanup limit of cancelJob, the caller's deadline has usually passed by now
+        cancelJob(job);
+        static ErrorMessage errorMsg = "Error on cupsStartDocument";
+        return &errorMsg;
+    }
+
+    job.handle = http;
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::writeJob(PrintJob &job, std::string_view data, OperationContext *context)
+{
+    http_t *http = (http_t *)job.handle;
+    if (http == NULL)
+    {
+        static ErrorMessage errorMsg = "Print job is not open";
+        return &errorMsg;
+    }
+
+    OperationTimeout timeout(http, context);
+
+    for (size_t offset = 0; offset < data.size(); offset += PRINT_CHUNK_SIZE)
+    {
+        if (context != NULL && context->stopped())
+        {
+            return context->error();
+        }
+
+        size_t chunkSize = std::min(PRINT_CHUNK_SIZE, data.size() - offset);
+        if (cupsWriteRequestData(http, data.data() + offset, chunkSize) != HTTP_STATUS_CONTINUE)
+        {
+            static ErrorMessage errorMsg = "Failed to write all data to printer";
+            return &errorMsg;
+        }
+    }
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::endJob(PrintJob &job, OperationContext *context)
+{
+    http_t *http = (http_t *)job.handle;
+    if (http == NULL)
+    {
+        static ErrorMessage errorMsg = "Print job is not open";
+        return &errorMsg;
+    }
+
+    // Close the PJL job a ticket opened, the job stays open for cancelJob when that fails
+    ErrorMessage *errorMessage = writeJob(job, job.epilogue, context);
+    if (errorMessage != NULL)
+    {
+        return errorMessage;
+    }
+    job.epilogue.clear();
+
+    ipp_status_t status;
+    {
+        OperationTimeout timeout(http, context);
+        status = cupsFinishDocument(http, job.printer.c_str());
+    }
+    getConnectionPool().release(http, status <= IPP_STATUS_OK_IGNORED_OR_SUBSTITUTED);
+    job.handle = NULL;
+
+    if (status > IPP_STATUS_OK_IGNORED_OR_SUBSTITUTED)
+    {
+        static ErrorMessage errorMsg = "Error on cupsFinishDocument";
+        return &errorMsg;
+    }
+
+    return NULL;
+}
+
+// One Send-Document of a batch on a connection already armed with the call's timeout
+static ErrorMessage *sendBatchDocument(http_t *http, const std::string &printer, int jobId, const BatchDocument &document,
+                                       const std::string &type, bool last, OperationContext *context)
+{
+    std::string format = getDocumentFormat(type);
+    if (cupsStartDocument(http, printer.c_str(), jobId, document.docName.c_str(), format.c_str(), last ? 1 : 0) != HTTP_STATUS_CONTINUE)
+    {
+        static ErrorMessage errorMsg = "Error on cupsStartDocument";
+        return &errorMsg;
+    }
+
+    for (size_t offset = 0; offset < document.data.size(); offset += PRINT_CHUNK_SIZE)
+    {
+        if (context != NULL && context->stopped())
+        {
+            return context->error();
+        }
+
+        size_t chunkSize = std::min(PRINT_CHUNK_SIZE, document.data.size() - offset);
+        if (cupsWriteRequestData(http, document.data.data() + offset, chunkSize) != HTTP_STATUS_CONTINUE)
+        {
+            static ErrorMessage errorMsg = "Failed to write all data to printer";
+            return &errorMsg;
+        }
+    }
+
+    if (cupsFinishDocument(http, printer.c_str()) > IPP_STATUS_OK_IGNORED_OR_SUBSTITUTED)
+    {
+        static ErrorMessage errorMsg = "Error on cupsFinishDocument";
+        return &errorMsg;
+    }
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::printBatch(std::string_view name, const std::string &jobName, const std::vector<BatchDocument> &documents, int &jobId, OperationContext *context)
+{
+    if (documents.empty())
+    {
+        static ErrorMessage errorMsg = "Batch has no documents";
+        return &errorMsg;
+    }
+
+    http_t *http = getConnectionPool().acquire(context);
+    if (http == NULL)
+    {
+        static ErrorMessage errorMsg = "Could not connect to the CUPS server";
+        return &errorMsg;
+    }
+
+    std::string printer(name);
+    ErrorMessage *errorMessage = NULL;
+
+    // One Create-Job, then a Send-Document per document with last-document on the final one
+    {
+        OperationTimeout timeout(http, context);
+        jobId = cupsCreateJob(http, printer.c_str(), jobName.c_str(), 0, NULL);
+        if (jobId == 0)
+        {
+            static ErrorMessage errorMsg = "Error on cupsCreateJob";
+            errorMessage = &errorMsg;
+        }
+
+        for (size_t i = 0; errorMessage == NULL && i < documents.size(); i++)
+        {
+            errorMessage = sendBatchDocument(http, printer, jobId, documents[i], resolveType(documents[i].type, documents[i].data),
+                                             i + 1 == documents.size(), context);
+        }
+    }
+
+    getConnectionPool().release(http, errorMessage == NULL);
+
+    // Never leave a job waiting for its last document
+    if (errorMessage != NULL && jobId != 0)
+    {
+        PrintJob job;
+        job.id = jobId;
+        job.printer = printer;
+        cancelJob(job);
+    }
+
+    return errorMessage;
+}
+
+ErrorMessage *PrinterManager::cancelJob(PrintJob &job)
+{
+    // Dropping the connection aborts the Send-Document in progress
+    if (job.handle != NULL)
+    {
+        getConnectionPool().release((http_t *)job.handle, false);
+        job.handle = NULL;
+    }
+
+    if (job.id == 0)
+    {
+        return NULL;
+    }
+
+    OperationContext limit;
+    limit.setTimeout(CLEANUP_TIMEOUT_MS);
+    PooledConnection http(&limit);
+    if (!http)
+    {
+        static ErrorMessage errorMsg = "Could not connect to the CUPS server";
+        return &errorMsg;
+    }
+
+    if (cupsCancelJob2(http, job.printer.c_str(), job.id, 0) != IPP_STATUS_OK)
+    {
+        static ErrorMessage errorMsg = "Error on cupsCancelJob";
+        return &errorMsg;
+    }
+
+    return NULL;
+}
+
+// Fills buffer unless the file ends first, -1 on a read error
+static ssize_t ReadChunk(int fd, char *buffer, size_t size)
+{
+    size_t length = 0;
+    while (length < size)
+    {
+        ssize_t count = read(fd, buffer + length, size - length);
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count < 0)
+        {
+            return -1;
+        }
+        if (count == 0)
+        {
+            break;
+        }
+        length += (size_t)count;
+    }
+    return (ssize_t)length;
+}
+
+ErrorMessage *PrinterManager::printFile(std::string_view name, const std::string &path, const std::string &docName, const std::string &type, int &jobId, OperationContext *context)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        static ErrorMessage errorMsg = "Could not open file";
+        return &errorMsg;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode))
+    {
+        close(fd);
+        static ErrorMessage errorMsg = "Could not stat file or it is not a regular file";
+        return &errorMsg;
+    }
+
+    // Stream the file through a fixed buffer like the Windows backend. A mapping would save the
+    // copy, but a file truncated while it prints would raise SIGBUS in the whole process; a read
+    // only fails this call. The first chunk is larger than SNIFF_BYTES, it picks an AUTO type
+    std::unique_ptr<char[]> buffer(new char[PRINT_CHUNK_SIZE]);
+    ssize_t length = ReadChunk(fd, buffer.get(), PRINT_CHUNK_SIZE);
+    if (length < 0)
+    {
+        close(fd);
+        static ErrorMessage errorMsg = "Error on reading file";
+        return &errorMsg;
+    }
+
+    PrintJob job;
+    ErrorMessage *errorMessage = startJob(name, docName, resolveType(type, std::string_view(buffer.get(), (size_t)length)), job, context);
+    if (errorMessage != NULL)
+    {
+        close(fd);
+        return errorMessage;
+    }
+    jobId = job.id;
+
+    while (length > 0)
+    {
+        errorMessage = writeJob(job, std::string_view(buffer.get(), (size_t)length), context);
+        if (errorMessage != NULL)
+        {
+            close(fd);
+            cancelJob(job);
+            return errorMessage;
+        }
+        length = ReadChunk(fd, buffer.get(), PRINT_CHUNK_SIZE);
+    }
+    close(fd);
+
+    if (length < 0)
+    {
+        cancelJob(job);
+        static ErrorMessage errorMsg = "Error on reading file";
+        return &errorMsg;
+    }
+
+    errorMessage = endJob(job, context);
+    // Same as printDirect: do not leave half a job behind
+    if (errorMessage != NULL && ((context != NULL && context->stopped()) || job.handle != NULL))
+    {
+        cancelJob(job);
+    }
+
+    return errorMessage;
+}
+
+// Lease asked for the notification subscription, renewed while the watch is open so a crashed
+// process does not leave subscriptions behind in cupsd for long
+static const int WATCH_LEASE_SECONDS = 300;
+// Upper bound between two Get-Notifications when cupsd answers without waiting for events
+static const int WATCH_MAX_INTERVAL_MS = 1000;
+
+static const char *const WATCH_EVENTS[] = {
+    "job-state-changed",
+    "job-progress",
+    "printer-state-changed",
+    "printer-config-changed",
+    "printer-added",
+    "printer-deleted",
+};
+
+/**
+ * Backend state of a PrinterWatch. The subscription is polled over a
+ * connection of its own, outside the pool, since a Get-Notifications with
+ * notify-wait may be held open by the server until events arrive.
+ * Only the watch thread uses the connection: interruptWatch just sets the
+ * flag, which the connection's httpSetTimeout callback checks every
+ * OPERATION_POLL_SECONDS to make a held request give up.
+ */
+struct CupsWatch
+{
+    http_t *http = NULL;
+    std::string uri;
+    int subscriptionId = 0;
+    int sequence = 1;
+    time_t renewAt = 0;
+
+    std::mutex mutex;
+    std::condition_variable wakeup;
+};
+
+ipp_t *NewSubscriptionRequest(ipp_op_t op, const CupsWatch &cupsWatch)
+{
+    ipp_t *request = ippNewRequest(op);
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_URI, "printer-uri", NULL, cupsWatch.uri.c_str());
+    ippAddString(request, IPP_TAG_OPERATION, IPP_TAG_NAME, "requesting-user-name", NULL, cupsUser());
+    return request;
+}
+
+// httpSetTimeout callback of a watch connection: 0 makes the blocked request fail once interrupted
+static int WatchTimeoutCallback(http_t *, void *watch)
+{
+    return ((PrinterWatch *)watch)->interrupted ? 0 : 1;
+}
+
+// The subscription request of openWatch, which also gives up after CLEANUP_TIMEOUT_MS
+struct SubscribeLimit
+{
+    PrinterWatch *watch;
+    OperationContext context;
+};
+
+static int SubscribeTimeoutCallback(http_t *, void *subscribe)
+{
+    SubscribeLimit *limit = (SubscribeLimit *)subscribe;
+    return limit->watch->interrupted || limit->context.stopped() ? 0 : 1;
+}
+
+ErrorMessage *PrinterManager::openWatch(std::string_view name, PrinterWatch &watch)
+{
+    CupsWatch *cupsWatch = new CupsWatch();
+
+    cupsWatch->http = httpConnect2(cupsServer(), ippPort(), NULL, AF_UNSPEC, cupsEncryption(), 1, CONNECT_TIMEOUT_MS, NULL);
+    if (cupsWatch->http == NULL)
+    {
+        delete cupsWatch;
+        static ErrorMessage errorMsg = "Could not connect to the CUPS server";
+        return &errorMsg;
+    }
+
+    // A subscription on the server URI reports the events of every queue
+    std::string printerName(name);
+    if (printerName.empty())
+    {
+        cupsWatch->uri = getServerUri("/");
+    }
+    else
+    {
+        cupsWatch->uri = getPrinterUri(printerName);
+    }
+
+    ipp_t *request = NewSubscriptionRequest(IPP_OP_CREATE_PRINTER_SUBSCRIPTIONS, *cupsWatch);
+    ippAddString(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_KEYWORD, "notify-pull-method", NULL, "ippget");
+    ippAddStrings(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_KEYWORD, "notify-events",
+                  (int)(sizeof(WATCH_EVENTS) / sizeof(WATCH_EVENTS[0])), NULL, WATCH_EVENTS);
+    ippAddInteger(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER, "notify-lease-duration", WATCH_LEASE_SECONDS);
+
+    SubscribeLimit limit;
+    limit.watch = &watch;
+    limit.context.setTimeout(CLEANUP_TIMEOUT_MS);
+    httpSetTimeout(cupsWatch->http, OPERATION_POLL_SECONDS, SubscribeTimeoutCallback, &limit);
+
+    ipp_t *response = cupsDoRequest(cupsWatch->http, request, "/");
+    ipp_attribute_t *attr = response != NULL ? ippFindAttribute(response, "notify-subscription-id", IPP_TAG_INTEGER) : NULL;
+    if (response == NULL || ippGetStatusCode(response) > IPP_STATUS_OK_IGNORED_OR_SUBSTITUTED || attr == NULL)
+    {
+        ippDelete(response);
+        httpClose(cupsWatch->http);
+        delete cupsWatch;
+        static ErrorMessage errorMsg = "Error on Create-Printer-Subscriptions";
+        return &errorMsg;
+    }
+
+    cupsWatch->subscriptionId = ippGetInteger(attr, 0);
+    cupsWatch->renewAt = time(NULL) + WATCH_LEASE_SECONDS / 2;
+    ippDelete(response);
+
+    watch.name = name;
+    watch.handle = cupsWatch;
+    httpSetTimeout(cupsWatch->http, OPERATION_POLL_SECONDS, WatchTimeoutCallback, &watch);
+
+    return NULL;
+}
+
+// Fill events from the event notification groups of a Get-Notifications response.
+// Returns the sequence number of the last event seen.
+int ParseEventNotifications(ipp_t *response, std::vector<PrinterEvent> &events)
+{
+    int sequence = 0;
+    PrinterEvent *event = NULL;
+
+    for (ipp_attribute_t *attr = ippFirstAttribute(response); attr != NULL; attr = ippNextAttribute(response))
+    {
+        const char *name = ippGetName(attr);
+
+        // Every notification is a group of its own, a separator or another group tag ends it
+        if (name == NULL || ippGetGroupTag(attr) != IPP_TAG_EVENT_NOTIFICATION)
+        {
+            event = NULL;
+            continue;
+        }
+
+        if (event == NULL)
+        {
+            events.emplace_back();
+            event = &events.back();
+        }
+
+        if (strcmp(name, "notify-sequence-number") == 0)
+        {
+            sequence = std::max(sequence, ippGetInteger(attr, 0));
+        }
+        else if (strcmp(name, "notify-subscribed-event") == 0)
+        {
+            const char *keyword = ippGetString(attr, 0, NULL);
+            event->event = keyword != NULL ? keyword : "";
+        }
+        else if (strcmp(name, "printer-name") == 0)
+        {
+            const char *printer = ippGetString(attr, 0, NULL);
+            event->printer = printer != NULL ? printer : "";
+        }
+        else if (strcmp(name, "printer-state") == 0)
+        {
+            const char *state = ippEnumString("printer-state", ippGetInteger(attr, 0));
+            event->state = state != NULL ? state : "";
+        }
+        else if (strcmp(name, "printer-state-reasons") == 0)
+        {
+            for (int i = 0; i < ippGetCount(attr); i++)
+            {
+                const char *reason = ippGetString(attr, i, NULL);
+                if (reason != NULL)
+                {
+                    event->statusArray.push_back(reason);
+                }
+            }
+        }
+        else
+        {
+            ParseJobAttribute(attr, name, event->job);
+        }
+    }
+
+    // Job events carry the printer state too, only keep what belongs to the event
+    for (PrinterEvent &parsed : events)
+    {
+        if (parsed.event.compare(0, 4, "job-") == 0)
+        {
+            parsed.job.name = parsed.printer;
+            parsed.state.clear();
+            parsed.statusArray.clear();
+        }
+        else
+        {
+            parsed.job = JobInfo();
+        }
+    }
+
+    return sequence;
+}
+
+ErrorMessage *PrinterManager::waitWatch(PrinterWatch &watch, std::vector<PrinterEvent> &events)
+{
+    CupsWatch *cupsWatch = (CupsWatch *)watch.handle;
+    if (cupsWatch == NULL)
+    {
+        static ErrorMessage errorMsg = "Watch is closed";
+        return &errorMsg;
+    }
+
+    while (!watch.interrupted)
+    {
+        if (time(NULL) >= cupsWatch->renewAt)
+        {
+            ipp_t *request = NewSubscriptionRequest(IPP_OP_RENEW_SUBSCRIPTION, *cupsWatch);
+            ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-subscription-id", cupsWatch->subscriptionId);
+            ippAddInteger(request, IPP_TAG_SUBSCRIPTION, IPP_TAG_INTEGER, "notify-lease-duration", WATCH_LEASE_SECONDS);
+
+            ipp_t *response = cupsDoRequest(cupsWatch->http, request, "/");
+            bool renewed = response != NULL && ippGetStatusCode(response) <= IPP_STATUS_OK_IGNORED_OR_SUBSTITUTED;
+            ippDelete(response);
+            if (watch.interrupted)
+            {
+                break;
+            }
+            if (!renewed)
+            {
+                static ErrorMessage errorMsg = "Error on Renew-Subscription";
+                return &errorMsg;
+            }
+            cupsWatch->renewAt = time(NULL) + WATCH_LEASE_SECONDS / 2;
+        }
+
+        ipp_t *request = NewSubscriptionRequest(IPP_OP_GET_NOTIFICATIONS, *cupsWatch);
+        ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-subscription-ids", cupsWatch->subscriptionId);
+        ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-sequence-numbers", cupsWatch->sequence);
+        ippAddBoolean(request, IPP_TAG_OPERATION, "notify-wait", 1);
+
+        ipp_t *response = cupsDoRequest(cupsWatch->http, request, "/");
+        if (watch.interrupted)
+        {
+            ippDelete(response);
+            break;
+        }
+        if (response == NULL || ippGetStatusCode(response) > IPP_STATUS_OK_EVENTS_COMPLETE)
+        {
+            ippDelete(response);
+            static ErrorMessage errorMsg = "Error on Get-Notifications";
+            return &errorMsg;
+        }
+
+        int sequence = ParseEventNotifications(response, events);
+
+        // The subscription is gone (printer deleted, lease lost), report the last events first
+        if (ippGetStatusCode(response) == IPP_STATUS_OK_EVENTS_COMPLETE && events.empty())
+        {
+            ippDelete(response);
+            static ErrorMessage errorMsg = "Printer subscription ended";
+            return &errorMsg;
+        }
+        if (sequence >= cupsWatch->sequence)
+        {
+            cupsWatch->sequence = sequence + 1;
+        }
+
+        int intervalMs = WATCH_MAX_INTERVAL_MS;
+        if (ipp_attribute_t *attr = ippFindAttribute(response, "notify-get-interval", IPP_TAG_INTEGER))
+        {
+            intervalMs = std::min(intervalMs, ippGetInteger(attr, 0) * 1000);
+        }
+        ippDelete(response);
+
+        if (!events.empty())
+        {
+            return NULL;
+        }
+
+        std::unique_lock<std::mutex> lock(cupsWatch->mutex);
+        cupsWatch->wakeup.wait_for(lock, std::chrono::milliseconds(intervalMs), [&watch]
+                                   { return watch.interrupted.load(); });
+    }
+
+    return NULL;
+}
+
+void PrinterManager::interruptWatch(PrinterWatch &watch)
+{
+    CupsWatch *cupsWatch = (CupsWatch *)watch.handle;
+    if (cupsWatch == NULL)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(cupsWatch->mutex);
+        watch.interrupted = true;
+    }
+    cupsWatch->wakeup.notify_all();
+}
+
+ErrorMessage *PrinterManager::closeWatch(PrinterWatch &watch)
+{
+    CupsWatch *cupsWatch = (CupsWatch *)watch.handle;
+    if (cupsWatch == NULL)
+    {
+        return NULL;
+    }
+    watch.handle = NULL;
+
+    httpClose(cupsWatch->http);
+
+    // The watch connection may have been shut down, cancel over a fresh one
+    bool cancelled = false;
+    OperationContext limit;
+    limit.setTimeout(CLEANUP_TIMEOUT_MS);
+    PooledConnection http(&limit);
+    if (http)
+    {
+        ipp_t *request = NewSubscriptionRequest(IPP_OP_CANCEL_SUBSCRIPTION, *cupsWatch);
+        ippAddInteger(request, IPP_TAG_OPERATION, IPP_TAG_INTEGER, "notify-subscription-id", cupsWatch->subscriptionId);
+
+        ipp_t *response = cupsDoRequest(http, request, "/");
+        cancelled = response != NULL && ippGetStatusCode(response) <= IPP_STATUS_OK_IGNORED_OR_SUBSTITUTED;
+        ippDelete(response);
+    }
+
+    delete cupsWatch;
+
+    if (!cancelled)
+    {
+        static ErrorMessage errorMsg = "Error on Cancel-Subscription";
+        return &errorMsg;
+    }
+
+    return NULL;
+}
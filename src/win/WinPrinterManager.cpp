@@ -10,6 +10,11 @@
 #include <utility>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <memory>
+
+// Documents are handed to the spooler in pieces of this size.
+static const size_t PRINT_CHUNK_SIZE = 64 * 1024;
 
 struct PrinterHandle
 {
@@ -36,6 +41,40 @@ struct PrinterHandle
     BOOL _ok;
 };
 
+/**
+ * UTF-16 copy of a UTF-8 string for the W spooler calls. Printer names fit the
+ * inline buffer, only longer strings are allocated.
+ */
+class WideString
+{
+public:
+    explicit WideString(std::string_view str)
+    {
+        _data = _inline;
+        int length = str.empty() ? 0 : MultiByteToWideChar(CP_UTF8, 0, str.data(), (int)str.size(), NULL, 0);
+        if (length >= MAX_PATH)
+        {
+            _heap.reset(new wchar_t[length + 1]);
+            _data = _heap.get();
+        }
+        if (length > 0)
+        {
+            MultiByteToWideChar(CP_UTF8, 0, str.data(), (int)str.size(), _data, length);
+        }
+        _data[length] = L'\0';
+    }
+
+    WideString(const WideString &) = delete;
+    WideString &operator=(const WideString &) = delete;
+
+    LPWSTR get() { return _data; }
+
+private:
+    wchar_t _inline[MAX_PATH];
+    std::unique_ptr<wchar_t[]> _heap;
+    wchar_t *_data;
+};
+
 std::string LPWSTRToString(const wchar_t *wstr)
 {
     if (wstr == NULL)
@@ -47,9 +86,11 @@ std::string LPWSTRToString(const wchar_t *wstr)
         return std::string("");
     }
 
+    // size_needed counts the terminator, which std::string keeps on its own
     int size_needed = WideCharToMultiByte(CP_UTF8, 0, wstr, -1, NULL, 0, NULL, NULL);
     std::string strTo(size_needed, 0);
     WideCharToMultiByte(CP_UTF8, 0, wstr, -1, &strTo[0], size_needed, NULL, NULL);
+    strTo.resize(size_needed - 1);
 
     return strTo;
 }
@@ -419,7 +460,7 @@ std::vector<std::string> getStatusArray(DWORD status)
 // *                        PrinterManager Implementation
 // * ___________________________________________________________________________
 
-ErrorMessage *PrinterManager::getDefaultPrinterName(PrinterName &printerName)
+ErrorMessage *PrinterManager::getDefaultPrinterName(PrinterName &printerName, OperationContext *context)
 {
     DWORD cSize = 0;
     GetDefaultPrinterW(NULL, &cSize);
@@ -446,25 +487,40 @@ ErrorMessage *PrinterManager::getDefaultPrinterName(PrinterName &printerName)
         return &errorMsg;
     }
 
-    std::string result = LPWSTRToString(reinterpret_cast<const wchar_t *>(bPrinterName.get()));
-    printerName = std::wstring(result.begin(), result.end());
+    printerName = LPWSTRToString(reinterpret_cast<const wchar_t *>(bPrinterName.get()));
 
     return NULL;
 }
 
-ErrorMessage *PrinterManager::getOneJob(PrinterName name, int jobId, JobInfo &jobInfo)
+void ParseJobObject(JOB_INFO_2W *job, JobInfo &jobInfo)
 {
+    // pStatus
+    // A pointer to a null-terminated string that specifies the status of the print job.
+    // This member should be checked prior to Status and, if pStatus is NULL, the status is defined by the contents of the Status member.
 
-    PrinterHandle printerHandle((LPWSTR)name.c_str());
+    std::vector<std::string> statusArray;
 
-    if (!printerHandle)
+    if (job->pStatus == NULL)
     {
-        static ErrorMessage errorMsg = "Could not open printer ";
-        return &errorMsg;
+        statusArray = getStatusArray(job->Status);
     }
 
+    jobInfo.id = job->JobId;
+    jobInfo.name = LPWSTRToString(job->pPrinterName);
+    jobInfo.user = LPWSTRToString(job->pUserName);
+    jobInfo.priority = job->Priority;
+    jobInfo.size = job->Size;
+    jobInfo.status = LPWSTRToString(job->pStatus);
+    jobInfo.statusArray = statusArray;
+    jobInfo.position = job->Position;
+    jobInfo.totalPages = job->TotalPages;
+    jobInfo.pagesPrinted = job->PagesPrinted;
+}
+
+ErrorMessage *getJobFromHandle(HANDLE printerHandle, int jobId, JobInfo &jobInfo)
+{
     DWORD sizeBytes = 0, dummyBytes = 0;
-    GetJobW(*printerHandle, static_cast<DWORD>(jobId), 2, NULL, sizeBytes, &sizeBytes);
+    GetJobW(printerHandle, static_cast<DWORD>(jobId), 2, NULL, sizeBytes, &sizeBytes);
     MemValue<JOB_INFO_2W> job(sizeBytes);
 
     if (!job)
@@ -473,32 +529,89 @@ ErrorMessage *PrinterManager::getOneJob(PrinterName name, int jobId, JobInfo &jo
         return &errorMsg;
     }
 
-    BOOL bOK = GetJobW(*printerHandle, static_cast<DWORD>(jobId), 2, (LPBYTE)job.get(), sizeBytes, &dummyBytes);
+    BOOL bOK = GetJobW(printerHandle, static_cast<DWORD>(jobId), 2, (LPBYTE)job.get(), sizeBytes, &dummyBytes);
     if (!bOK)
     {
         static ErrorMessage errorMsg = "Error on GetJob. Wrong job id or it was deleted";
         return &errorMsg;
     }
-    // pStatus
-    // A pointer to a null-terminated string that specifies the status of the print job.
-    // This member should be checked prior to Status and, if pStatus is NULL, the status is defined by the contents of the Status member.
 
-    std::vector<std::string> statusArray;
+    ParseJobObject(job.get(), jobInfo);
 
-    if (job->pStatus == NULL)
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::getOneJob(std::string_view name, int jobId, JobInfo &jobInfo, OperationContext *context)
+{
+
+    WideString printerName(name);
+    PrinterHandle printerHandle(printerName.get());
+
+    if (!printerHandle)
     {
-        statusArray = getStatusArray(job->Status);
+        static ErrorMessage errorMsg = "Could not open printer ";
+        return &errorMsg;
     }
 
-    jobInfo.name = LPWSTRToString(job->pPrinterName);
-    jobInfo.user = LPWSTRToString(job->pUserName);
-    jobInfo.priority = job->Priority;
-    jobInfo.size = job->Size;
-    jobInfo.status = LPWSTRToString(job->pStatus);
-    jobInfo.statusArray = statusArray;
-    jobInfo.position = job->Position;
-    jobInfo.totalPages = job->TotalPages;
-    jobInfo.pagesPrinted = job->PagesPrinted;
+    return getJobFromHandle(*printerHandle, jobId, jobInfo);
+}
+
+ErrorMessage *PrinterManager::getJobs(std::string_view name, const std::vector<int> &jobIds, std::vector<JobInfo> &jobsInfo, OperationContext *context)
+{
+    WideString printerName(name);
+    PrinterHandle printerHandle(printerName.get());
+    if (!printerHandle)
+    {
+        static ErrorMessage errorMsg = "Could not open printer";
+        return &errorMsg;
+    }
+
+    // One EnumJobs for the whole queue instead of a GetJob per id
+    DWORD sizeBytes = 0, jobsCount = 0;
+    EnumJobsW(printerHandle, 0, MAXDWORD, 2, NULL, 0, &sizeBytes, &jobsCount);
+    if (sizeBytes == 0)
+    {
+        return NULL;
+    }
+
+    MemValue<JOB_INFO_2W> jobs(sizeBytes);
+    if (!jobs)
+    {
+        static ErrorMessage errorMsg = "Error on allocating memory for jobs";
+        return &errorMsg;
+    }
+
+    if (!EnumJobsW(printerHandle, 0, MAXDWORD, 2, (LPBYTE)jobs.get(), sizeBytes, &sizeBytes, &jobsCount))
+    {
+        static ErrorMessage errorMsg = "Error on EnumJobs";
+        return &errorMsg;
+    }
+
+    std::map<int, JOB_INFO_2W *> jobsById;
+    for (DWORD i = 0; i < jobsCount; i++)
+    {
+        jobsById[(int)jobs.get()[i].JobId] = &jobs.get()[i];
+    }
+
+    if (jobIds.empty())
+    {
+        for (std::map<int, JOB_INFO_2W *>::value_type &job : jobsById)
+        {
+            jobsInfo.emplace_back();
+            ParseJobObject(job.second, jobsInfo.back());
+        }
+        return NULL;
+    }
+
+    for (int jobId : jobIds)
+    {
+        std::map<int, JOB_INFO_2W *>::iterator job = jobsById.find(jobId);
+        if (job != jobsById.end())
+        {
+            jobsInfo.emplace_back();
+            ParseJobObject(job->second, jobsInfo.back());
+        }
+    }
 
     return NULL;
 }
@@ -518,37 +631,71 @@ std::vector<std::string> getAttributeArray(DWORD attributes)
     return result;
 }
 
-void ParsePrinterObject(PRINTER_INFO_2W *printer, PrinterInfo &printerInfo)
+void ParsePrinterObject(PRINTER_INFO_2W *printer, PrinterInfo &printerInfo, unsigned fields)
 {
+    printerInfo.fields = fields;
     printerInfo.name = LPWSTRToString(printer->pPrinterName);
-    printerInfo.server = LPWSTRToString(printer->pServerName);
-    printerInfo.shareName = LPWSTRToString(printer->pShareName);
-    printerInfo.portName = LPWSTRToString(printer->pPortName);
-    printerInfo.driverName = LPWSTRToString(printer->pDriverName);
-    printerInfo.location = LPWSTRToString(printer->pLocation);
-    printerInfo.comment = LPWSTRToString(printer->pComment);
     printerInfo.status = printer->Status;
-    printerInfo.statusArray = getStatusArray(printer->Status);
     printerInfo.attributes = printer->Attributes;
-    printerInfo.attributeArray = getAttributeArray(printer->Attributes);
     printerInfo.averagePPM = printer->AveragePPM;
     printerInfo.cJobs = printer->cJobs;
     printerInfo.defaultPriority = printer->DefaultPriority;
     printerInfo.startTime = printer->StartTime;
     printerInfo.untilTime = printer->UntilTime;
+
+    // Strings and flag arrays are only converted when asked for
+    if (fields & PRINTER_FIELD_SERVER)
+    {
+        printerInfo.server = LPWSTRToString(printer->pServerName);
+    }
+    if (fields & PRINTER_FIELD_SHARE_NAME)
+    {
+        printerInfo.shareName = LPWSTRToString(printer->pShareName);
+    }
+    if (fields & PRINTER_FIELD_PORT_NAME)
+    {
+        printerInfo.portName = LPWSTRToString(printer->pPortName);
+    }
+    if (fields & PRINTER_FIELD_DRIVER_NAME)
+    {
+        printerInfo.driverName = LPWSTRToString(printer->pDriverName);
+    }
+    if (fields & PRINTER_FIELD_LOCATION)
+    {
+        printerInfo.location = LPWSTRToString(printer->pLocation);
+    }
+    if (fields & PRINTER_FIELD_COMMENT)
+    {
+        printerInfo.comment = LPWSTRToString(printer->pComment);
+    }
+    if (fields & PRINTER_FIELD_STATUS_ARRAY)
+    {
+        printerInfo.statusArray = getStatusArray(printer->Status);
+    }
+    if (fields & PRINTER_FIELD_ATTRIBUTE_ARRAY)
+    {
+        printerInfo.attributeArray = getAttributeArray(printer->Attributes);
+    }
 }
 
-ErrorMessage *PrinterManager::getOnePrinter(PrinterName name, PrinterInfo &printerInfo)
+void ParsePrinterObject(PRINTER_INFO_4W *printer, PrinterInfo &printerInfo, unsigned fields)
 {
+    printerInfo.fields = fields;
+    printerInfo.name = LPWSTRToString(printer->pPrinterName);
+    printerInfo.server = LPWSTRToString(printer->pServerName);
+    printerInfo.attributes = printer->Attributes;
 
-    PrinterHandle printerHandle((LPWSTR)name.c_str());
-
-    if (!printerHandle)
+    if (fields & PRINTER_FIELD_ATTRIBUTE_ARRAY)
     {
-        static ErrorMessage errorMsg = "Could not open printer";
-        return &errorMsg;
+        printerInfo.attributeArray = getAttributeArray(printer->Attributes);
     }
+}
 
+// Level 4 is read from the registry without asking the drivers, good enough when only these fields are wanted
+static const unsigned PRINTER_INFO_4_FIELDS = PRINTER_FIELD_NAME | PRINTER_FIELD_SERVER | PRINTER_FIELD_ATTRIBUTE_ARRAY;
+
+ErrorMessage *getPrinterFromHandle(HANDLE printerHandle, PrinterInfo &printerInfo, unsigned fields = PRINTER_FIELDS_ALL)
+{
     DWORD sizeBytes = 0, dummyBytes = 0;
     GetPrinterW(printerHandle, 2, NULL, 0, &sizeBytes);
 
@@ -567,29 +714,127 @@ ErrorMessage *PrinterManager::getOnePrinter(PrinterName name, PrinterInfo &print
         return &errorMsg;
     }
 
-    ParsePrinterObject(printer.get(), printerInfo);
+    ParsePrinterObject(printer.get(), printerInfo, fields);
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::getOnePrinter(std::string_view name, PrinterInfo &printerInfo, unsigned fields, OperationContext *context)
+{
+
+    WideString printerName(name);
+    PrinterHandle printerHandle(printerName.get());
+
+    if (!printerHandle)
+    {
+        static ErrorMessage errorMsg = "Could not open printer";
+        return &errorMsg;
+    }
+
+    return getPrinterFromHandle(printerHandle, printerInfo, fields);
+}
+
+ErrorMessage *PrinterManager::openPrinter(std::string_view name, OpenedPrinter &printer, OperationContext *context)
+{
+    if (context != NULL && context->stopped())
+    {
+        return context->error();
+    }
+
+    // Not a PrinterHandle: the handle stays open until closePrinter
+    HANDLE printerHandle = NULL;
+    WideString printerName(name);
+    if (!OpenPrinterW(printerName.get(), &printerHandle, NULL))
+    {
+        static ErrorMessage errorMsg = "Could not open printer";
+        return &errorMsg;
+    }
+
+    printer.info = PrinterInfo();
+    ErrorMessage *errorMessage = getPrinterFromHandle(printerHandle, printer.info);
+    if (errorMessage != NULL)
+    {
+        ClosePrinter(printerHandle);
+        return errorMessage;
+    }
+
+    printer.name = name;
+    printer.handle = printerHandle;
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::refreshPrinter(OpenedPrinter &printer, OperationContext *context)
+{
+    std::lock_guard<std::mutex> guard(printer.lock);
+
+    // winspool calls cannot be interrupted, the context is only checked before
+    if (context != NULL && context->stopped())
+    {
+        return context->error();
+    }
+
+    if (printer.handle == NULL)
+    {
+        static ErrorMessage errorMsg = "Printer is closed";
+        return &errorMsg;
+    }
+
+    PrinterInfo printerInfo;
+    ErrorMessage *errorMessage = getPrinterFromHandle((HANDLE)printer.handle, printerInfo);
+    if (errorMessage == NULL)
+    {
+        printer.info = printerInfo;
+    }
+
+    return errorMessage;
+}
+
+ErrorMessage *PrinterManager::closePrinter(OpenedPrinter &printer)
+{
+    std::lock_guard<std::mutex> guard(printer.lock);
+
+    if (printer.handle != NULL)
+    {
+        ClosePrinter((HANDLE)printer.handle);
+        printer.handle = NULL;
+    }
 
     return NULL;
 }
 
-ErrorMessage *PrinterManager::getPrinters(std::vector<PrinterInfo> &printersInfo)
+ErrorMessage *PrinterManager::getOneJob(OpenedPrinter &printer, int jobId, JobInfo &jobInfo, OperationContext *context)
+{
+    std::lock_guard<std::mutex> guard(printer.lock);
+
+    if (printer.handle == NULL)
+    {
+        static ErrorMessage errorMsg = "Printer is closed";
+        return &errorMsg;
+    }
+
+    return getJobFromHandle((HANDLE)printer.handle, jobId, jobInfo);
+}
+
+ErrorMessage *PrinterManager::getPrinters(std::vector<PrinterInfo> &printersInfo, unsigned fields, OperationContext *context)
 {
 
     DWORD printers_size = 0;
     DWORD printers_size_bytes = 0, dummyBytes = 0;
     DWORD flags = PRINTER_ENUM_LOCAL | PRINTER_ENUM_CONNECTIONS;
+    DWORD level = (fields & ~PRINTER_INFO_4_FIELDS) == 0 ? 4 : 2;
 
     // Get required buffer size
-    EnumPrintersW(flags, NULL, 2, NULL, 0, &printers_size_bytes, &printers_size);
+    EnumPrintersW(flags, NULL, level, NULL, 0, &printers_size_bytes, &printers_size);
 
-    MemValue<PRINTER_INFO_2W> printers(printers_size_bytes);
+    MemValue<BYTE> printers(printers_size_bytes);
     if (!printers)
     {
         static ErrorMessage errorMsg = "Failed to allocate memory for printers";
         return &errorMsg;
     }
 
-    BOOL bError = EnumPrintersW(flags, NULL, 2, (LPBYTE)(printers.get()),
+    BOOL bError = EnumPrintersW(flags, NULL, level, printers.get(),
                                 printers_size_bytes, &dummyBytes, &printers_size);
 
     if (!bError)
@@ -598,68 +843,345 @@ ErrorMessage *PrinterManager::getPrinters(std::vector<PrinterInfo> &printersInfo
         return &errorMsg;
     }
 
-    PRINTER_INFO_2W *printer = printers.get();
+    printersInfo.reserve(printersInfo.size() + printers_size);
 
-    for (DWORD i = 0; i < printers_size; ++i, ++printer)
+    for (DWORD i = 0; i < printers_size; ++i)
     {
         PrinterInfo printerInfo;
-        ParsePrinterObject(printer, printerInfo);
+        if (level == 4)
+        {
+            ParsePrinterObject((PRINTER_INFO_4W *)printers.get() + i, printerInfo, fields);
+        }
+        else
+        {
+            ParsePrinterObject((PRINTER_INFO_2W *)printers.get() + i, printerInfo, fields);
+        }
         printersInfo.push_back(printerInfo);
     }
 
     return NULL;
 }
 
-ErrorMessage *PrinterManager::printDirect(PrinterName name, std::string docName, std::string type, std::string data, int &jobId)
+std::string PrinterManager::getSniffedType(DocumentFormat format)
 {
+    // Without a data type for the printer language itself, the print processor passes RAW through
+    return "RAW";
+}
 
-    PrinterHandle printerHandle((LPWSTR)name.c_str());
+ErrorMessage *PrinterManager::startJob(std::string_view name, const std::string &docName, const std::string &type, PrintJob &job, OperationContext *context)
+{
+    // winspool calls cannot be interrupted, the context is checked between them
+    if (context != NULL && context->stopped())
+    {
+        return context->error();
+    }
 
-    if (!printerHandle)
+    // Not a PrinterHandle: the handle has to stay open until endJob/cancelJob
+    HANDLE printer = NULL;
+    WideString printerName(name);
+    if (!OpenPrinterW(printerName.get(), &printer, NULL))
     {
         static ErrorMessage errorMsg = "Could not open printer ";
         return &errorMsg;
     }
 
-    std::wstring docNameWide(docName.begin(), docName.end());
-    std::wstring typeWide(type.begin(), type.end());
+    WideString docNameWide(docName);
+    // Streamed data can not be sniffed before StartDocPrinter, AUTO is RAW here anyway
+    WideString typeWide(isAutoType(type) ? getSniffedType(FORMAT_UNKNOWN) : type);
 
     DOC_INFO_1W DocInfo;
-    DocInfo.pDocName = (LPWSTR)docNameWide.c_str();
+    DocInfo.pDocName = docNameWide.get();
     DocInfo.pOutputFile = NULL;
     // RAW format: A data type consisting of PDL data that can be sent to a device without further processing.
     // https://learn.microsoft.com/en-us/openspecs/windows_protocols/ms-rprn/e81cbc09-ab05-4a32-ae4a-8ec57b436c43#Appendix_A_211
-    DocInfo.pDatatype = (LPWSTR)typeWide.c_str();
+    DocInfo.pDatatype = typeWide.get();
 
-    jobId = StartDocPrinterW(*printerHandle, 1, (LPBYTE)&DocInfo);
-    if (jobId == 0)
+    if (context != NULL && context->stopped())
     {
+        ClosePrinter(printer);
+        return context->error();
+    }
+
+    job.id = StartDocPrinterW(printer, 1, (LPBYTE)&DocInfo);
+    if (job.id == 0)
+    {
+        ClosePrinter(printer);
         static ErrorMessage errorMsg = "StartDocPrinter error: ";
         return &errorMsg;
     }
 
-    if (!StartPagePrinter(*printerHandle))
+    if (!StartPagePrinter(printer))
     {
+        AbortPrinter(printer);
+        ClosePrinter(printer);
         static ErrorMessage errorMsg = "StartPagePrinter error: ";
         return &errorMsg;
     }
 
-    DWORD bytesWritten = 0;
-    BOOL success = WritePrinter(*printerHandle, (LPVOID)data.c_str(),
-                                (DWORD)data.size(), &bytesWritten);
+    job.printer = std::string(name);
+    job.handle = printer;
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::writeJob(PrintJob &job, std::string_view data, OperationContext *context)
+{
+    if (job.handle == NULL)
+    {
+        static ErrorMessage errorMsg = "Print job is not open";
+        return &errorMsg;
+    }
+
+    // Hand the document to the spooler in chunks instead of a single WritePrinter call
+    for (size_t offset = 0; offset < data.size(); offset += PRINT_CHUNK_SIZE)
+    {
+        if (context != NULL && context->stopped())
+        {
+            return context->error();
+        }
+
+        DWORD chunkSize = (DWORD)(std::min)(PRINT_CHUNK_SIZE, data.size() - offset);
+        DWORD bytesWritten = 0;
+        if (!WritePrinter((HANDLE)job.handle, (LPVOID)(data.data() + offset), chunkSize, &bytesWritten) ||
+            bytesWritten != chunkSize)
+        {
+            static ErrorMessage errorMsg = "Failed to write all data to printer";
+            return &errorMsg;
+        }
+    }
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::endJob(PrintJob &job, OperationContext *context)
+{
+    if (job.handle == NULL)
+    {
+        static ErrorMessage errorMsg = "Print job is not open";
+        return &errorMsg;
+    }
+
+    // Close the PJL job a ticket opened, the job stays open for cancelJob when that fails
+    ErrorMessage *errorMessage = writeJob(job, job.epilogue, context);
+    if (errorMessage != NULL)
+    {
+        return errorMessage;
+    }
+    job.epilogue.clear();
+
+    HANDLE printer = (HANDLE)job.handle;
+    EndPagePrinter(printer);
+    BOOL success = EndDocPrinter(printer);
+    ClosePrinter(printer);
+    job.handle = NULL;
+
+    if (!success)
+    {
+        static ErrorMessage errorMsg = "EndDocPrinter error: ";
+        return &errorMsg;
+    }
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::printBatch(std::string_view name, const std::string &jobName, const std::vector<BatchDocument> &documents, int &jobId, OperationContext *context)
+{
+    if (documents.empty())
+    {
+        static ErrorMessage errorMsg = "Batch has no documents";
+        return &errorMsg;
+    }
+
+    // The data type is set once per StartDocPrinter
+    std::string type = resolveType(documents[0].type, documents[0].data);
+    for (const BatchDocument &document : documents)
+    {
+        if (resolveType(document.type, document.data) != type)
+        {
+            static ErrorMessage errorMsg = "Documents of a batch must share one type";
+            return &errorMsg;
+        }
+    }
+
+    PrintJob job;
+    ErrorMessage *errorMessage = startJob(name, jobName, type, job, context);
+    if (errorMessage != NULL)
+    {
+        return errorMessage;
+    }
+    jobId = job.id;
+
+    // startJob opened the first page, every further document gets a page of its own
+    for (size_t i = 0; i < documents.size(); i++)
+    {
+        if (i > 0 && (!EndPagePrinter((HANDLE)job.handle) || !StartPagePrinter((HANDLE)job.handle)))
+        {
+            cancelJob(job);
+            static ErrorMessage errorMsg = "StartPagePrinter error: ";
+            return &errorMsg;
+        }
+
+        errorMessage = writeJob(job, documents[i].data, context);
+        if (errorMessage != NULL)
+        {
+            cancelJob(job);
+            return errorMessage;
+        }
+    }
+
+    return endJob(job, context);
+}
 
-    EndPagePrinter(*printerHandle);
-    EndDocPrinter(*printerHandle);
+ErrorMessage *PrinterManager::cancelJob(PrintJob &job)
+{
+    if (job.handle == NULL)
+    {
+        return NULL;
+    }
+
+    HANDLE printer = (HANDLE)job.handle;
+    BOOL success = AbortPrinter(printer);
+    ClosePrinter(printer);
+    job.handle = NULL;
 
-    if (!success || bytesWritten != data.size())
+    if (!success)
     {
-        static ErrorMessage errorMsg = "Failed to write all data to printer";
+        static ErrorMessage errorMsg = "AbortPrinter error: ";
         return &errorMsg;
     }
 
     return NULL;
 }
 
+ErrorMessage *PrinterManager::getPrinterChangeTimes(PrinterChangeTimes &changeTimes, OperationContext *context)
+{
+    // PRINTER_INFO_2 carries no change time, cached entries just expire
+    static ErrorMessage errorMsg = "Printer change times are not available on this platform";
+    return &errorMsg;
+}
+
+bool PrinterManager::hasPrinterChangeTimes()
+{
+    return false;
+}
+
+ErrorMessage *PrinterManager::printDirect(OpenedPrinter &printer, const std::string &docName, const std::string &type, std::string_view data, int &jobId, OperationContext *context)
+{
+    // One document at a time on the shared handle
+    std::lock_guard<std::mutex> guard(printer.lock);
+
+    if (printer.handle == NULL)
+    {
+        static ErrorMessage errorMsg = "Printer is closed";
+        return &errorMsg;
+    }
+
+    if (context != NULL && context->stopped())
+    {
+        return context->error();
+    }
+
+    HANDLE printerHandle = (HANDLE)printer.handle;
+
+    WideString docNameWide(docName);
+    WideString typeWide(resolveType(type, data));
+
+    DOC_INFO_1W DocInfo;
+    DocInfo.pDocName = docNameWide.get();
+    DocInfo.pOutputFile = NULL;
+    DocInfo.pDatatype = typeWide.get();
+
+    jobId = StartDocPrinterW(printerHandle, 1, (LPBYTE)&DocInfo);
+    if (jobId == 0)
+    {
+        static ErrorMessage errorMsg = "StartDocPrinter error: ";
+        return &errorMsg;
+    }
+
+    if (!StartPagePrinter(printerHandle))
+    {
+        AbortPrinter(printerHandle);
+        static ErrorMessage errorMsg = "StartPagePrinter error: ";
+        return &errorMsg;
+    }
+
+    // Borrow the handle for the chunked writer, it is not closed by this job
+    PrintJob job;
+    job.id = jobId;
+    job.handle = printerHandle;
+    ErrorMessage *errorMessage = writeJob(job, data, context);
+    if (errorMessage != NULL)
+    {
+        AbortPrinter(printerHandle);
+        return errorMessage;
+    }
+
+    EndPagePrinter(printerHandle);
+    if (!EndDocPrinter(printerHandle))
+    {
+        static ErrorMessage errorMsg = "EndDocPrinter error: ";
+        return &errorMsg;
+    }
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::printFile(std::string_view name, const std::string &path, const std::string &docName, const std::string &type, int &jobId, OperationContext *context)
+{
+    WideString pathWide(path);
+
+    HANDLE file = CreateFileW(pathWide.get(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        static ErrorMessage errorMsg = "Could not open file";
+        return &errorMsg;
+    }
+
+    PrintJob job;
+    ErrorMessage *errorMessage = startJob(name, docName, type, job, context);
+    if (errorMessage != NULL)
+    {
+        CloseHandle(file);
+        return errorMessage;
+    }
+    jobId = job.id;
+
+    // Stream the file through a fixed buffer, its size never matters
+    MemValue<char> buffer(PRINT_CHUNK_SIZE);
+    if (!buffer)
+    {
+        CloseHandle(file);
+        cancelJob(job);
+        static ErrorMessage errorMsg = "Error on allocating memory for file buffer";
+        return &errorMsg;
+    }
+
+    DWORD bytesRead = 0;
+    BOOL readOk = FALSE;
+    while ((readOk = ReadFile(file, buffer.get(), (DWORD)PRINT_CHUNK_SIZE, &bytesRead, NULL)) && bytesRead > 0)
+    {
+        errorMessage = writeJob(job, std::string_view(buffer.get(), bytesRead), context);
+        if (errorMessage != NULL)
+        {
+            CloseHandle(file);
+            cancelJob(job);
+            return errorMessage;
+        }
+    }
+
+    if (!readOk)
+    {
+        CloseHandle(file);
+        cancelJob(job);
+        static ErrorMessage errorMsg = "Error on reading file";
+        return &errorMsg;
+    }
+    CloseHandle(file);
+
+    return endJob(job, context);
+}
+
 ErrorMessage *PrinterManager::getSupportedPrintFormats(std::vector<std::string> &dataTypes)
 {
 
@@ -702,10 +1224,11 @@ ErrorMessage *PrinterManager::getSupportedPrintFormats(std::vector<std::string>
     return NULL;
 }
 
-ErrorMessage *PrinterManager::getPrinterDevMode(const std::wstring &printerName, PrinterDevMode &pDevMode)
+ErrorMessage *PrinterManager::getPrinterDevMode(std::string_view printerName, PrinterDevMode &pDevMode)
 {
 
-    PrinterHandle printerHandle((LPWSTR)printerName.c_str());
+    WideString printerNameWide(printerName);
+    PrinterHandle printerHandle(printerNameWide.get());
 
     if (!printerHandle)
     {
@@ -743,7 +1266,7 @@ ErrorMessage *PrinterManager::getPrinterDevMode(const std::wstring &printerName,
         return &errorMsg;
     }
 
-    pDevMode.deviceName = printerName;
+    pDevMode.deviceName = std::string(printerName);
     pDevMode.paperSize = getPaperSizeName(pInfo->pDevMode->dmPaperSize);
 
     // dmPaperSize This member must be zero if the length and width of the paper are specified by the dmPaperLength and dmPaperWidth members.
@@ -763,3 +1286,290 @@ ErrorMessage *PrinterManager::getPrinterDevMode(const std::wstring &printerName,
 
     return NULL;
 }
+
+// Fields reported with every job and printer change notification
+static WORD WATCH_JOB_FIELDS[] = {
+    JOB_NOTIFY_FIELD_PRINTER_NAME,
+    JOB_NOTIFY_FIELD_USER_NAME,
+    JOB_NOTIFY_FIELD_STATUS,
+    JOB_NOTIFY_FIELD_STATUS_STRING,
+    JOB_NOTIFY_FIELD_PRIORITY,
+    JOB_NOTIFY_FIELD_POSITION,
+    JOB_NOTIFY_FIELD_TOTAL_PAGES,
+    JOB_NOTIFY_FIELD_PAGES_PRINTED,
+    JOB_NOTIFY_FIELD_TOTAL_BYTES,
+};
+
+static WORD WATCH_PRINTER_FIELDS[] = {
+    PRINTER_NOTIFY_FIELD_PRINTER_NAME,
+    PRINTER_NOTIFY_FIELD_STATUS,
+};
+
+/**
+ * Backend state of a PrinterWatch: a change notification on the printer (or
+ * on the local print server when every printer is watched) and the event
+ * interruptWatch signals to wake up a pending wait.
+ */
+struct WinWatch
+{
+    HANDLE printer = NULL;
+    HANDLE change = INVALID_HANDLE_VALUE;
+    HANDLE wakeup = NULL;
+};
+
+void getWatchOptions(PRINTER_NOTIFY_OPTIONS_TYPE types[2], PRINTER_NOTIFY_OPTIONS &options, DWORD flags)
+{
+    types[0].Type = JOB_NOTIFY_TYPE;
+    types[0].Count = sizeof(WATCH_JOB_FIELDS) / sizeof(WATCH_JOB_FIELDS[0]);
+    types[0].pFields = WATCH_JOB_FIELDS;
+    types[1].Type = PRINTER_NOTIFY_TYPE;
+    types[1].Count = sizeof(WATCH_PRINTER_FIELDS) / sizeof(WATCH_PRINTER_FIELDS[0]);
+    types[1].pFields = WATCH_PRINTER_FIELDS;
+
+    options.Version = 2;
+    options.Flags = flags;
+    options.Count = 2;
+    options.pTypes = types;
+}
+
+// Printer status flags folded into the IPP printer-state keywords CUPS reports
+std::string getPrinterState(DWORD status)
+{
+    if (status & (PRINTER_STATUS_PAUSED | PRINTER_STATUS_ERROR | PRINTER_STATUS_OFFLINE | PRINTER_STATUS_NOT_AVAILABLE))
+    {
+        return "stopped";
+    }
+    if (status & (PRINTER_STATUS_PRINTING | PRINTER_STATUS_PROCESSING | PRINTER_STATUS_BUSY))
+    {
+        return "processing";
+    }
+    return "idle";
+}
+
+// One event per job or printer found in the notification data
+void ParseNotifyInfo(PRINTER_NOTIFY_INFO *info, const std::string &watchedPrinter, std::vector<PrinterEvent> &events)
+{
+    size_t first = events.size();
+    std::map<std::pair<WORD, DWORD>, size_t> index;
+
+    for (DWORD i = 0; i < info->Count; i++)
+    {
+        const PRINTER_NOTIFY_INFO_DATA &data = info->aData[i];
+        bool isJob = data.Type == JOB_NOTIFY_TYPE;
+
+        std::pair<std::map<std::pair<WORD, DWORD>, size_t>::iterator, bool> found =
+            index.insert(std::make_pair(std::make_pair(data.Type, data.Id), events.size()));
+        if (found.second)
+        {
+            events.emplace_back();
+            events.back().event = isJob ? "job-state-changed" : "printer-state-changed";
+            events.back().job.id = isJob ? (int)data.Id : 0;
+        }
+        PrinterEvent &event = events[found.first->second];
+
+        const wchar_t *text = (const wchar_t *)data.NotifyData.Data.pBuf;
+        DWORD value = data.NotifyData.adwData[0];
+
+        if (isJob)
+        {
+            switch (data.Field)
+            {
+            case JOB_NOTIFY_FIELD_PRINTER_NAME:
+                event.printer = LPWSTRToString(text);
+                break;
+            case JOB_NOTIFY_FIELD_USER_NAME:
+                event.job.user = LPWSTRToString(text);
+                break;
+            case JOB_NOTIFY_FIELD_STATUS:
+                event.job.statusArray = getStatusArray(value);
+                break;
+            case JOB_NOTIFY_FIELD_STATUS_STRING:
+                event.job.status = LPWSTRToString(text);
+                break;
+            case JOB_NOTIFY_FIELD_PRIORITY:
+                event.job.priority = (int)value;
+                break;
+            case JOB_NOTIFY_FIELD_POSITION:
+                event.job.position = (int)value;
+                break;
+            case JOB_NOTIFY_FIELD_TOTAL_PAGES:
+                event.job.totalPages = (int)value;
+                break;
+            case JOB_NOTIFY_FIELD_PAGES_PRINTED:
+                event.job.pagesPrinted = (int)value;
+                break;
+            case JOB_NOTIFY_FIELD_TOTAL_BYTES:
+                event.job.size = (int)value;
+                break;
+            }
+        }
+        else
+        {
+            switch (data.Field)
+            {
+            case PRINTER_NOTIFY_FIELD_PRINTER_NAME:
+                event.printer = LPWSTRToString(text);
+                break;
+            case PRINTER_NOTIFY_FIELD_STATUS:
+                event.state = getPrinterState(value);
+                event.statusArray = getStatusArray(value);
+                break;
+            }
+        }
+    }
+
+    for (size_t i = first; i < events.size(); i++)
+    {
+        if (events[i].printer.empty())
+        {
+            events[i].printer = watchedPrinter;
+        }
+        if (events[i].job.id != 0)
+        {
+            events[i].job.name = events[i].printer;
+        }
+    }
+}
+
+ErrorMessage *PrinterManager::openWatch(std::string_view name, PrinterWatch &watch)
+{
+    WinWatch *winWatch = new WinWatch();
+
+    // A handle to the local print server reports the changes of every printer
+    WideString printerName(name);
+    if (!OpenPrinterW(name.empty() ? NULL : printerName.get(), &winWatch->printer, NULL))
+    {
+        delete winWatch;
+        static ErrorMessage errorMsg = "Could not open printer";
+        return &errorMsg;
+    }
+
+    PRINTER_NOTIFY_OPTIONS_TYPE types[2];
+    PRINTER_NOTIFY_OPTIONS options;
+    getWatchOptions(types, options, 0);
+
+    winWatch->change = FindFirstPrinterChangeNotification(winWatch->printer, PRINTER_CHANGE_JOB | PRINTER_CHANGE_PRINTER, 0, &options);
+    winWatch->wakeup = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (winWatch->change == INVALID_HANDLE_VALUE || winWatch->wakeup == NULL)
+    {
+        if (winWatch->change != INVALID_HANDLE_VALUE)
+        {
+            FindClosePrinterChangeNotification(winWatch->change);
+        }
+        if (winWatch->wakeup != NULL)
+        {
+            CloseHandle(winWatch->wakeup);
+        }
+        ClosePrinter(winWatch->printer);
+        delete winWatch;
+        static ErrorMessage errorMsg = "FindFirstPrinterChangeNotification error";
+        return &errorMsg;
+    }
+
+    watch.name = name;
+    watch.handle = winWatch;
+
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::waitWatch(PrinterWatch &watch, std::vector<PrinterEvent> &events)
+{
+    WinWatch *winWatch = (WinWatch *)watch.handle;
+    if (winWatch == NULL)
+    {
+        static ErrorMessage errorMsg = "Watch is closed";
+        return &errorMsg;
+    }
+
+    const std::string &watchedPrinter = watch.name;
+    HANDLE handles[2] = {winWatch->change, winWatch->wakeup};
+
+    while (!watch.interrupted)
+    {
+        DWORD result = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+        if (watch.interrupted)
+        {
+            break;
+        }
+        if (result != WAIT_OBJECT_0)
+        {
+            static ErrorMessage errorMsg = "WaitForMultipleObjects error";
+            return &errorMsg;
+        }
+
+        DWORD change = 0;
+        PRINTER_NOTIFY_INFO *info = NULL;
+        if (!FindNextPrinterChangeNotification(winWatch->change, &change, NULL, (LPVOID *)&info))
+        {
+            static ErrorMessage errorMsg = "FindNextPrinterChangeNotification error";
+            return &errorMsg;
+        }
+
+        // The spooler dropped notifications, ask for the current state of everything instead
+        if (info != NULL && (info->Flags & PRINTER_NOTIFY_INFO_DISCARDED))
+        {
+            FreePrinterNotifyInfo(info);
+            info = NULL;
+
+            PRINTER_NOTIFY_OPTIONS_TYPE types[2];
+            PRINTER_NOTIFY_OPTIONS options;
+            getWatchOptions(types, options, PRINTER_NOTIFY_OPTIONS_REFRESH);
+            DWORD refreshChange = 0;
+            FindNextPrinterChangeNotification(winWatch->change, &refreshChange, &options, (LPVOID *)&info);
+        }
+
+        if (change & PRINTER_CHANGE_ADD_PRINTER)
+        {
+            events.emplace_back();
+            events.back().event = "printer-added";
+        }
+        if (change & PRINTER_CHANGE_DELETE_PRINTER)
+        {
+            events.emplace_back();
+            events.back().event = "printer-deleted";
+            events.back().printer = watchedPrinter;
+        }
+
+        if (info != NULL)
+        {
+            ParseNotifyInfo(info, watchedPrinter, events);
+            FreePrinterNotifyInfo(info);
+        }
+
+        if (!events.empty())
+        {
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+void PrinterManager::interruptWatch(PrinterWatch &watch)
+{
+    WinWatch *winWatch = (WinWatch *)watch.handle;
+    if (winWatch == NULL)
+    {
+        return;
+    }
+
+    watch.interrupted = true;
+    SetEvent(winWatch->wakeup);
+}
+
+ErrorMessage *PrinterManager::closeWatch(PrinterWatch &watch)
+{
+    WinWatch *winWatch = (WinWatch *)watch.handle;
+    if (winWatch == NULL)
+    {
+        return NULL;
+    }
+    watch.handle = NULL;
+
+    FindClosePrinterChangeNotification(winWatch->change);
+    CloseHandle(winWatch->wakeup);
+    ClosePrinter(winWatch->printer);
+    delete winWatch;
+
+    return NULL;
+}
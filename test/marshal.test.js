@@ -0,0 +1,73 @@
+import { test } from 'node:test';
+import assert from 'node:assert/strict';
+import { createRequire } from 'module';
+const require = createRequire(import.meta.url);
+
+const printer = require('../lib/printer.cjs');
+
+const PRINTER_KEYS = ['name', 'server', 'shareName', 'portName', 'driverName', 'location', 'comment', 'status',
+    'statusArray', 'attributeArray', 'averagePPM', 'cJobs', 'defaultPriority', 'startTime', 'untilTime'];
+const JOB_KEYS = ['id', 'name', 'user', 'priority', 'size', 'status', 'position', 'totalPages', 'pagesPrinted'];
+
+function firstPrinterName() {
+    const printers = printer.getPrinters({ fields: ['name'] });
+    return printers.length > 0 ? printers[0].name : null;
+}
+
+test('getPrinters marshals every property', () => {
+    const printers = printer.getPrinters();
+    assert.ok(Array.isArray(printers));
+    for (const info of printers) {
+        assert.deepEqual(Object.keys(info), PRINTER_KEYS);
+        assert.equal(typeof info.name, 'string');
+        assert.ok(Array.isArray(info.statusArray));
+    }
+});
+
+test('fields set only the requested properties', async () => {
+    for (const info of printer.getPrinters({ fields: ['name', 'status'] })) {
+        assert.deepEqual(Object.keys(info), ['name', 'status']);
+    }
+    for (const info of await printer.getPrintersAsync({ fields: ['location'] })) {
+        assert.deepEqual(Object.keys(info), ['location']);
+    }
+});
+
+test('getPrinter and Printer.info marshal the same object', (t) => {
+    const name = firstPrinterName();
+    if (name === null) {
+        t.skip('no printer installed');
+        return;
+    }
+
+    const info = printer.getPrinter(name);
+    assert.deepEqual(Object.keys(info), PRINTER_KEYS);
+
+    const device = printer.openPrinter(name);
+    try {
+        assert.deepEqual(Object.keys(device.info()), PRINTER_KEYS);
+    } finally {
+        device.close();
+    }
+});
+
+test('getJobs and getJob marshal jobs', async (t) => {
+    const name = firstPrinterName();
+    if (name === null) {
+        t.skip('no printer installed');
+        return;
+    }
+
+    const jobs = printer.getJobs(name);
+    assert.ok(Array.isArray(jobs));
+    for (const job of jobs) {
+        assert.deepEqual(Object.keys(job), JOB_KEYS);
+    }
+    if (jobs.length === 0) {
+        t.diagnostic('no job kept by the spooler, getJob not exercised');
+        return;
+    }
+
+    assert.deepEqual(Object.keys(printer.getJob(name, jobs[0].id)), JOB_KEYS);
+    assert.deepEqual(Object.keys(await printer.getJobAsync(name, jobs[0].id)), JOB_KEYS);
+});
@@ -0,0 +1,22 @@
+import { test } from 'node:test';
+import assert from 'node:assert/strict';
+import { spawnSync } from 'node:child_process';
+import { existsSync } from 'node:fs';
+import { fileURLToPath } from 'node:url';
+
+// Built with the addon by node-gyp rebuild -- -Dnative_tests=1, see the test script in package.json
+const BUILD = fileURLToPath(new URL('../build/Release/', import.meta.url));
+
+for (const name of ['native_tests', 'native_tests_scalar']) {
+    const binary = BUILD + name + (process.platform === 'win32' ? '.exe' : '');
+
+    test(name, (t) => {
+        assert.ok(existsSync(binary), `${name} is not built, run npm test`);
+
+        const result = spawnSync(binary, { encoding: 'utf8' });
+        for (const line of result.stdout.split('\n').filter((line) => line.length > 0)) {
+            t.diagnostic(line);
+        }
+        assert.equal(result.status, 0, result.stderr);
+    });
+}
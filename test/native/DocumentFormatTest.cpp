@@ -0,0 +1,99 @@
+#include "NativeTest.hpp"
+#include "../../src/DocumentFormat.hpp"
+
+#include <string>
+#include <string_view>
+
+static const struct
+{
+    const char *name;
+    std::string_view data;
+    DocumentFormat format;
+} SNIFFER_CASES[] = {
+    {"empty", "", FORMAT_UNKNOWN},
+    {"plain text", "Hello printer\r\n", FORMAT_UNKNOWN},
+    {"pdf", "%PDF-1.7\n%\xE2\xE3\xCF\xD3\n", FORMAT_PDF},
+    {"pdf behind junk", "\xEF\xBB\xBF garbage\n%PDF-1.4\n", FORMAT_PDF},
+    {"postscript", "%!PS-Adobe-3.0\n", FORMAT_POSTSCRIPT},
+    {"postscript after ctrl-d", "\x04%!PS\n", FORMAT_POSTSCRIPT},
+    {"pwg raster", "RaS2PwgRaster", FORMAT_PWG_RASTER},
+    {"urf", std::string_view("UNIRAST\0\0\0\0\x01", 12), FORMAT_URF},
+    {"pcl xl", ") HP-PCL XL;2;0\r\n", FORMAT_PCLXL},
+    {"pcl5 reset", "\x1B" "E\x1B&l0O", FORMAT_PCL5},
+    {"pcl5 parameterized", "\x1B&l1O\x1B(s0P", FORMAT_PCL5},
+    {"escpos init", "\x1B@Receipt\n\x1D" "V\x00", FORMAT_ESCPOS},
+    {"escpos emphasis", std::string_view("\x1B" "E\x01" "Bold", 7), FORMAT_ESCPOS},
+    {"escpos emphasis with cut", "\x1B" "E1Total\n\x1D" "V1", FORMAT_ESCPOS},
+    {"escpos cut only", "Receipt\n\x1D" "V\x42", FORMAT_ESCPOS},
+    {"zpl", "^XA^FO50,50^FDHello^FS^XZ", FORMAT_ZPL},
+    {"zpl with utf-8", "^XA^CI28^FD\xC3\xA9t\xC3\xA9^FS^XZ", FORMAT_ZPL},
+    {"pjl only", "\x1B%-12345X@PJL INFO STATUS\r\n", FORMAT_PJL},
+    {"pjl unknown data", "\x1B%-12345X@PJL JOB\r\nplain\r\n", FORMAT_PJL},
+    {"pjl enter pcl", "\x1B%-12345X@PJL\r\n@PJL ENTER LANGUAGE=PCL\r\n\x1B" "E", FORMAT_PCL5},
+    {"pjl enter pclxl", "\x1B%-12345X@PJL ENTER LANGUAGE = PCLXL\r\n) HP-PCL XL", FORMAT_PCLXL},
+    {"pjl enter postscript", "\x1B%-12345X@pjl enter language=postscript\n", FORMAT_POSTSCRIPT},
+    {"pjl before pdf", "\x1B%-12345X@PJL SET COPIES=2\r\n%PDF-1.5\n", FORMAT_PDF},
+};
+
+TEST(sniffsTheTable)
+{
+    for (const auto &testCase : SNIFFER_CASES)
+    {
+        DocumentFormat format = sniffDocumentFormat(testCase.data);
+        if (format != testCase.format)
+        {
+            reportFailure(__FILE__, __LINE__, std::string(testCase.name) + ": got " + getDocumentFormatName(format) +
+                                                  ", expected " + getDocumentFormatName(testCase.format));
+        }
+    }
+}
+
+// Every position of the 16 byte blocks and of the scalar tail counts a control byte
+TEST(countsControlBytesAtEveryOffset)
+{
+    const std::string label = "^XA^FO50,50^FDA long enough field to span a few blocks^FS^XZ";
+    CHECK_EQUAL(sniffDocumentFormat(label), FORMAT_ZPL);
+
+    for (size_t i = 0; i < label.size(); i++)
+    {
+        std::string binary = label;
+        binary[i] = '\x01';
+        if (binary.find("^XA") != std::string::npos)
+        {
+            CHECK_EQUAL(sniffDocumentFormat(binary), FORMAT_UNKNOWN);
+        }
+
+        std::string highBytes = label;
+        highBytes[i] = '\xFF';
+        if (highBytes.find("^XA") != std::string::npos)
+        {
+            CHECK_EQUAL(sniffDocumentFormat(highBytes), FORMAT_ZPL);
+        }
+    }
+
+    const std::string receipt = "Receipt lines long enough to span a few blocks\n";
+    for (size_t i = 0; i + 2 <= receipt.size(); i++)
+    {
+        std::string cut = receipt;
+        cut.replace(i, 2, "\x1DV");
+        CHECK_EQUAL(sniffDocumentFormat(cut), FORMAT_ESCPOS);
+    }
+}
+
+TEST(sniffsOnlyTheFirstBytes)
+{
+    std::string late(SNIFF_BYTES, ' ');
+    late += "\x1B@";
+    CHECK_EQUAL(sniffDocumentFormat(late), FORMAT_UNKNOWN);
+
+    std::string early = "\x1B@" + std::string(SNIFF_BYTES, ' ');
+    CHECK_EQUAL(sniffDocumentFormat(early), FORMAT_ESCPOS);
+}
+
+TEST(autoTypeIsCaseInsensitive)
+{
+    CHECK(isAutoType("AUTO"));
+    CHECK(isAutoType("auto"));
+    CHECK(!isAutoType("AUTOMATIC"));
+    CHECK(!isAutoType("RAW"));
+}
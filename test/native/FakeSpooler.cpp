@@ -0,0 +1,74 @@
+#include "FakeSpooler.hpp"
+
+static const int FAKE_JOB_ID = 42;
+
+static FakeSpooler spooler;
+
+FakeSpooler &resetFakeSpooler()
+{
+    spooler = FakeSpooler();
+    return spooler;
+}
+
+const FakeSpooler &getFakeSpooler()
+{
+    return spooler;
+}
+
+static ErrorMessage *failed()
+{
+    static ErrorMessage errorMsg = "Fake spooler failure";
+    return &errorMsg;
+}
+
+ErrorMessage *PrinterManager::startJob(std::string_view name, const std::string &docName, const std::string &type, PrintJob &job, OperationContext *context)
+{
+    if (spooler.failOn == "startJob")
+    {
+        return failed();
+    }
+
+    spooler.type = type;
+    spooler.started = true;
+    job.id = FAKE_JOB_ID;
+    job.printer = std::string(name);
+    job.handle = &spooler;
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::writeJob(PrintJob &job, std::string_view data, OperationContext *context)
+{
+    if (spooler.failOn == "writeJob")
+    {
+        return failed();
+    }
+
+    spooler.data.append(data.data(), data.size());
+    return NULL;
+}
+
+// Like the backends: the epilogue of a ticket is written first, the job stays open when that fails
+ErrorMessage *PrinterManager::endJob(PrintJob &job, OperationContext *context)
+{
+    if (spooler.failOn == "endJob")
+    {
+        return failed();
+    }
+
+    spooler.data += job.epilogue;
+    spooler.ended = true;
+    job.handle = NULL;
+    return NULL;
+}
+
+ErrorMessage *PrinterManager::cancelJob(PrintJob &job)
+{
+    spooler.cancelled = true;
+    job.handle = NULL;
+    return NULL;
+}
+
+std::string PrinterManager::getSniffedType(DocumentFormat format)
+{
+    return isPrinterReadyFormat(format) ? "RAW" : getDocumentFormatName(format);
+}
@@ -0,0 +1,29 @@
+#ifndef FAKE_SPOOLER_HPP
+#define FAKE_SPOOLER_HPP
+
+#include "../../src/PrinterManager.hpp"
+
+#include <string>
+
+/**
+ * Stand-in for the platform backend (src/posix, src/win), so the platform
+ * independent PrinterManager code runs without a spooler. It records the
+ * last streaming job and fails the call named by failOn.
+ */
+struct FakeSpooler
+{
+    // Type startJob was given and every byte written, the ticket included
+    std::string type;
+    std::string data;
+    bool started = false;
+    bool ended = false;
+    bool cancelled = false;
+    // "startJob", "writeJob" or "endJob"
+    std::string failOn;
+};
+
+// Cleared by every call
+FakeSpooler &resetFakeSpooler();
+const FakeSpooler &getFakeSpooler();
+
+#endif
@@ -0,0 +1,239 @@
+#include "NativeTest.hpp"
+#include "../../src/Halftone.hpp"
+#include "../../src/RasterEncoder.hpp"
+
+#include <string>
+#include <vector>
+
+// Gray page of width x height filled with white
+struct GrayPage
+{
+    GrayPage(uint32_t width, uint32_t height) : pixels(width * height, '\xFF')
+    {
+        page.width = width;
+        page.height = height;
+        page.format = PIXEL_GRAY;
+    }
+
+    void set(uint32_t x, uint32_t y, uint8_t gray)
+    {
+        pixels[y * page.width + x] = (char)gray;
+    }
+
+    const RasterPage &get()
+    {
+        page.pixels = pixels;
+        return page;
+    }
+
+    std::string pixels;
+    RasterPage page;
+};
+
+static HalftoneOptions thresholdOptions(BitmapOutput output)
+{
+    HalftoneOptions options;
+    options.method = HALFTONE_THRESHOLD;
+    options.output = output;
+    return options;
+}
+
+// 40 pixels: two SSE2 blocks and a scalar tail of 8
+static GrayPage goldenPage()
+{
+    GrayPage page(40, 5);
+    // Rows 0 and 1 white
+    for (uint32_t x = 0; x < 8; x++)
+    {
+        page.set(x, 2, 0);
+    }
+    for (uint32_t x = 0; x < 40; x++)
+    {
+        page.set(x, 3, 0);
+    }
+    for (uint32_t x = 16; x < 24; x++)
+    {
+        page.set(x, 4, 0);
+    }
+    page.set(39, 4, 0);
+    return page;
+}
+
+TEST(rendersGoldenZpl)
+{
+    GrayPage page = goldenPage();
+    std::string output;
+    CHECK(renderBitmap(page.get(), thresholdOptions(BITMAP_ZPL), output) == NULL);
+    // White row, repeated row, FF then white, all black, 0000 FF 000 1
+    CHECK_EQUAL(output, "^XA^FO0,0^GFA,25,25,5,,:HF,!J0HFI01^FS^XZ");
+}
+
+TEST(compressesLongZplRuns)
+{
+    // 3520 pixels, 879 hex digits of F (400 + 400 + 60 + 19) and a 0 that the fill replaces
+    GrayPage page(3520, 1);
+    for (uint32_t x = 0; x < 3516; x++)
+    {
+        page.set(x, 0, 0);
+    }
+    std::string output;
+    CHECK(renderBitmap(page.get(), thresholdOptions(BITMAP_ZPL), output) == NULL);
+    CHECK_EQUAL(output, "^XA^FO0,0^GFA,440,440,440,zziYF,^FS^XZ");
+}
+
+TEST(rendersGoldenEscPos)
+{
+    GrayPage page = goldenPage();
+    std::string output;
+    CHECK(renderBitmap(page.get(), thresholdOptions(BITMAP_ESCPOS), output) == NULL);
+    std::string expected("\x1Dv0\x00\x05\x00\x05\x00", 8);
+    expected += std::string(10, '\0');
+    expected += std::string("\xFF\x00\x00\x00\x00", 5);
+    expected += std::string(5, '\xFF');
+    expected += std::string("\x00\x00\xFF\x00\x01", 5);
+    CHECK(output == expected);
+}
+
+TEST(splitsEscPosBands)
+{
+    GrayPage page(8, 300);
+    std::string output;
+    CHECK(renderBitmap(page.get(), thresholdOptions(BITMAP_ESCPOS), output) == NULL);
+    CHECK_EQUAL(output.size(), (size_t)8 + 256 + 8 + 44);
+    CHECK(output.compare(0, 8, std::string("\x1Dv0\x00\x01\x00\x00\x01", 8)) == 0);
+    CHECK(output.compare(264, 8, std::string("\x1Dv0\x00\x01\x00\x2C\x00", 8)) == 0);
+
+    GrayPage wide(0x10000 * 8, 1);
+    output.clear();
+    CHECK(renderBitmap(wide.get(), thresholdOptions(BITMAP_ESCPOS), output) != NULL);
+}
+
+// Every width up to a few blocks, against a pixel by pixel reference
+TEST(thresholdsLikeTheReference)
+{
+    for (uint32_t width = 1; width <= 70; width++)
+    {
+        GrayPage page(width, 9);
+        for (uint32_t y = 0; y < 9; y++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+            {
+                page.set(x, y, (uint8_t)((x * 37 + y * 101) & 0xFF));
+            }
+        }
+
+        for (HalftoneMethod method : {HALFTONE_THRESHOLD, HALFTONE_ORDERED})
+        {
+            HalftoneOptions options;
+            options.method = method;
+            options.threshold = 100;
+            Bitmap bitmap;
+            halftone(page.get(), options, bitmap);
+
+            int mismatches = 0;
+            for (uint32_t y = 0; y < 9; y++)
+            {
+                static const int BAYER_ROW[8][8] = {
+                    {0, 32, 8, 40, 2, 34, 10, 42}, {48, 16, 56, 24, 50, 18, 58, 26},
+                    {12, 44, 4, 36, 14, 46, 6, 38}, {60, 28, 52, 20, 62, 30, 54, 22},
+                    {3, 35, 11, 43, 1, 33, 9, 41}, {51, 19, 59, 27, 49, 17, 57, 25},
+                    {15, 47, 7, 39, 13, 45, 5, 37}, {63, 31, 55, 23, 61, 29, 53, 21}};
+                for (uint32_t x = 0; x < width; x++)
+                {
+                    int gray = (uint8_t)page.pixels[y * width + x];
+                    int level = method == HALFTONE_THRESHOLD ? 100 : BAYER_ROW[y & 7][x & 7] * 4 + 2;
+                    bool black = ((uint8_t)bitmap.bits[y * bitmap.bytesPerRow + x / 8] >> (7 - (x & 7))) & 1;
+                    mismatches += black != (gray < level);
+                }
+                // Padding bits stay white
+                for (uint32_t x = width; x < bitmap.bytesPerRow * 8; x++)
+                {
+                    mismatches += ((uint8_t)bitmap.bits[y * bitmap.bytesPerRow + x / 8] >> (7 - (x & 7))) & 1;
+                }
+            }
+            CHECK_EQUAL(mismatches, 0);
+        }
+    }
+}
+
+TEST(convertsColorToGray)
+{
+    // Opaque black, opaque white, transparent black (white paper), half transparent black
+    RasterPage page;
+    page.width = 4;
+    page.height = 1;
+    page.format = PIXEL_RGBA;
+    page.pixels = std::string_view("\x00\x00\x00\xFF\xFF\xFF\xFF\xFF\x00\x00\x00\x00\x00\x00\x00\x90", 16);
+
+    HalftoneOptions options;
+    options.method = HALFTONE_THRESHOLD;
+    Bitmap bitmap;
+    halftone(page, options, bitmap);
+    CHECK_EQUAL((int)(uint8_t)bitmap.bits[0], 0x90);
+}
+
+// halftone sees the gray levels that an sGray printRaster encodes
+TEST(sharesTheGrayOfRasterPages)
+{
+    std::string pixels;
+    for (int i = 0; i < 64; i++)
+    {
+        uint8_t rgba[4] = {(uint8_t)(i * 53), (uint8_t)(i * 97), (uint8_t)(i * 29), (uint8_t)(i * 71)};
+        pixels.append((const char *)rgba, 4);
+    }
+    RasterPage page;
+    page.width = 64;
+    page.height = 1;
+    page.format = PIXEL_RGBA;
+    page.pixels = pixels;
+
+    std::vector<uint8_t> line(64);
+    const uint8_t *gray = convertRasterRow(page, 0, RASTER_SGRAY, line.data());
+    for (int threshold = 1; threshold < 256; threshold++)
+    {
+        HalftoneOptions options;
+        options.method = HALFTONE_THRESHOLD;
+        options.threshold = threshold;
+        Bitmap bitmap;
+        halftone(page, options, bitmap);
+
+        int mismatches = 0;
+        for (uint32_t x = 0; x < 64; x++)
+        {
+            bool black = ((uint8_t)bitmap.bits[x / 8] >> (7 - (x & 7))) & 1;
+            mismatches += black != (gray[x] < threshold);
+        }
+        CHECK_EQUAL(mismatches, 0);
+    }
+}
+
+TEST(diffusesErrorToTheRightShare)
+{
+    for (int gray : {0, 64, 128, 192, 255})
+    {
+        GrayPage page(64, 64);
+        for (uint32_t y = 0; y < 64; y++)
+        {
+            for (uint32_t x = 0; x < 64; x++)
+            {
+                page.set(x, y, (uint8_t)gray);
+            }
+        }
+
+        HalftoneOptions options;
+        options.method = HALFTONE_FLOYD_STEINBERG;
+        Bitmap bitmap;
+        halftone(page.get(), options, bitmap);
+
+        int black = 0;
+        for (char byte : bitmap.bits)
+        {
+            for (int bit = 0; bit < 8; bit++)
+            {
+                black += ((uint8_t)byte >> bit) & 1;
+            }
+        }
+        int expected = 64 * 64 * (255 - gray) / 255;
+        CHECK(black >= expected - 64 && black <= expected + 64);
+    }
+}
@@ -0,0 +1,72 @@
+#include "NativeTest.hpp"
+#include "FakeSpooler.hpp"
+
+#include <string>
+
+static const std::string UEL = "\x1B%-12345X";
+
+static JobTicket duplexTicket()
+{
+    JobTicket ticket;
+    ticket.fields = TICKET_FIELD_COPIES | TICKET_FIELD_DUPLEX;
+    ticket.copies = 2;
+    ticket.duplex = VERTICAL;
+    ticket.jobName = "ticket \"test\"";
+    return ticket;
+}
+
+static const char PROLOGUE[] = "\x1B%-12345X@PJL JOB NAME=\"ticket test\"\r\n"
+                               "@PJL SET COPIES=2\r\n"
+                               "@PJL SET DUPLEX=ON\r\n@PJL SET BINDING=LONGEDGE\r\n";
+static const char EPILOGUE[] = "\x1B%-12345X@PJL EOJ NAME=\"ticket test\"\r\n\x1B%-12345X";
+
+// What PrintJob (createPrintStream) does: the type is not sniffed, the data comes later
+TEST(streamsAutoJobsWithATicket)
+{
+    resetFakeSpooler();
+    PrinterManager &printerManager = PrinterManager::getInstance();
+    PrintJob job;
+
+    CHECK(printerManager.startJob("printer", "doc", "AUTO", duplexTicket(), job, NULL) == NULL);
+    CHECK(printerManager.writeJob(job, "\x1B" "Epage\x0C") == NULL);
+    CHECK(printerManager.endJob(job) == NULL);
+
+    const FakeSpooler &spooler = getFakeSpooler();
+    CHECK_EQUAL(spooler.type, "RAW");
+    CHECK_EQUAL(spooler.data, std::string(PROLOGUE) + "\x1B" "Epage\x0C" + EPILOGUE);
+    CHECK(spooler.ended);
+    CHECK(!spooler.cancelled);
+}
+
+TEST(rejectsTicketsOnDocuments)
+{
+    resetFakeSpooler();
+    PrinterManager &printerManager = PrinterManager::getInstance();
+    PrintJob job;
+
+    CHECK(printerManager.startJob("printer", "doc", "application/pdf", duplexTicket(), job, NULL) != NULL);
+    CHECK(!getFakeSpooler().started);
+
+    // AUTO data is sniffed first, a PDF is no printer language
+    int jobId = 0;
+    CHECK(printerManager.printDirect("printer", "doc", "AUTO", duplexTicket(), "%PDF-1.7\n", jobId) != NULL);
+    CHECK(!getFakeSpooler().started);
+
+    CHECK(printerManager.printDirect("printer", "doc", "auto", duplexTicket(), "\x1B" "E", jobId) == NULL);
+    CHECK_EQUAL(getFakeSpooler().type, "RAW");
+    CHECK_EQUAL(jobId, 42);
+}
+
+TEST(cancelsTicketJobsLeftOpen)
+{
+    // The epilogue is not written, the job is still open and must not be left behind
+    resetFakeSpooler().failOn = "endJob";
+    int jobId = 0;
+    CHECK(PrinterManager::getInstance().printDirect("printer", "doc", "RAW", duplexTicket(), "data", jobId) != NULL);
+    CHECK(getFakeSpooler().cancelled);
+
+    resetFakeSpooler().failOn = "writeJob";
+    PrintJob job;
+    CHECK(PrinterManager::getInstance().startJob("printer", "doc", "RAW", duplexTicket(), job, NULL) != NULL);
+    CHECK(getFakeSpooler().cancelled);
+}
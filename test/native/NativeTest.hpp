@@ -0,0 +1,66 @@
+#ifndef NATIVE_TEST_HPP
+#define NATIVE_TEST_HPP
+
+#include "../../src/DocumentFormat.hpp"
+
+#include <cstdio>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Minimal test registry for the modules that need neither the addon nor a
+ * spooler. TEST(name) defines a case, CHECK and CHECK_EQUAL report a failed
+ * expectation and let the case go on. main.cpp runs every registered case.
+ */
+struct TestCase
+{
+    const char *name;
+    void (*run)();
+};
+
+std::vector<TestCase> &getTestCases();
+void reportFailure(const char *file, int line, const std::string &message);
+
+struct TestRegistration
+{
+    TestRegistration(const char *name, void (*run)())
+    {
+        getTestCases().push_back({name, run});
+    }
+};
+
+template <typename Actual, typename Expected>
+void checkEqual(const Actual &actual, const Expected &expected, const char *expression, const char *file, int line)
+{
+    if (!(actual == expected))
+    {
+        std::ostringstream message;
+        message << expression << ": got " << actual << ", expected " << expected;
+        reportFailure(file, line, message.str());
+    }
+}
+
+inline std::ostream &operator<<(std::ostream &stream, DocumentFormat format)
+{
+    return stream << getDocumentFormatName(format);
+}
+
+#define TEST(name)                                                \
+    static void name();                                           \
+    static TestRegistration name##Registration(#name, &name);     \
+    static void name()
+
+#define CHECK(condition)                                              \
+    do                                                                \
+    {                                                                 \
+        if (!(condition))                                             \
+        {                                                             \
+            reportFailure(__FILE__, __LINE__, "CHECK(" #condition ")"); \
+        }                                                             \
+    } while (0)
+
+#define CHECK_EQUAL(actual, expected) checkEqual((actual), (expected), #actual, __FILE__, __LINE__)
+
+#endif
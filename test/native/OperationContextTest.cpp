@@ -0,0 +1,50 @@
+#include "NativeTest.hpp"
+#include "../../src/PrinterManager.hpp"
+
+#include <string>
+#include <vector>
+
+// A coalesced job follows its calls: one call's short timeout must not stop the others
+TEST(followsTheLatestDeadline)
+{
+    OperationContext expired, later;
+    expired.setTimeout(0);
+    later.setTimeout(60000);
+
+    OperationContext job;
+    job.follow({&expired, &later});
+    CHECK(!job.stopped());
+    CHECK(job.error() == NULL);
+    CHECK(job.remainingMs(120000) > 50000);
+
+    OperationContext alsoExpired;
+    alsoExpired.setTimeout(0);
+    OperationContext lapsed;
+    lapsed.follow({&expired, &alsoExpired});
+    CHECK(lapsed.stopped());
+    CHECK_EQUAL(std::string(*lapsed.error()), "Operation timed out");
+}
+
+TEST(followsNoDeadlineWhenACallHasNone)
+{
+    OperationContext expired, unbounded;
+    expired.setTimeout(0);
+
+    OperationContext job;
+    job.follow({&expired, &unbounded});
+    CHECK(!job.stopped());
+    CHECK_EQUAL(job.remainingMs(1234), 1234);
+}
+
+TEST(followsCancellationOfEveryCall)
+{
+    OperationContext first, second;
+    OperationContext job;
+    job.follow({&first, &second});
+
+    first.cancel();
+    CHECK(!job.stopped());
+    second.cancel();
+    CHECK(job.stopped());
+    CHECK_EQUAL(std::string(*job.error()), "Operation aborted");
+}
@@ -0,0 +1,181 @@
+#include "NativeTest.hpp"
+#include "../../src/PageAnalyzer.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static const std::string UEL = "\x1B%-12345X";
+
+// A stream and the offsets its pages end at, as they are put together
+struct Stream
+{
+    std::string data;
+    std::vector<uint64_t> pageEnds;
+
+    Stream &add(std::string_view bytes)
+    {
+        data.append(bytes.data(), bytes.size());
+        return *this;
+    }
+
+    Stream &endPage()
+    {
+        pageEnds.push_back(data.size());
+        return *this;
+    }
+};
+
+static Stream pcl5Stream()
+{
+    Stream stream;
+    stream.add(UEL).add("@PJL SET DUPLEX=OFF\r\n@PJL ENTER LANGUAGE=PCL\r\n");
+    // A reset with nothing printed yet is no page
+    stream.add("\x1B" "E\x1B&l2X");
+    stream.add("First page, a line long enough for a few SSE2 blocks\r\n\x0C").endPage();
+    // Raster rows hold FF and ESC bytes, skipped by their length
+    stream.add("\x1B*r1A\x1B*b4W\x0C\x1B\x0C\x1B\x1B*rB");
+    stream.add("\x1B&l1S").endPage();
+    stream.add("Third page\x1B" "E").endPage();
+    // Form feed on a blank page
+    stream.add("\x0C");
+    stream.add("Tail without a form feed");
+    stream.endPage().add(UEL).add("@PJL EOJ\r\n").add(UEL);
+    return stream;
+}
+
+static std::string littleEndian(uint32_t value, size_t size)
+{
+    std::string bytes;
+    for (size_t i = 0; i < size; i++)
+    {
+        bytes.push_back((char)(value >> (8 * i)));
+    }
+    return bytes;
+}
+
+static Stream pclXlStream()
+{
+    Stream stream;
+    stream.add(UEL).add("@PJL SET QTY=3\r\n@PJL ENTER LANGUAGE=PCLXL\r\n");
+    stream.add(") HP-PCL XL;2;0;Comment\n");
+    // PageCopies 2, then BeginPage
+    stream.add("\xC0\x02\xF8\x31").add("\x43");
+    // Operands, embedded data and arrays holding EndPage bytes are skipped
+    stream.add("\xC1\x44\x44");
+    stream.add("\xFA").add(littleEndian(6, 4)).add("\x44\x44\x1B\x44\x44\x44");
+    stream.add("\xC8\xC0\x03\x44\x44\x44");
+    stream.add("\x44").endPage();
+    // DuplexPageMode
+    stream.add("\x43\xFB\x02\x44\x44\xC0\x01\xF8\x35");
+    stream.add("\x44").endPage();
+    stream.add(UEL).add("@PJL EOJ\r\n").add(UEL);
+    return stream;
+}
+
+static PageAnalysis analyze(const std::vector<std::string_view> &chunks)
+{
+    PageAnalyzer analyzer;
+    for (std::string_view chunk : chunks)
+    {
+        analyzer.feed(chunk);
+    }
+    return analyzer.finish();
+}
+
+static bool sameAnalysis(const PageAnalysis &a, const PageAnalysis &b)
+{
+    return a.language == b.language && a.pages == b.pages && a.copies == b.copies && a.duplex == b.duplex &&
+           a.pageEnds == b.pageEnds && a.bytes == b.bytes;
+}
+
+// Every split in two and three chunks, and one byte at a time, gives the same analysis
+static void checkChunkSplits(const std::string &data, const PageAnalysis &expected)
+{
+    std::string_view view(data);
+    int mismatches = 0;
+    for (size_t i = 0; i <= view.size(); i++)
+    {
+        mismatches += !sameAnalysis(analyze({view.substr(0, i), view.substr(i)}), expected);
+        for (size_t j = i; j <= view.size(); j++)
+        {
+            mismatches += !sameAnalysis(analyze({view.substr(0, i), view.substr(i, j - i), view.substr(j)}), expected);
+        }
+    }
+
+    std::vector<std::string_view> bytes;
+    for (size_t i = 0; i < view.size(); i++)
+    {
+        bytes.push_back(view.substr(i, 1));
+    }
+    mismatches += !sameAnalysis(analyze(bytes), expected);
+
+    CHECK_EQUAL(mismatches, 0);
+}
+
+TEST(countsPcl5Pages)
+{
+    Stream stream = pcl5Stream();
+    PageAnalysis analysis = analyze({stream.data});
+
+    CHECK_EQUAL(analysis.language, FORMAT_PCL5);
+    CHECK_EQUAL(analysis.pages, 4);
+    CHECK(analysis.pageEnds == stream.pageEnds);
+    CHECK_EQUAL(analysis.copies, 2);
+    CHECK(analysis.duplex);
+    CHECK_EQUAL(analysis.bytes, (uint64_t)stream.data.size());
+
+    checkChunkSplits(stream.data, analysis);
+}
+
+TEST(countsPclXlPages)
+{
+    Stream stream = pclXlStream();
+    PageAnalysis analysis = analyze({stream.data});
+
+    CHECK_EQUAL(analysis.language, FORMAT_PCLXL);
+    CHECK_EQUAL(analysis.pages, 2);
+    CHECK(analysis.pageEnds == stream.pageEnds);
+    CHECK_EQUAL(analysis.copies, 2);
+    CHECK(analysis.duplex);
+
+    checkChunkSplits(stream.data, analysis);
+}
+
+TEST(leavesOtherLanguagesUncounted)
+{
+    PageAnalysis analysis = analyze({UEL + "@PJL ENTER LANGUAGE=POSTSCRIPT\r\n%!PS\nshowpage\n\x0C"});
+    CHECK_EQUAL(analysis.language, FORMAT_POSTSCRIPT);
+    CHECK_EQUAL(analysis.pages, 0);
+
+    analysis = analyze({"%PDF-1.7\n"});
+    CHECK_EQUAL(analysis.language, FORMAT_PDF);
+    CHECK_EQUAL(analysis.pages, 0);
+}
+
+TEST(analyzesFiles)
+{
+    Stream stream = pcl5Stream();
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "node-printing-page-analyzer.pcl";
+    FILE *file = std::fopen(path.string().c_str(), "wb");
+    CHECK(file != NULL);
+    if (file == NULL)
+    {
+        return;
+    }
+    std::fwrite(stream.data.data(), 1, stream.data.size(), file);
+    std::fclose(file);
+
+    PageAnalysis analysis;
+    CHECK(analyzeFile(path.string(), analysis) == NULL);
+    CHECK(sameAnalysis(analysis, analyze({stream.data})));
+
+    OperationContext context;
+    context.cancel();
+    CHECK(analyzeFile(path.string(), analysis, &context) == context.error());
+
+    std::filesystem::remove(path);
+    CHECK(analyzeFile(path.string(), analysis) != NULL);
+}
@@ -0,0 +1,312 @@
+#include "NativeTest.hpp"
+#include "FakeSpooler.hpp"
+#include "../../src/RasterEncoder.hpp"
+
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A page read back from the stream: its header fields and pixels in the output color space
+struct DecodedPage
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t bitsPerPixel = 0;
+    uint32_t resolution = 0;
+    // PWG TotalPageCount
+    uint32_t pageCount = 0;
+    std::string pixels;
+};
+
+static uint32_t getInt(std::string_view data, size_t offset)
+{
+    return (uint32_t)(unsigned char)data[offset] << 24 | (uint32_t)(unsigned char)data[offset + 1] << 16 |
+           (uint32_t)(unsigned char)data[offset + 2] << 8 | (uint32_t)(unsigned char)data[offset + 3];
+}
+
+// Repeat count, then runs (count - 1, one pixel) and literals (257 - count, count pixels) per line
+static bool decodeLines(std::string_view data, size_t &pos, DecodedPage &page)
+{
+    size_t bytesPerPixel = page.bitsPerPixel / 8;
+    size_t lineBytes = page.width * bytesPerPixel;
+
+    for (uint32_t y = 0; y < page.height;)
+    {
+        if (pos >= data.size())
+        {
+            return false;
+        }
+        uint32_t lines = (unsigned char)data[pos++] + 1u;
+
+        std::string line;
+        while (line.size() < lineBytes)
+        {
+            if (pos >= data.size())
+            {
+                return false;
+            }
+            unsigned control = (unsigned char)data[pos++];
+            if (control == 128)
+            {
+                return false;
+            }
+            size_t count = control < 128 ? 1 : 257 - control;
+            size_t repeat = control < 128 ? control + 1 : 1;
+            if (pos + count * bytesPerPixel > data.size())
+            {
+                return false;
+            }
+            for (size_t i = 0; i < repeat; i++)
+            {
+                line.append(data.data() + pos, count * bytesPerPixel);
+            }
+            pos += count * bytesPerPixel;
+        }
+        if (line.size() != lineBytes || y + lines > page.height)
+        {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < lines; i++, y++)
+        {
+            page.pixels += line;
+        }
+    }
+    return true;
+}
+
+static bool decodeStream(std::string_view data, RasterFormat format, std::vector<DecodedPage> &pages)
+{
+    size_t pos;
+    uint32_t pageCount = 0;
+    if (format == RASTER_URF)
+    {
+        if (data.substr(0, 8) != std::string_view("UNIRAST\0", 8) || data.size() < 12)
+        {
+            return false;
+        }
+        pageCount = getInt(data, 8);
+        pos = 12;
+    }
+    else
+    {
+        if (data.substr(0, 4) != "RaS2")
+        {
+            return false;
+        }
+        pos = 4;
+    }
+
+    while (pos < data.size())
+    {
+        DecodedPage page;
+        if (format == RASTER_URF)
+        {
+            if (data.size() - pos < 32)
+            {
+                return false;
+            }
+            page.bitsPerPixel = (unsigned char)data[pos];
+            page.width = getInt(data, pos + 12);
+            page.height = getInt(data, pos + 16);
+            page.resolution = getInt(data, pos + 20);
+            page.pageCount = pageCount;
+            pos += 32;
+        }
+        else
+        {
+            if (data.size() - pos < 1796 || data.substr(pos, 10) != std::string_view("PwgRaster\0", 10))
+            {
+                return false;
+            }
+            page.resolution = getInt(data, pos + 276);
+            page.width = getInt(data, pos + 372);
+            page.height = getInt(data, pos + 376);
+            page.bitsPerPixel = getInt(data, pos + 388);
+            if (getInt(data, pos + 392) != page.width * page.bitsPerPixel / 8)
+            {
+                return false;
+            }
+            page.pageCount = getInt(data, pos + 452);
+            pos += 1796;
+        }
+
+        if (!decodeLines(data, pos, page))
+        {
+            return false;
+        }
+        pages.push_back(page);
+    }
+    return pageCount == 0 || pages.size() == pageCount;
+}
+
+// Rows of pixels with runs of every length up to past 128, literals, repeated rows, and the
+// pixel pattern moved by one on odd rows so runs start at every offset of a 16 pixel block
+static std::string makePixels(uint32_t width, uint32_t height, size_t bytesPerPixel, size_t stride)
+{
+    std::string pixels(stride * (height - 1) + width * bytesPerPixel, '\x5A');
+    for (uint32_t y = 0; y < height; y++)
+    {
+        // Blocks of identical rows, longer than the 256 a repeat count holds
+        uint32_t pattern = y < 300 ? 0 : y / 3;
+        uint32_t value = 0;
+        uint32_t runLeft = 0;
+        uint32_t runLength = 1 + pattern % 7;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            if (runLeft == 0)
+            {
+                value = (value * 31 + 7 + pattern) & 0xFF;
+                runLength = runLength % 150 + 1 + (x % 3 == 0 ? 0 : 9);
+                runLeft = (x + pattern) % 5 == 0 ? 1 : runLength;
+            }
+            runLeft--;
+            for (size_t c = 0; c < bytesPerPixel; c++)
+            {
+                pixels[y * stride + x * bytesPerPixel + c] = (char)(value + c * 40);
+            }
+        }
+    }
+    return pixels;
+}
+
+// Rows of a page without the stride padding
+static std::string packRows(const RasterPage &page, size_t bytesPerPixel)
+{
+    size_t rowBytes = page.width * bytesPerPixel;
+    size_t stride = page.stride != 0 ? page.stride : rowBytes;
+    std::string rows;
+    for (uint32_t y = 0; y < page.height; y++)
+    {
+        rows.append(page.pixels.data() + y * stride, rowBytes);
+    }
+    return rows;
+}
+
+static void checkRoundTrip(RasterFormat format, RasterColorSpace colorSpace)
+{
+    size_t bytesPerPixel = colorSpace == RASTER_SGRAY ? 1 : 3;
+    RasterPixelFormat pixelFormat = colorSpace == RASTER_SGRAY ? PIXEL_GRAY : PIXEL_RGB;
+
+    // Widths around the 16 pixel blocks and the 128 pixel runs, one with a padded stride
+    static const uint32_t WIDTHS[] = {1, 2, 15, 16, 17, 33, 129, 300};
+    std::vector<std::string> storage;
+    std::vector<RasterPage> pages;
+    for (uint32_t width : WIDTHS)
+    {
+        size_t stride = width == 33 ? 33 * bytesPerPixel + 5 : 0;
+        uint32_t height = width == 300 ? 700 : 3;
+        storage.push_back(makePixels(width, height, bytesPerPixel, stride != 0 ? stride : width * bytesPerPixel));
+    }
+    for (size_t i = 0; i < storage.size(); i++)
+    {
+        RasterPage page;
+        page.width = WIDTHS[i];
+        page.height = WIDTHS[i] == 300 ? 700 : 3;
+        page.format = pixelFormat;
+        page.stride = WIDTHS[i] == 33 ? 33 * bytesPerPixel + 5 : 0;
+        page.pixels = storage[i];
+        pages.push_back(page);
+    }
+
+    RasterOptions options;
+    options.format = format;
+    options.colorSpace = colorSpace;
+    options.resolution = 600;
+
+    resetFakeSpooler();
+    int jobId = 0;
+    CHECK(PrinterManager::getInstance().printRaster("printer", "raster", pages, options, jobId) == NULL);
+    CHECK(getFakeSpooler().ended);
+
+    std::vector<DecodedPage> decoded;
+    CHECK(decodeStream(getFakeSpooler().data, format, decoded));
+    CHECK_EQUAL(decoded.size(), pages.size());
+    for (size_t i = 0; i < decoded.size() && i < pages.size(); i++)
+    {
+        CHECK_EQUAL(decoded[i].width, pages[i].width);
+        CHECK_EQUAL(decoded[i].height, pages[i].height);
+        CHECK_EQUAL(decoded[i].bitsPerPixel, (uint32_t)(8 * bytesPerPixel));
+        CHECK_EQUAL(decoded[i].resolution, 600u);
+        CHECK_EQUAL(decoded[i].pageCount, (uint32_t)pages.size());
+        CHECK(decoded[i].pixels == packRows(pages[i], bytesPerPixel));
+    }
+}
+
+TEST(roundTripsPwgRaster)
+{
+    checkRoundTrip(RASTER_PWG, RASTER_SRGB);
+    checkRoundTrip(RASTER_PWG, RASTER_SGRAY);
+}
+
+TEST(roundTripsUrf)
+{
+    checkRoundTrip(RASTER_URF, RASTER_SRGB);
+    checkRoundTrip(RASTER_URF, RASTER_SGRAY);
+}
+
+// Same bytes from the SSE2 and scalar builds
+TEST(encodesRunsAndLiterals)
+{
+    RasterPage page;
+    page.width = 7;
+    page.height = 2;
+    page.format = PIXEL_GRAY;
+    page.pixels = std::string_view("\x01\x01\x01\x02\x03\x04\x04\x01\x01\x01\x02\x03\x04\x04", 14);
+
+    RasterOptions options;
+    options.format = RASTER_URF;
+    options.colorSpace = RASTER_SGRAY;
+
+    std::string output;
+    encodeRasterPage(page, options, 1, output);
+    CHECK_EQUAL(output.size(), (size_t)32 + 8);
+    CHECK(output.substr(32) == std::string("\x01\x02\x01\xFF\x02\x03\x01\x04", 8));
+}
+
+TEST(convertsPixelFormats)
+{
+    // Opaque red, transparent, half transparent black
+    RasterPage page;
+    page.width = 3;
+    page.height = 1;
+    page.format = PIXEL_RGBA;
+    page.pixels = std::string_view("\xFF\x00\x00\xFF\x12\x34\x56\x00\x00\x00\x00\x80", 12);
+
+    RasterOptions options;
+    options.format = RASTER_PWG;
+    options.colorSpace = RASTER_SRGB;
+    std::string output = getRasterStreamHeader(options, 1);
+    encodeRasterPage(page, options, 1, output);
+    std::vector<DecodedPage> decoded;
+    CHECK(decodeStream(output, RASTER_PWG, decoded));
+    CHECK(decoded.size() == 1 && decoded[0].pixels == std::string("\xFF\x00\x00\xFF\xFF\xFF\x7F\x7F\x7F", 9));
+
+    options.colorSpace = RASTER_SGRAY;
+    output = getRasterStreamHeader(options, 1);
+    encodeRasterPage(page, options, 1, output);
+    decoded.clear();
+    CHECK(decodeStream(output, RASTER_PWG, decoded));
+    CHECK(decoded.size() == 1 && decoded[0].pixels == std::string("\x4D\xFF\x7F", 3));
+}
+
+TEST(cancelsRasterJobsLeftOpen)
+{
+    std::string pixels(16 * 16, '\0');
+    RasterPage page;
+    page.width = 16;
+    page.height = 16;
+    page.format = PIXEL_GRAY;
+    page.pixels = pixels;
+    std::vector<RasterPage> pages(1, page);
+
+    resetFakeSpooler().failOn = "endJob";
+    int jobId = 0;
+    CHECK(PrinterManager::getInstance().printRaster("printer", "raster", pages, RasterOptions(), jobId) != NULL);
+    CHECK(getFakeSpooler().cancelled);
+
+    resetFakeSpooler().failOn = "writeJob";
+    CHECK(PrinterManager::getInstance().printRaster("printer", "raster", pages, RasterOptions(), jobId) != NULL);
+    CHECK(getFakeSpooler().cancelled);
+}
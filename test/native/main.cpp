@@ -0,0 +1,35 @@
+#include "NativeTest.hpp"
+
+static int failures = 0;
+
+std::vector<TestCase> &getTestCases()
+{
+    static std::vector<TestCase> testCases;
+    return testCases;
+}
+
+void reportFailure(const char *file, int line, const std::string &message)
+{
+    std::fprintf(stderr, "%s:%d: %s\n", file, line, message.c_str());
+    failures++;
+}
+
+int main()
+{
+#ifdef NODE_PRINTING_NO_SSE2
+    std::printf("# scalar build\n");
+#endif
+
+    int failed = 0;
+    for (const TestCase &testCase : getTestCases())
+    {
+        int before = failures;
+        testCase.run();
+        bool ok = failures == before;
+        failed += !ok;
+        std::printf("%s %s\n", ok ? "ok" : "not ok", testCase.name);
+    }
+
+    std::printf("# %d of %d failed\n", failed, (int)getTestCases().size());
+    return failed == 0 ? 0 : 1;
+}